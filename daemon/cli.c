@@ -32,6 +32,7 @@
 #include <stddef.h>
 #include <getopt.h>
 #include <arpa/inet.h> /* for inet_addr() */
+#include <sys/un.h>    /* for Unix socket addresses */
 #include "main.h"
 
 
@@ -56,6 +57,11 @@ char helpset[];
 char helpcat[];
 char helploadso[];
 char helplist[];
+char helpmget[];
+char helpdump[];
+char helphist[];
+char helpunloadso[];
+char helpreloadso[];
 
 
 
@@ -75,6 +81,13 @@ int main(int argc, char **argv)
     int  tmp_int;           // a temporary integer
     static int srvfd = -1;  // FD for empty daemon socket
     struct sockaddr_in skt; // network address for empty daemon
+    struct sockaddr_un uskt; // Unix socket address for empty daemon
+    char *unixpath = 0;     // path of daemon's Unix socket, if any
+    char *since = 0;        // edcat: replay broadcasts after this seq
+    static struct option longopts[] = {
+        {"since", required_argument, 0, 's'},
+        {0, 0, 0, 0}
+    };
     int  adrlen;
     int  i;                 // generic loop counter
     int  ret;               // generic return value
@@ -93,18 +106,24 @@ int main(int argc, char **argv)
         strcmp(argv[0], CPREFIX "set") &&
         strcmp(argv[0], CPREFIX "cat") &&
         strcmp(argv[0], CPREFIX "list") &&
+        strcmp(argv[0], CPREFIX "mget") &&
+        strcmp(argv[0], CPREFIX "dump") &&
+        strcmp(argv[0], CPREFIX "hist") &&
+        strcmp(argv[0], CPREFIX "unloadso") &&
+        strcmp(argv[0], CPREFIX "reloadso") &&
         strcmp(argv[0], CPREFIX "loadso")) {
         // Unrecognized command
         printf("Unrecognized command '%s'.  Commands must be one of\n", argv[0]);
-        printf(" %sget, %sset, %scat, %slist, or %sloadso\n",
-               CPREFIX, CPREFIX, CPREFIX, CPREFIX, CPREFIX);
+        printf(" %sget, %sset, %scat, %slist, %smget, %sdump, %shist, %sloadso,\n",
+               CPREFIX, CPREFIX, CPREFIX, CPREFIX, CPREFIX, CPREFIX, CPREFIX, CPREFIX);
+        printf(" %sunloadso, or %sreloadso\n", CPREFIX, CPREFIX);
         exit(-1);
     }
 
 
     optind = 0;          // reset the scan of the cmd line arguments
     optarg = argv[0];
-    while ((cmdc = getopt(argc, argv, "a:hp:")) != EOF) {
+    while ((cmdc = getopt_long(argc, argv, "a:hp:s:u:", longopts, 0)) != EOF) {
         switch ((char) cmdc) {
         case 'a':       // Bind Address
             strncpy(bindaddress, optarg, MAX_IP);
@@ -121,6 +140,18 @@ int main(int argc, char **argv)
             }
             break;
 
+        case 's':       // Replay broadcasts missed since this seq
+            if (strcmp(argv[0], CPREFIX "cat")) {
+                usage();
+                exit(-1);
+            }
+            since = optarg;
+            break;
+
+        case 'u':       // Unix socket path
+            unixpath = optarg;
+            break;
+
         default:
             usage();
             exit(-1);
@@ -128,16 +159,37 @@ int main(int argc, char **argv)
         }
     }
 
-    // Open connection to empty daemon
-    adrlen = sizeof(struct sockaddr_in);
-    (void) memset((void *) &skt, 0, (size_t) adrlen);
-    skt.sin_family = AF_INET;
-    skt.sin_port = htons(bindport);
-    if ((inet_aton(bindaddress, &(skt.sin_addr)) == 0) ||
-        ((srvfd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0) ||
-        (connect(srvfd, (struct sockaddr *) &skt, adrlen) < 0)) {
-        printf("Error: unable to connect to the empty daemon.\n");
-        exit(-1);
+    // Open connection to empty daemon.  A path starting with '@' is
+    // in the abstract namespace.
+    if (unixpath != 0) {
+        (void) memset((void *) &uskt, 0, sizeof(struct sockaddr_un));
+        uskt.sun_family = AF_UNIX;
+        slen = strlen(unixpath);
+        if (slen >= (int) sizeof(uskt.sun_path)) {
+            printf("Error: Unix socket path is too long.\n");
+            exit(-1);
+        }
+        memcpy(uskt.sun_path, unixpath, slen);
+        if (unixpath[0] == '@')
+            uskt.sun_path[0] = (char) 0;
+        adrlen = offsetof(struct sockaddr_un, sun_path) + slen;
+        if (((srvfd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0) ||
+            (connect(srvfd, (struct sockaddr *) &uskt, adrlen) < 0)) {
+            printf("Error: unable to connect to the empty daemon.\n");
+            exit(-1);
+        }
+    }
+    else {
+        adrlen = sizeof(struct sockaddr_in);
+        (void) memset((void *) &skt, 0, (size_t) adrlen);
+        skt.sin_family = AF_INET;
+        skt.sin_port = htons(bindport);
+        if ((inet_aton(bindaddress, &(skt.sin_addr)) == 0) ||
+            ((srvfd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0) ||
+            (connect(srvfd, (struct sockaddr *) &skt, adrlen) < 0)) {
+            printf("Error: unable to connect to the empty daemon.\n");
+            exit(-1);
+        }
     }
 
     // At this point the connection to the empty daemon is open
@@ -149,6 +201,9 @@ int main(int argc, char **argv)
     for (i = optind; (i < argc && slen < MAX_EDCMD -1) ; i++) {
         slen += snprintf(&(buf[slen]), (MAX_EDCMD - slen), "%s ", argv[i]);
     }
+    if ((since != 0) && (slen < MAX_EDCMD -1)) {
+        slen += snprintf(&(buf[slen]), (MAX_EDCMD - slen), "--since %s ", since);
+    }
     if (slen >= MAX_EDCMD -1) {
         printf("Error: command exceeds maximum length of %d\n", MAX_EDCMD);
         exit(-1);
@@ -200,7 +255,8 @@ int main(int argc, char **argv)
  **************************************************************/
 void usage()
 {
-    printf(usagetext, CPREFIX, CPREFIX, CPREFIX, CPREFIX, CPREFIX);
+    printf(usagetext, CPREFIX, CPREFIX, CPREFIX, CPREFIX, CPREFIX, CPREFIX, CPREFIX, CPREFIX,
+           CPREFIX, CPREFIX);
 
     return;
 }
@@ -219,11 +275,22 @@ void help(char **argv)
     else if (!strcmp(CPREFIX "get", argv[0]))
         printf(helpget, CPREFIX, CPREFIX, CPREFIX, CPREFIX);
     else if (!strcmp(CPREFIX "cat", argv[0]))
-        printf(helpcat, CPREFIX, CPREFIX, CPREFIX, CPREFIX);
+        printf(helpcat, CPREFIX, CPREFIX, CPREFIX, CPREFIX, CPREFIX);
     else if (!strcmp(CPREFIX "loadso", argv[0]))
         printf(helploadso, CPREFIX, CPREFIX, CPREFIX);
+    else if (!strcmp(CPREFIX "mget", argv[0]))
+        printf(helpmget, CPREFIX, CPREFIX, CPREFIX);
+    else if (!strcmp(CPREFIX "dump", argv[0]))
+        printf(helpdump, CPREFIX, CPREFIX);
+    else if (!strcmp(CPREFIX "hist", argv[0]))
+        printf(helphist, CPREFIX, CPREFIX, CPREFIX, CPREFIX, CPREFIX);
+    else if (!strcmp(CPREFIX "unloadso", argv[0]))
+        printf(helpunloadso, CPREFIX, CPREFIX);
+    else if (!strcmp(CPREFIX "reloadso", argv[0]))
+        printf(helpreloadso, CPREFIX, CPREFIX);
     else
-        printf(usagetext, CPREFIX, CPREFIX, CPREFIX, CPREFIX);
+        printf(usagetext, CPREFIX, CPREFIX, CPREFIX, CPREFIX, CPREFIX, CPREFIX, CPREFIX, CPREFIX,
+               CPREFIX, CPREFIX);
 
 
     return;
@@ -282,6 +349,14 @@ to form an event driven system.  You may wish to use %scat with all of\n\
 the inputs and sensors in your system.  The period printing of the\n\
 hellodemo output string can be started with:\n\
     %scat hellodemo message\n\
+Each broadcast has a sequence number.  With --since <seq> each line\n\
+starts with its sequence number, and the broadcasts after <seq> that\n\
+the daemon still has are sent before the live stream.  Broadcasts it\n\
+no longer has are reported with a line 'GAP <first> <last>'.  A client\n\
+that reconnects with the last sequence number it saw loses nothing\n\
+that is still in the daemon's replay buffer.  Use --since 0 the\n\
+first time.\n\
+    %scat --since 41 hellodemo message\n\
 \n";
 
 char helploadso[] = "\n\
@@ -291,6 +366,55 @@ a plug-in you should be be able to see its resources with a %slist\n\
 command.  For example, the following command loads the game controller\n\
 plug-in.\n\
     %sloadso gamepad.so\n\
+Add @thread to the file name to run a plug-in that does heavy work or\n\
+blocks on a thread of its own, as in gps.so@thread.\n\
+\n";
+
+char helpunloadso[] = "\n\
+The %sunloadso command removes the plug-in in a slot.  Give it the\n\
+slot number or the plug-in name.  Requests waiting on the plug-in\n\
+fail and UIs watching its resources stop getting broadcasts.  The\n\
+slot can then be used by a later loadso.\n\
+    %sunloadso gamepad\n\
+\n";
+
+char helpreloadso[] = "\n\
+The %sreloadso command unloads the plug-in in a slot and loads its\n\
+shared object file again, so a new build of the plug-in can be used\n\
+without restarting the daemon.  UIs watching its resources stay\n\
+connected and get the broadcasts of the new code.\n\
+    %sreloadso gps\n\
+\n";
+
+char helpmget[] = "\n\
+The %smget command reads several resources at once and returns\n\
+all of the values in one reply.  Give it either the name of one\n\
+plug-in to read all of that plug-in's readable resources, or any\n\
+number of slot (or plug-in name) and resource name pairs.  Each\n\
+value is on its own line after the plug-in and resource names.\n\
+    %smget hellodemo\n\
+    %smget gps tll hellodemo period\n\
+\n";
+
+char helpdump[] = "\n\
+The %sdump command reads every readable resource in every plug-in\n\
+and returns the values in one reply.  All of the values are read at\n\
+the same time and so form a snapshot of the system.  Each value is\n\
+on its own line after the plug-in and resource names.\n\
+    %sdump\n\
+\n";
+
+char helphist[] = "\n\
+The %shist command shows the history the daemon keeps of a broadcast\n\
+resource.  Turn on the history with 'edset 0 history'.  Give it the\n\
+time to start from, as seconds ago or as a Unix time, and the width\n\
+of a bucket in seconds.  Without a bucket each line is the time of a\n\
+sample and its values.  With a bucket each line is the start of the\n\
+bucket, the number of samples in it, and the mean of each value.\n\
+    %shist gps tll\n\
+    %shist gps tll 600\n\
+    %shist gps tll 3600 60\n\
+    %shist gps tll 1700000000 10\n\
 \n";
 
 
@@ -298,13 +422,19 @@ char usagetext[] = "\
 Usage is command specific.  Empty daemon command syntaxes are as follows:\n\
   %sset <slot#|plug-in_name> <resourcename> <value(s)>\n\
   %sget <slot#|plug-in_name> <resourcename>\n\
-  %scat <slot#|plug-in_name> <resourcename>\n\
+  %scat [--since <seq>] <slot#|plug-in_name> <resourcename>\n\
   %slist [plug-in_name]\n\
+  %smget <plug-in_name> | <slot#|plug-in_name> <resourcename> ...\n\
+  %sdump\n\
+  %shist <slot#|plug-in_name> <resourcename> [since] [bucket]\n\
   %sloadso <plug-in_name>.so\n\
+  %sunloadso <slot#|plug-in_name>\n\
+  %sreloadso <slot#|plug-in_name>\n\
 \n\
  options:\n\
  -p,        Specify TCP port of daemon.\n\
  -a,        Specify TCP address of daemon.  Default is 127.0.0.1\n\
+ -u,        Connect to the daemon's Unix socket at this path instead of TCP.\n\
  -h,        Print full help for the given command.\n\
 ";
 
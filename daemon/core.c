@@ -0,0 +1,1208 @@
+/*
+ * Name: core.c
+ *
+ * Description: The daemon's own slot.  Slot 0 holds resources that
+ *              configure the daemon itself rather than a plug-in.
+ *              It is built into the daemon but otherwise looks to
+ *              the user just like any other plug-in.
+ *
+ *  Resources:
+ *    shmring - publish a broadcast resource into shared memory (edget, edset)
+ *    multicast - publish a broadcast resource to a UDP multicast group (edget, edset)
+ *    connections - list the UI connections and their traffic (edget)
+ *    limits - per connection command rate, idle timeout, and plug-in response timeout (edget, edset)
+ *    overload - how far the event loop is behind and what is shed (edget, edset, edcat)
+ *    priority - whether this connection is shed first under overload (edget, edset)
+ *    cache - serve edget of a resource from its last value (edget, edset)
+ *    history - keep recent broadcasts of a resource for edhist (edget, edset)
+ *    startup - how long each plug-in took to start (edget)
+ *
+ * Copyright:   Copyright (C) 2019 by Demand Peripherals, Inc.
+ *              All rights reserved.
+ *
+ * License:     This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the Version 2 of the GNU General
+ *              Public License as published by the Free Software Foundation.
+ *              GPL2.txt in the top level directory is a copy of this license.
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *              GNU General Public License for more details.
+ *
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "main.h"
+#include "../plug-ins/include/edring.h"
+
+
+/***************************************************************************
+ *  - Limits and defines
+ ***************************************************************************/
+        // resource names and numbers
+#define FN_SHMRING         "shmring"
+#define FN_MCAST           "multicast"
+#define FN_CONNS           "connections"
+#define FN_LIMITS          "limits"
+#define FN_OVERLOAD        "overload"
+#define FN_PRIO            "priority"
+#define FN_CACHE           "cache"
+#define FN_HIST            "history"
+#define FN_START           "startup"
+#define RSC_SHMRING        0
+#define RSC_MCAST          1
+#define RSC_CONNS          2
+#define RSC_LIMITS         3
+#define RSC_OVERLOAD       4
+#define RSC_PRIO           5
+#define RSC_CACHE          6
+#define RSC_HIST           7
+#define RSC_START          8
+        // Multicast datagrams stay on the local network
+#define MCAST_TTL          1
+        // What we are is a ...
+#define PLUGIN_NAME        "daemon"
+
+
+/***************************************************************************
+ *  - Function prototypes, forward references, and externs
+ ***************************************************************************/
+static void usercmd(int, int, char*, SLOT*, int, int*, char*);
+static int  find_rsc(char *, int *);
+static int  open_ring(RSC *, int, int, int);
+static void close_ring(ED_RSC *);
+static int  open_mcast(ED_RSC *, char *, char *);
+static void send_mcast(ED_RSC *, int, char *, int, int);
+static int  list_conns(char *, int);
+static int  show_load(char *, int);
+static int  list_cache(char *, int);
+int         ed_cacheable(RSC *, int);
+void        ed_cache(RSC *, char *, int);
+int         cache_get(RSC *, char **);
+static void check_load(void *, void *);
+ED_RSC     *rscpriv(RSC *);
+void        rscfree(ED_RSC *);
+int         core_bcst(int, ED_SAMPLE *, int);
+int         core_listens(int);
+unsigned int core_seq(int);
+ED_RSC     *replay_on(RSC *);
+static void keep_bcst(ED_RSC *, char *, int, long long);
+extern int  find_slot(char *);
+extern int  find_name(int, char *);
+extern void index_names();
+extern long long now_us();
+extern SLOT Slots[MX_PLUGIN];
+extern UI   UiCons[MX_UI];
+extern int  UiRate;        // commands per second per UI, 0 for no limit
+extern int  UiBurst;       // commands a UI may send at once
+extern int  UiIdle;        // seconds before an idle UI is closed
+extern int  RspTimeout;    // ms to finish a pending get or set
+extern long long LoopLag;  // most lateness of a timer since the last check
+extern int  LoopReady;     // most FDs ready in one select since the last check
+extern char *smp_text(ED_SAMPLE *, int *);
+extern const ED_VALUE *smp_values(ED_SAMPLE *, int *);
+extern int  hist_open(ED_RSC *, int, int);
+extern void hist_close(ED_RSC *);
+extern void hist_add(ED_HIST *, const ED_VALUE *, int, long long);
+extern int  list_hist(char *, int);
+extern int  list_start(char *, int);
+extern char *smp_bin(ED_SAMPLE *, int *);
+extern int  smp_ptype(ED_SAMPLE *);
+extern void mkframe(unsigned char *, int, int, int, int, int, unsigned int, long long, int);
+extern int  thr_slot();
+extern void watch_rsc(RSC *, int);
+extern void unwatch_rsc(int);
+extern int  thr_route(int, int, void *, char *, int);
+
+
+/***************************************************************************
+ *  - Variable allocation and initialization
+ ***************************************************************************/
+static int  mcastfd = -1;  // UDP socket for all multicast output
+int         Overload = 0;  // overload level, 0 if the loop is keeping up
+unsigned int OvlRefused = 0; // UI connections refused while overloaded
+static int  ovllag[OVL_NLEVEL] = { 10, 50, 250 }; // ms of lag for each level
+static int  ovlready = 16; // FDs ready at once that add a level
+static long long lastlag;  // lag seen by the last check in microseconds
+static int  lastready;     // FDs ready seen by the last check
+static int  ovlcalm;       // checks in a row below the current level
+
+
+/***************************************************************************
+ * coreinit():  - Set up slot 0 for the daemon's own resources.  This
+ * is called before any plug-ins are added so add_so() never uses slot 0.
+ ***************************************************************************/
+void coreinit(
+    SLOT    *pslot)       // points to the SLOT for the daemon
+{
+    // Register name.  A non-empty soname keeps add_so() out of slot 0.
+    pslot->name = PLUGIN_NAME;
+    pslot->desc = "The daemon's own configuration";
+    pslot->help = "\n\
+The daemon is always in slot 0.  Its resources configure the daemon\n\
+itself.\n\
+\n\
+shmring : Publish a broadcast resource into a ring in shared memory.\n\
+Set it to the plug-in and resource name, the number of entries, and\n\
+optionally the maximum bytes per entry.  A count of zero removes the\n\
+ring.  Reading shmring lists the rings and their shared memory names.\n\
+See edring.h for how to read a ring.\n\
+    edset 0 shmring gps.tll 64\n\
+    edget 0 shmring\n\
+\n\
+multicast : Send each broadcast of a resource as a UDP datagram to a\n\
+multicast group.  Set it to the plug-in and resource name and the\n\
+group address and port, or to 'off' to stop.  Add the address of\n\
+an interface to send on a particular network.  Each datagram is one\n\
+binary protocol frame.  The frame's seq field counts the broadcasts\n\
+of the resource so receivers can detect lost datagrams.\n\
+    edset 0 multicast gps.tll 239.1.1.1:9000\n\
+    edset 0 multicast gps.tll 239.1.1.1:9000 127.0.0.1\n\
+    edget 0 multicast\n\
+\n\
+connections : List the open UI connections, one per line.  The fields\n\
+are the connection number, the peer as IP:port or unix:uid, seconds\n\
+connected, bytes in and out, and the number of commands received.\n\
+The commands are given in the order unknown/get/set/cat/list/loadso/\n\
+proto/resolve/mget/dump/hist/unloadso/reloadso.  These are followed by the number of\n\
+broadcasts sent and dropped, the most bytes ever waiting to be sent,\n\
+the number of times the UI was held back by the rate limit, and the\n\
+resource being watched with edcat, if any.\n\
+    edget 0 connections\n\
+\n\
+limits : Limit how fast each UI may send commands and close UIs that\n\
+are idle.  Set it to the commands per second, the number of commands\n\
+a UI may send at once, and the idle timeout in seconds.  A UI over its\n\
+rate is not read until it has credit for its next command.  A UI that\n\
+sends nothing for the idle time is closed unless it is watching a\n\
+resource or waiting for a reply.  Zero turns off a limit.  Both are\n\
+off at startup.  An optional fourth value is how many milliseconds a\n\
+plug-in has to finish a get or set it left pending before the UI gets\n\
+a no response error.  It is 2000 at startup.\n\
+    edset 0 limits 100 20 600\n\
+    edset 0 limits 100 20 600 500\n\
+    edget 0 limits\n\
+\n\
+overload : The daemon checks how far behind its event loop is ten\n\
+times a second, using how late its timers run and how many sockets\n\
+are ready at once.  Reading overload gives the level from 0 (keeping\n\
+up) to 3, the lag in milliseconds, the most sockets ready at once,\n\
+and the number of connections refused.  At level 1 edlist, eddump,\n\
+and edloadso wait up to two seconds for the load to drop.  At level 2\n\
+UIs with a low priority get only one in four broadcasts.  At level 3\n\
+new UI connections are refused.  The level goes up at once and drops\n\
+one step after a second below it.  Set overload to the lag in ms for\n\
+levels 1, 2, and 3 and the number of ready sockets that adds one\n\
+level.  Use edcat to see each change of level.\n\
+    edset 0 overload 10 50 250 16\n\
+    edget 0 overload\n\
+\n\
+priority : Set to 'low' to have this connection shed first when the\n\
+daemon is overloaded.  Use it for dashboards and loggers that can\n\
+miss a few samples.  It applies only to the connection that sets it.\n\
+    edset 0 priority low\n\
+\n\
+cache : Answer edget of a resource from the last value read from it\n\
+for up to a given number of milliseconds, without asking the plug-in.\n\
+A set of the resource clears the value.  Use 'edget <slot> <rsc>\n\
+--fresh' to read the plug-in anyway.  Set cache to the plug-in and\n\
+resource name and the most age in ms, -1 for values that change\n\
+only on edset, or 0 to stop caching.  Reading cache lists each cached\n\
+resource with its most age, the age of its value in ms (-1 if none),\n\
+and the number of reads answered from the cache and from the plug-in.\n\
+    edset 0 cache gps.status 500\n\
+    edget 0 cache\n\
+\n\
+history : Keep the recent broadcasts of a resource in memory so that\n\
+edhist can show them.  Set it to the plug-in and resource name and the\n\
+number of samples to keep, or a number of seconds followed by 's'.  A\n\
+history kept in seconds grows as needed.  Zero stops the history.  Up\n\
+to eight values of each sample are kept.  Text values keep only their\n\
+first seven characters.  Reading history lists each resource with the\n\
+samples or seconds it keeps, the samples it has, and the seconds they\n\
+span.\n\
+    edset 0 history gps.tll 6000\n\
+    edset 0 history gps.tll 600s\n\
+    edget 0 history\n\
+\n\
+startup : The plug-ins given on the command line start at the same\n\
+time, each on its own thread.  A plug-in that uses another from its\n\
+Initialize() waits for the ones named in its Depends string.  Reading\n\
+startup gives a line for each plug-in with its slot, its .so file, the\n\
+ms it took to load and initialize, and the ms it waited for the\n\
+plug-ins it depends on.  The last line is the ms from the start of the\n\
+first plug-in until all were ready.\n\
+    edget 0 startup\n\
+";
+    (void) strncpy(pslot->soname, "(built-in)", MX_SONAME);
+
+    // Add handlers for the user visible resources
+    pslot->rsc[RSC_SHMRING].name = FN_SHMRING;
+    pslot->rsc[RSC_SHMRING].flags = IS_READABLE | IS_WRITABLE;
+    pslot->rsc[RSC_SHMRING].bkey = 0;
+    pslot->rsc[RSC_SHMRING].pgscb = usercmd;
+    pslot->rsc[RSC_SHMRING].uilock = -1;
+    pslot->rsc[RSC_SHMRING].slot = pslot;
+    pslot->rsc[RSC_MCAST].name = FN_MCAST;
+    pslot->rsc[RSC_MCAST].flags = IS_READABLE | IS_WRITABLE;
+    pslot->rsc[RSC_MCAST].bkey = 0;
+    pslot->rsc[RSC_MCAST].pgscb = usercmd;
+    pslot->rsc[RSC_MCAST].uilock = -1;
+    pslot->rsc[RSC_MCAST].slot = pslot;
+    pslot->rsc[RSC_CONNS].name = FN_CONNS;
+    pslot->rsc[RSC_CONNS].flags = IS_READABLE;
+    pslot->rsc[RSC_CONNS].bkey = 0;
+    pslot->rsc[RSC_CONNS].pgscb = usercmd;
+    pslot->rsc[RSC_CONNS].uilock = -1;
+    pslot->rsc[RSC_CONNS].slot = pslot;
+    pslot->rsc[RSC_LIMITS].name = FN_LIMITS;
+    pslot->rsc[RSC_LIMITS].flags = IS_READABLE | IS_WRITABLE;
+    pslot->rsc[RSC_LIMITS].bkey = 0;
+    pslot->rsc[RSC_LIMITS].pgscb = usercmd;
+    pslot->rsc[RSC_LIMITS].uilock = -1;
+    pslot->rsc[RSC_LIMITS].slot = pslot;
+    pslot->rsc[RSC_OVERLOAD].name = FN_OVERLOAD;
+    pslot->rsc[RSC_OVERLOAD].flags = IS_READABLE | IS_WRITABLE | CAN_BROADCAST;
+    pslot->rsc[RSC_OVERLOAD].bkey = 0;
+    pslot->rsc[RSC_OVERLOAD].pgscb = usercmd;
+    pslot->rsc[RSC_OVERLOAD].uilock = -1;
+    pslot->rsc[RSC_OVERLOAD].slot = pslot;
+    pslot->rsc[RSC_PRIO].name = FN_PRIO;
+    pslot->rsc[RSC_PRIO].flags = IS_READABLE | IS_WRITABLE;
+    pslot->rsc[RSC_PRIO].bkey = 0;
+    pslot->rsc[RSC_PRIO].pgscb = usercmd;
+    pslot->rsc[RSC_PRIO].uilock = -1;
+    pslot->rsc[RSC_PRIO].slot = pslot;
+    pslot->rsc[RSC_CACHE].name = FN_CACHE;
+    pslot->rsc[RSC_CACHE].flags = IS_READABLE | IS_WRITABLE;
+    pslot->rsc[RSC_CACHE].bkey = 0;
+    pslot->rsc[RSC_CACHE].pgscb = usercmd;
+    pslot->rsc[RSC_CACHE].uilock = -1;
+    pslot->rsc[RSC_CACHE].slot = pslot;
+    pslot->rsc[RSC_HIST].name = FN_HIST;
+    pslot->rsc[RSC_HIST].flags = IS_READABLE | IS_WRITABLE;
+    pslot->rsc[RSC_HIST].bkey = 0;
+    pslot->rsc[RSC_HIST].pgscb = usercmd;
+    pslot->rsc[RSC_HIST].uilock = -1;
+    pslot->rsc[RSC_HIST].slot = pslot;
+    pslot->rsc[RSC_START].name = FN_START;
+    pslot->rsc[RSC_START].flags = IS_READABLE;
+    pslot->rsc[RSC_START].bkey = 0;
+    pslot->rsc[RSC_START].pgscb = usercmd;
+    pslot->rsc[RSC_START].uilock = -1;
+    pslot->rsc[RSC_START].slot = pslot;
+
+    // Watch how far behind the event loop is
+    (void) add_timer(ED_PERIODIC, OVL_PERIOD, check_load, (void *) pslot);
+
+    index_names();
+    return;
+}
+
+
+/***************************************************************************
+ * usercmd():  - The user is reading or setting one of the daemon's
+ * resources.
+ ***************************************************************************/
+static void usercmd(
+    int      cmd,      //==EDGET if a read, ==EDSET on write
+    int      rscid,    // ID of resource being accessed
+    char    *val,      // new value for the resource
+    SLOT    *pslot,    // pointer to slot info.
+    int      cn,       // Index into UI table for requesting conn
+    int     *plen,     // size of buf on input, #char in buf on output
+    char    *buf)
+{
+    ED_RSC  *ped;      // daemon state of a resource
+    RSC     *prsc;     // resource to publish
+    char     cname[MXCMD]; // plug-in.resource from the user
+    char     caddr[MXCMD]; // multicast address:port from the user
+    char     cifaddr[MXCMD]; // address of the interface to send on
+    int      islot;    // slot of resource to publish
+    int      irsc;     // resource index in slot
+    int      nent;     // number of entries in ring
+    int      datasz;   // maximum bytes of data per entry
+    int      rate;     // commands per second per UI
+    int      burst;    // commands a UI may send at once
+    int      idle;     // idle timeout in seconds
+    int      rspto;    // ms a plug-in has to finish a pending request
+    int      maxage;   // ms a cached value may be served
+    int      secs;     // seconds of history to keep
+    char     unit;     // 's' if the history size is in seconds
+    int      lag[OVL_NLEVEL]; // ms of lag for each overload level
+    int      ready;    // ready FDs that add an overload level
+    int      ret;      // return count
+    int      len = 0;  // bytes in buf
+
+    // gets and sets carry a request ID above the UI index
+    cn = (cn < 0) ? cn : ED_CN(cn);
+
+    if ((cmd == EDGET) && (rscid == RSC_SHMRING)) {
+        // List all rings
+        for (islot = 0; islot < MX_PLUGIN; islot++) {
+            for (irsc = 0; irsc < Slots[islot].nrsc; irsc++) {
+                ped = (ED_RSC *) RSCPTR(&(Slots[islot]), irsc)->dpriv;
+                if ((ped == 0) || (ped->ring == 0) || (len >= *plen))
+                    continue;
+                len += snprintf(&(buf[len]), (*plen - len), "%s.%s %s %d %d\n",
+                        Slots[islot].name, RSCPTR(&(Slots[islot]), irsc)->name, ped->ringname,
+                        ((ED_RING *) ped->ring)->nent,
+                        ((ED_RING *) ped->ring)->entsz - ED_RENT_HDRSZ);
+            }
+        }
+        // An empty list is an empty line.  Zero length means a deferred read.
+        if (len == 0)
+            len = snprintf(buf, *plen, "\n");
+        *plen = (len < *plen) ? len : *plen - 1;
+        return;
+    }
+    else if ((cmd == EDGET) && (rscid == RSC_MCAST)) {
+        // List all multicast resources
+        for (islot = 0; islot < MX_PLUGIN; islot++) {
+            for (irsc = 0; irsc < Slots[islot].nrsc; irsc++) {
+                ped = (ED_RSC *) RSCPTR(&(Slots[islot]), irsc)->dpriv;
+                if ((ped == 0) || (ped->mcast == 0) || (len >= *plen))
+                    continue;
+                len += snprintf(&(buf[len]), (*plen - len), "%s.%s %s:%d\n",
+                        Slots[islot].name, RSCPTR(&(Slots[islot]), irsc)->name,
+                        inet_ntoa(ped->mcaddr.sin_addr), ntohs(ped->mcaddr.sin_port));
+            }
+        }
+        // An empty list is an empty line.  Zero length means a deferred read.
+        if (len == 0)
+            len = snprintf(buf, *plen, "\n");
+        *plen = (len < *plen) ? len : *plen - 1;
+        return;
+    }
+    else if ((cmd == EDGET) && (rscid == RSC_CONNS)) {
+        *plen = list_conns(buf, *plen);
+        return;
+    }
+    else if ((cmd == EDGET) && (rscid == RSC_LIMITS)) {
+        *plen = snprintf(buf, *plen, "%d %d %d %d\n", UiRate, UiBurst, UiIdle, RspTimeout);
+        return;
+    }
+    else if ((cmd == EDSET) && (rscid == RSC_LIMITS)) {
+        rspto = RspTimeout;
+        ret = sscanf(val, "%d %d %d %d", &rate, &burst, &idle, &rspto);
+        if ((ret < 3) || (rate < 0) || (rate > 1000000) || (burst < 0) ||
+            (idle < 0) || (rspto < 0)) {
+            *plen = snprintf(buf, *plen, E_BDVAL, pslot->rsc[rscid].name);
+            return;
+        }
+        UiRate = rate;
+        UiBurst = burst;
+        UiIdle = idle;
+        RspTimeout = rspto;
+        *plen = 0;
+        return;
+    }
+    else if ((cmd == EDGET) && (rscid == RSC_CACHE)) {
+        *plen = list_cache(buf, *plen);
+        return;
+    }
+    else if ((cmd == EDSET) && (rscid == RSC_CACHE)) {
+        ret = sscanf(val, "%s %d", cname, &maxage);
+        islot = (ret == 2) ? find_rsc(cname, &irsc) : -1;
+        if ((islot < 0) || (maxage < ED_CACHE_FOREVER) ||
+            ((RSCPTR(&(Slots[islot]), irsc)->flags & IS_READABLE) == 0) ||
+            (ed_cacheable(RSCPTR(&(Slots[islot]), irsc), maxage) < 0)) {
+            *plen = snprintf(buf, *plen, E_BDVAL, pslot->rsc[rscid].name);
+            return;
+        }
+        *plen = 0;
+        return;
+    }
+    else if ((cmd == EDGET) && (rscid == RSC_HIST)) {
+        *plen = list_hist(buf, *plen);
+        return;
+    }
+    else if ((cmd == EDGET) && (rscid == RSC_START)) {
+        *plen = list_start(buf, *plen);
+        return;
+    }
+    else if ((cmd == EDSET) && (rscid == RSC_HIST)) {
+        unit = (char) 0;
+        ret = sscanf(val, "%s %d%c", cname, &nent, &unit);
+        islot = (ret >= 2) ? find_rsc(cname, &irsc) : -1;
+        if ((islot < 0) || (nent < 0) || ((ret == 3) && (unit != 's')) ||
+            ((RSCPTR(&(Slots[islot]), irsc)->flags & CAN_BROADCAST) == 0)) {
+            *plen = snprintf(buf, *plen, E_BDVAL, pslot->rsc[rscid].name);
+            return;
+        }
+        prsc = RSCPTR(&(Slots[islot]), irsc);
+        if (nent == 0) {
+            if (prsc->dpriv != 0)
+                hist_close((ED_RSC *) prsc->dpriv);
+            unwatch_rsc(MKHANDLE(islot, irsc));
+            *plen = 0;
+            return;
+        }
+        secs = (unit == 's') ? nent : 0;
+        nent = (unit == 's') ? 0 : nent;
+        ped = rscpriv(prsc);
+        if ((ped == 0) || (nent > HIST_MXENT) || (hist_open(ped, nent, secs) < 0)) {
+            *plen = snprintf(buf, *plen, E_BDVAL, pslot->rsc[rscid].name);
+            return;
+        }
+
+        // The history is a listener.  Turn on broadcasts from the resource.
+        watch_rsc(prsc, MKHANDLE(islot, irsc));
+        if (prsc->pgscb) {
+            len = *plen;
+            (prsc->pgscb)(EDCAT, irsc, (char *) 0, &(Slots[islot]), cn, &len, buf);
+        }
+        *plen = 0;
+        return;
+    }
+    else if ((cmd == EDGET) && (rscid == RSC_OVERLOAD)) {
+        *plen = show_load(buf, *plen);
+        return;
+    }
+    else if ((cmd == EDSET) && (rscid == RSC_OVERLOAD)) {
+        if ((sscanf(val, "%d %d %d %d", &lag[0], &lag[1], &lag[2], &ready) != 4) ||
+            (lag[0] <= 0) || (lag[1] < lag[0]) || (lag[2] < lag[1]) || (ready <= 0)) {
+            *plen = snprintf(buf, *plen, E_BDVAL, pslot->rsc[rscid].name);
+            return;
+        }
+        memcpy(ovllag, lag, sizeof(ovllag));
+        ovlready = ready;
+        *plen = 0;
+        return;
+    }
+    else if ((cmd == EDGET) && (rscid == RSC_PRIO)) {
+        *plen = snprintf(buf, *plen, "%s\n",
+                ((cn >= 0) && (cn < MX_UI) && (UiCons[cn].prio == ED_PRIO_LOW)) ?
+                "low" : "normal");
+        return;
+    }
+    else if ((cmd == EDSET) && (rscid == RSC_PRIO)) {
+        // Only a UI has a priority.  ed_set() from a plug-in has none.
+        if ((cn >= 0) && (cn < MX_UI) && (sscanf(val, "%s", cname) == 1)) {
+            if (!strcmp(cname, "low")) {
+                UiCons[cn].prio = ED_PRIO_LOW;
+                *plen = 0;
+                return;
+            }
+            if (!strcmp(cname, "normal")) {
+                UiCons[cn].prio = ED_PRIO_NORMAL;
+                *plen = 0;
+                return;
+            }
+        }
+        *plen = snprintf(buf, *plen, E_BDVAL, pslot->rsc[rscid].name);
+        return;
+    }
+    else if ((cmd == EDSET) && (rscid == RSC_MCAST)) {
+        ret = sscanf(val, "%s %s %s", cname, caddr, cifaddr);
+        islot = (ret >= 2) ? find_rsc(cname, &irsc) : -1;
+        if ((islot < 0) || ((RSCPTR(&(Slots[islot]), irsc)->flags & CAN_BROADCAST) == 0)) {
+            *plen = snprintf(buf, *plen, E_BDVAL, pslot->rsc[rscid].name);
+            return;
+        }
+        prsc = RSCPTR(&(Slots[islot]), irsc);
+        if (!strcmp(caddr, "off")) {
+            if (prsc->dpriv != 0)
+                ((ED_RSC *) prsc->dpriv)->mcast = 0;
+            unwatch_rsc(MKHANDLE(islot, irsc));
+            *plen = 0;
+            return;
+        }
+        ped = rscpriv(prsc);
+        if ((ped == 0) || (open_mcast(ped, caddr, ((ret == 3) ? cifaddr : 0)) < 0)) {
+            *plen = snprintf(buf, *plen, E_BDVAL, pslot->rsc[rscid].name);
+            return;
+        }
+        // The group is a listener.  Turn on broadcasts from the resource.
+        watch_rsc(prsc, MKHANDLE(islot, irsc));
+        if (prsc->pgscb) {
+            len = *plen;
+            (prsc->pgscb)(EDCAT, irsc, (char *) 0, &(Slots[islot]), cn, &len, buf);
+        }
+        *plen = 0;
+        return;
+    }
+    else if ((cmd == EDSET) && (rscid == RSC_SHMRING)) {
+        datasz = DEF_RINGDATA;
+        ret = sscanf(val, "%s %d %d", cname, &nent, &datasz);
+        islot = (ret >= 2) ? find_rsc(cname, &irsc) : -1;
+        if ((islot < 0) || (nent < 0) || (nent > MX_RINGENT) ||
+            (datasz < 1) || (datasz > MXRPLY) ||
+            ((RSCPTR(&(Slots[islot]), irsc)->flags & CAN_BROADCAST) == 0)) {
+            *plen = snprintf(buf, *plen, E_BDVAL, pslot->rsc[rscid].name);
+            return;
+        }
+        prsc = RSCPTR(&(Slots[islot]), irsc);
+        if (nent == 0) {
+            if (prsc->dpriv != 0)
+                close_ring((ED_RSC *) prsc->dpriv);
+            unwatch_rsc(MKHANDLE(islot, irsc));
+            *plen = 0;
+            return;
+        }
+        if (open_ring(prsc, MKHANDLE(islot, irsc), nent, datasz) < 0) {
+            *plen = snprintf(buf, *plen, E_BDVAL, pslot->rsc[rscid].name);
+            return;
+        }
+
+        // The ring is a listener.  Turn on broadcasts from the resource
+        // and tell the resource the same way an edcat does.
+        watch_rsc(prsc, MKHANDLE(islot, irsc));
+        if (prsc->pgscb) {
+            len = *plen;
+            (prsc->pgscb)(EDCAT, irsc, (char *) 0, &(Slots[islot]), cn, &len, buf);
+        }
+        *plen = 0;
+    }
+    return;
+}
+
+
+/***************************************************************************
+ * check_load():  - Called every OVL_PERIOD ms to set the overload level
+ * from the lag and ready FDs seen since the last check.  The lag sets
+ * the level and many ready FDs add one to it.  The level goes up at
+ * once but comes down one step at a time after OVL_CALM quiet checks
+ * so the shedding does not flap.  Watchers of the overload resource
+ * get a broadcast each time the level changes.
+ ***************************************************************************/
+static void check_load(
+    void    *timer,       // handle of the timer that expired
+    void    *data)        // points to the daemon's slot
+{
+    SLOT    *pslot;       // the daemon's slot
+    char     buf[MXRPLY]; // the new level to broadcast
+    int      level = 0;   // level of the load just seen
+    int      len;         // bytes in buf
+    int      i;
+
+    pslot = (SLOT *) data;
+    lastlag = LoopLag;
+    lastready = LoopReady;
+    LoopLag = 0;
+    LoopReady = 0;
+    for (i = 0; i < OVL_NLEVEL; i++) {
+        if (lastlag >= (ovllag[i] * 1000LL))
+            level = i + 1;
+    }
+    if ((lastready >= ovlready) && (level < OVL_NLEVEL))
+        level++;
+
+    if (level >= Overload) {
+        ovlcalm = 0;
+        if (level == Overload)
+            return;
+        Overload = level;
+    }
+    else if (++ovlcalm < OVL_CALM) {
+        return;
+    }
+    else {
+        ovlcalm = 0;
+        Overload--;
+    }
+
+    if (pslot->rsc[RSC_OVERLOAD].bkey != 0) {
+        len = show_load(buf, MXRPLY);
+        bcst_ui(buf, len, &(pslot->rsc[RSC_OVERLOAD].bkey));
+    }
+    return;
+}
+
+
+/***************************************************************************
+ * show_load():  - Put the overload level, the lag in ms, the most FDs
+ * ready at once, and the number of refused connections in buf.
+ * Returns the number of characters in buf.
+ ***************************************************************************/
+static int show_load(
+    char    *buf,         // where to put the load
+    int      size)        // size of buf
+{
+    int      len;
+
+    len = snprintf(buf, size, "%d %lld %d %u\n", Overload, (lastlag / 1000),
+                   lastready, OvlRefused);
+    return((len < size) ? len : size - 1);
+}
+
+
+/***************************************************************************
+ * list_cache():  - Put a line for each cached resource in buf.  Returns
+ * the number of characters in buf.
+ ***************************************************************************/
+static int list_cache(
+    char    *buf,         // where to put the list
+    int      size)        // size of buf
+{
+    ED_RSC  *ped;         // daemon state of a resource
+    long long now;        // current time in microseconds
+    int      islot;       // slot of a resource
+    int      irsc;        // resource index in slot
+    int      len = 0;     // bytes in buf
+
+    now = now_us();
+    for (islot = 0; islot < MX_PLUGIN; islot++) {
+        for (irsc = 0; irsc < Slots[islot].nrsc; irsc++) {
+            ped = (ED_RSC *) RSCPTR(&(Slots[islot]), irsc)->dpriv;
+            if ((ped == 0) || (ped->maxage == 0) || (len >= size))
+                continue;
+            len += snprintf(&(buf[len]), (size - len), "%s.%s %d %lld %u %u\n",
+                    Slots[islot].name, RSCPTR(&(Slots[islot]), irsc)->name, ped->maxage,
+                    ((ped->ctime) ? ((now - ped->ctime) / 1000) : -1),
+                    ped->chits, ped->cmiss);
+        }
+    }
+    // An empty list is an empty line.  Zero length means a deferred read.
+    if (len == 0)
+        len = snprintf(buf, size, "\n");
+    return((len < size) ? len : size - 1);
+}
+
+
+/***************************************************************************
+ * list_conns():  - Put a line for each open UI connection in buf.
+ * Returns the number of characters in buf.
+ ***************************************************************************/
+static int list_conns(
+    char    *buf,         // where to put the list
+    int      size)        // size of buf
+{
+    UI      *pui;         // a UI connection
+    ED_UISTAT *pst;       // its counters
+    struct in_addr ip;    // IP address of the peer
+    char     peer[40];    // IP:port or unix:uid of the peer
+    char     watch[MXCMD]; // plug-in.resource being watched
+    long long now;        // current time in microseconds
+    int      cn;          // index into UiCons
+    int      len = 0;     // bytes in buf
+
+    now = now_us();
+    for (cn = 0, pui = UiCons; (cn < MX_UI) && (len < size); cn++, pui++) {
+        if (pui->fd < 0)
+            continue;
+        pst = &(pui->stats);
+        if (pui->o_uid >= 0) {
+            (void) snprintf(peer, sizeof(peer), "unix:%d", pui->o_uid);
+        }
+        else {
+            ip.s_addr = (in_addr_t) pui->o_ip;
+            (void) snprintf(peer, sizeof(peer), "%s:%d", inet_ntoa(ip), pui->o_port);
+        }
+        if ((pui->bkey != 0) && (Slots[HANDLE2SLOT(pui->bkey)].name != 0) &&
+            (RSCPTR(&(Slots[HANDLE2SLOT(pui->bkey)]), HANDLE2RSC(pui->bkey))->name != 0)) {
+            (void) snprintf(watch, sizeof(watch), "%s.%s",
+                    Slots[HANDLE2SLOT(pui->bkey)].name,
+                    RSCPTR(&(Slots[HANDLE2SLOT(pui->bkey)]), HANDLE2RSC(pui->bkey))->name);
+        }
+        else {
+            (void) strncpy(watch, "-", sizeof(watch));
+        }
+        len += snprintf(&(buf[len]), (size - len),
+                "%d %s %lld %llu %llu %u/%u/%u/%u/%u/%u/%u/%u/%u/%u/%u/%u/%u %u %u %d %u %s\n",
+                cn, peer, ((now - pst->t_open) / 1000000), pst->nbin, pst->nbout,
+                pst->ncmd[0], pst->ncmd[EDGET], pst->ncmd[EDSET], pst->ncmd[EDCAT],
+                pst->ncmd[EDLIST], pst->ncmd[EDLOAD], pst->ncmd[EDPROTO],
+                pst->ncmd[EDRESOLVE], pst->ncmd[EDMGET], pst->ncmd[EDDUMP],
+                pst->ncmd[EDHIST], pst->ncmd[EDUNLOAD], pst->ncmd[EDRELOAD],
+                pst->nbcst, pst->bdrops, pst->omax, pst->nthrottle, watch);
+    }
+    // An empty list is an empty line.  Zero length means a deferred read.
+    if (len == 0)
+        len = snprintf(buf, size, "\n");
+    return((len < size) ? len : size - 1);
+}
+
+
+/***************************************************************************
+ * find_rsc():  - Find a resource given as plug-in.resource.  Returns the
+ * slot ID and puts the resource index in *pirsc, or returns -1 if there
+ * is no such resource.
+ ***************************************************************************/
+static int find_rsc(
+    char    *cname,       // plug-in.resource
+    int     *pirsc)       // where to put the resource index
+{
+    char    *pdot;        // the dot between the names
+    int      islot;       // the slot ID
+
+    pdot = strrchr(cname, '.');
+    if (pdot == 0)
+        return(-1);
+    *pdot = (char) 0;
+    islot = find_slot(cname);
+    *pdot = '.';
+    if ((islot < 0) || (Slots[islot].name == 0))
+        return(-1);
+    *pirsc = find_name(islot, pdot + 1);
+    return((*pirsc < 0) ? -1 : islot);
+}
+
+
+/***************************************************************************
+ * rscpriv():  - Return the daemon's state for a resource.  The state is
+ * allocated the first time it is needed.  Returns a null pointer if the
+ * allocation fails.
+ ***************************************************************************/
+ED_RSC *rscpriv(
+    RSC     *prsc)        // resource whose state we want
+{
+    if (prsc->dpriv == 0) {
+        prsc->dpriv = calloc(1, sizeof(ED_RSC));
+        if (prsc->dpriv == 0)
+            edlog(M_NOMEM, "rscpriv");
+    }
+    return((ED_RSC *) prsc->dpriv);
+}
+
+
+/***************************************************************************
+ * rscfree():  - Free the daemon's state for a resource that is going
+ * away with its plug-in.  Its ring, multicast group, history, replay
+ * buffer, and cached value all stop.  The caller clears RSC.dpriv.
+ ***************************************************************************/
+void rscfree(
+    ED_RSC  *ped)         // daemon state of the resource
+{
+    int      i;
+
+    if (ped == 0)
+        return;
+    close_ring(ped);
+    hist_close(ped);
+    if (ped->replay) {
+        for (i = 0; i < RPL_NENT; i++)
+            free(ped->replay[i].data);
+        free(ped->replay);
+    }
+    free(ped->cval);
+    free(ped);
+    return;
+}
+
+
+/***************************************************************************
+ * ed_cacheable():  - Let the daemon answer reads of a resource from its
+ * last value for up to maxage ms.  ED_CACHE_FOREVER keeps the value
+ * until the resource is set and zero stops caching.  Returns 0 on
+ * success or -1 on error.
+ ***************************************************************************/
+int ed_cacheable(
+    RSC     *prsc,        // the resource to cache
+    int      maxage)      // most age of a value in ms
+{
+    ED_RSC  *ped;         // daemon state of the resource
+
+    if ((prsc == 0) || (maxage < ED_CACHE_FOREVER) || (thr_slot() != 0))
+        return(-1);
+    if ((maxage == 0) && (prsc->dpriv == 0))
+        return(0);
+    ped = rscpriv(prsc);
+    if (ped == 0)
+        return(-1);
+    if ((maxage != 0) && (ped->cval == 0)) {
+        ped->cval = malloc(MXRPLY);
+        if (ped->cval == 0) {
+            edlog(M_NOMEM, "ed_cacheable");
+            return(-1);
+        }
+    }
+    ped->maxage = maxage;
+    ped->ctime = 0;
+    return(0);
+}
+
+
+/***************************************************************************
+ * ed_cache():  - Give the cache of a resource a new value.  A length of
+ * zero clears the value so the next read goes to the plug-in.  Values
+ * of resources that are not cached are ignored.
+ ***************************************************************************/
+void ed_cache(
+    RSC     *prsc,        // the resource
+    char    *buf,         // the value as edget would give it
+    int      len)         // number of chars in buf
+{
+    ED_RSC  *ped;         // daemon state of the resource
+
+    if (thr_route(THR_CACHE, 0, (void *) prsc, buf, len) == 0)
+        return;           // a plug-in thread, done in the daemon's loop
+    ped = (ED_RSC *) prsc->dpriv;
+    if ((ped == 0) || (ped->maxage == 0))
+        return;
+    if ((buf == 0) || (len <= 0) || (len > MXRPLY)) {
+        ped->ctime = 0;
+        return;
+    }
+    memcpy(ped->cval, buf, len);
+    ped->clen = len;
+    ped->ctime = now_us();
+    return;
+}
+
+
+/***************************************************************************
+ * cache_get():  - Look for a fresh value of a resource in its cache.
+ * Returns the length of the value and points *pbuf at it, or returns -1
+ * if the plug-in must be asked.
+ ***************************************************************************/
+int cache_get(
+    RSC     *prsc,        // the resource to read
+    char   **pbuf)        // set to the cached value
+{
+    ED_RSC  *ped;         // daemon state of the resource
+
+    ped = (ED_RSC *) prsc->dpriv;
+    if ((ped == 0) || (ped->maxage == 0))
+        return(-1);
+    if ((ped->ctime == 0) || ((ped->maxage > 0) &&
+        ((now_us() - ped->ctime) > (ped->maxage * 1000LL)))) {
+        ped->cmiss++;
+        return(-1);
+    }
+    ped->chits++;
+    *pbuf = ped->cval;
+    return(ped->clen);
+}
+
+
+/***************************************************************************
+ * open_ring():  - Create the shared memory ring for a resource.  Any
+ * old ring for the resource is removed first.  The number of entries
+ * is rounded up to a power of two.  Returns 0 on success, -1 on error.
+ ***************************************************************************/
+static int open_ring(
+    RSC     *prsc,        // resource to publish
+    int      handle,      // slot/rsc of resource
+    int      nent,        // number of entries wanted
+    int      datasz)      // maximum bytes of data per entry
+{
+    ED_RSC  *ped;         // daemon state of the resource
+    ED_RING *pr;          // the new ring
+    SLOT    *pslot;       // slot of the resource
+    int      entsz;       // bytes per entry, a multiple of 8
+    int      n;           // nent as a power of two
+    int      fd;
+
+    ped = rscpriv(prsc);
+    if (ped == 0)
+        return(-1);
+    close_ring(ped);
+
+    for (n = 1; n < nent; n <<= 1)
+        ;
+    entsz = (ED_RENT_HDRSZ + datasz + 7) & ~7;
+    pslot = &(Slots[HANDLE2SLOT(handle)]);
+    (void) snprintf(ped->ringname, MX_RINGNAME, "/%s-%s.%s", CPREFIX,
+                    pslot->name, prsc->name);
+    ped->ringsz = ED_RING_HDRSZ + (n * entsz);
+
+    // Readers must be root or the daemon's user, as on the Unix socket
+    (void) shm_unlink(ped->ringname);
+    fd = shm_open(ped->ringname, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+        edlog(M_NOOPEN, ped->ringname, strerror(errno));
+        return(-1);
+    }
+    if (ftruncate(fd, ped->ringsz) < 0) {
+        edlog(M_NOOPEN, ped->ringname, strerror(errno));
+        close(fd);
+        (void) shm_unlink(ped->ringname);
+        return(-1);
+    }
+    pr = (ED_RING *) mmap((void *) 0, ped->ringsz, PROT_READ | PROT_WRITE,
+                          MAP_SHARED, fd, 0);
+    close(fd);
+    if (pr == (ED_RING *) MAP_FAILED) {
+        edlog(M_NOOPEN, ped->ringname, strerror(errno));
+        (void) shm_unlink(ped->ringname);
+        return(-1);
+    }
+
+    // The new memory is all zeros.  Fill in the header, magic last.
+    pr->nent = n;
+    pr->entsz = entsz;
+    pr->slot = HANDLE2SLOT(handle);
+    pr->rsc = HANDLE2RSC(handle);
+    pr->head = 0;
+    __atomic_store_n(&pr->magic, ED_RING_MAGIC, __ATOMIC_RELEASE);
+    ped->ring = (void *) pr;
+    return(0);
+}
+
+
+/***************************************************************************
+ * close_ring():  - Remove the shared memory ring of a resource.
+ * Readers that still have the ring mapped see no new samples.
+ ***************************************************************************/
+static void close_ring(
+    ED_RSC  *ped)         // daemon state of the resource
+{
+    if (ped->ring == 0)
+        return;
+    (void) munmap(ped->ring, ped->ringsz);
+    (void) shm_unlink(ped->ringname);
+    ped->ring = (void *) 0;
+    ped->ringsz = 0;
+    ped->ringname[0] = (char) 0;
+    return;
+}
+
+
+/***************************************************************************
+ * open_mcast():  - Point the multicast output of a resource at the group
+ * given as address:port.  The system picks the interface unless the
+ * address of one is given.  The socket for multicast output is opened
+ * the first time it is needed.  Returns 0 on success, -1 on error.
+ ***************************************************************************/
+static int open_mcast(
+    ED_RSC  *ped,         // daemon state of the resource
+    char    *caddr,       // multicast address:port
+    char    *cifaddr)     // address of interface to use, or null
+{
+    struct sockaddr_in mcaddr; // the group and port
+    struct in_addr ifaddr; // address of interface to send on
+    char    *pcolon;      // the colon before the port
+    int      port;        // the UDP port
+    unsigned char ttl = MCAST_TTL;
+    unsigned char loop = 1;
+
+    pcolon = strrchr(caddr, ':');
+    if (pcolon == 0)
+        return(-1);
+    *pcolon = (char) 0;
+    (void) memset((void *) &mcaddr, 0, sizeof(struct sockaddr_in));
+    mcaddr.sin_family = AF_INET;
+    if ((inet_aton(caddr, &(mcaddr.sin_addr)) == 0) ||
+        (!IN_MULTICAST(ntohl(mcaddr.sin_addr.s_addr))) ||
+        (sscanf(pcolon + 1, "%d", &port) != 1) || (port <= 0) || (port > 65535))
+        return(-1);
+    mcaddr.sin_port = htons(port);
+    if ((cifaddr != 0) && (inet_aton(cifaddr, &ifaddr) == 0))
+        return(-1);
+
+    if (mcastfd < 0) {
+        mcastfd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+        if (mcastfd < 0) {
+            edlog(M_NOOPEN, "multicast socket", strerror(errno));
+            return(-1);
+        }
+        // Listeners on this host get the datagrams too
+        (void) setsockopt(mcastfd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+        (void) setsockopt(mcastfd, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+    }
+    // All groups share the socket so the interface is for all of them
+    if ((cifaddr != 0) &&
+        (setsockopt(mcastfd, IPPROTO_IP, IP_MULTICAST_IF, &ifaddr, sizeof(ifaddr)) < 0))
+        return(-1);
+    ped->mcaddr = mcaddr;
+    ped->mcast = 1;
+    return(0);
+}
+
+
+/***************************************************************************
+ * send_mcast():  - Send a broadcast to the multicast group of the
+ * resource as a binary protocol frame.  A lost datagram is not an
+ * error.  Receivers see the gap in the sequence numbers.
+ ***************************************************************************/
+static void send_mcast(
+    ED_RSC  *ped,         // daemon state of the resource
+    int      bkey,        // slot/rsc of the broadcast
+    char    *buf,         // the broadcast data
+    int      len,         // number of bytes in buf
+    int      ptype)       // ED_PT_TEXT or ED_PT_VALUES
+{
+    unsigned char dgram[ED_FRHDRSZ + MXRPLY]; // frame header and payload
+
+    len = (len > MXRPLY) ? MXRPLY : len;
+    mkframe(dgram, ED_FR_BCST, ptype, HANDLE2SLOT(bkey), HANDLE2RSC(bkey),
+            0, ped->bseq, now_us(), len);
+    memcpy(&(dgram[ED_FRHDRSZ]), buf, len);
+    (void) sendto(mcastfd, dgram, (ED_FRHDRSZ + len), 0,
+                  (struct sockaddr *) &(ped->mcaddr), sizeof(struct sockaddr_in));
+    return;
+}
+
+
+/***************************************************************************
+ * core_seq():  - Count a broadcast of a resource and return its
+ * sequence number.  The first broadcast is number 1.  This is called
+ * by bcst_ui() before the broadcast goes to any listener.
+ ***************************************************************************/
+unsigned int core_seq(
+    int      bkey)        // slot/rsc of the broadcast
+{
+    ED_RSC  *ped;         // daemon state of the resource
+
+    if ((HANDLE2SLOT(bkey) >= MX_PLUGIN) || (HANDLE2RSC(bkey) >= Slots[HANDLE2SLOT(bkey)].nrsc))
+        return(0);
+    ped = rscpriv(RSCPTR(&(Slots[HANDLE2SLOT(bkey)]), HANDLE2RSC(bkey)));
+    if (ped == 0)
+        return(0);
+    return(++(ped->bseq));
+}
+
+
+/***************************************************************************
+ * replay_on():  - Turn on the replay buffer of a resource if it is not
+ * on already and note that a UI is watching.  The broadcasts before
+ * it was turned on were never kept.  Returns the daemon's state for
+ * the resource, or a null pointer if out of memory.
+ ***************************************************************************/
+ED_RSC *replay_on(
+    RSC     *prsc)        // resource to keep broadcasts of
+{
+    ED_RSC  *ped;         // daemon state of the resource
+
+    ped = rscpriv(prsc);
+    if (ped == 0)
+        return((ED_RSC *) 0);
+    if (ped->replay == 0) {
+        ped->replay = calloc(RPL_NENT, sizeof(ED_RPLENT));
+        if (ped->replay == 0) {
+            edlog(M_NOMEM, "replay_on");
+            return((ED_RSC *) 0);
+        }
+        ped->rplseq = ped->bseq;
+    }
+    ped->tlisten = now_us();
+    return(ped);
+}
+
+
+/***************************************************************************
+ * keep_bcst():  - Copy a broadcast into the replay buffer.  The copy of
+ * an entry is only reallocated when a broadcast is bigger than any
+ * before it in that entry.
+ ***************************************************************************/
+static void keep_bcst(
+    ED_RSC  *ped,         // daemon state of the resource
+    char    *buf,         // the broadcast data
+    int      len,         // number of bytes in buf
+    long long ts)         // time of the broadcast
+{
+    ED_RPLENT *pe;        // entry for this broadcast
+    char    *pdata;       // new space for the copy
+
+    pe = &(ped->replay[ped->bseq % RPL_NENT]);
+    if (pe->size < len) {
+        pdata = realloc(pe->data, len);
+        if (pdata == 0) {
+            pe->seq = 0;  // lost, replay will report a gap
+            return;
+        }
+        pe->data = pdata;
+        pe->size = len;
+    }
+    memcpy(pe->data, buf, len);
+    pe->len = len;
+    pe->ts = ts;
+    pe->seq = ped->bseq;
+    return;
+}
+
+
+/***************************************************************************
+ * core_listens():  - Return non-zero if the daemon itself listens to a
+ * resource with a ring, multicast group, or history, or with a replay
+ * buffer that a UI watched in the last RPL_LINGER seconds.
+ ***************************************************************************/
+int core_listens(
+    int      bkey)        // slot/rsc of the resource
+{
+    ED_RSC  *ped;         // daemon state of the resource
+
+    if ((HANDLE2SLOT(bkey) >= MX_PLUGIN) || (HANDLE2RSC(bkey) >= Slots[HANDLE2SLOT(bkey)].nrsc))
+        return(0);
+    ped = (ED_RSC *) RSCPTR(&(Slots[HANDLE2SLOT(bkey)]), HANDLE2RSC(bkey))->dpriv;
+    if (ped == 0)
+        return(0);
+    if (ped->ring || ped->mcast || ped->hist)
+        return(1);
+    return((ped->replay != 0) &&
+           ((now_us() - ped->tlisten) < (RPL_LINGER * 1000000LL)));
+}
+
+
+/***************************************************************************
+ * core_bcst():  - Give a broadcast to the daemon's own listeners of the
+ * resource.  This is called by bcst_ui() for every broadcast after
+ * core_seq().  Rings and replay buffers hold the ASCII form of the
+ * sample, multicast sends the binary form, and a history keeps the
+ * values.  Returns non-zero if the daemon is a listener so
+ * bcst_ui() keeps the bkey set even when no UI is watching.  A resource
+ * with a replay buffer keeps broadcasting for RPL_LINGER seconds after
+ * the last UI stops watching so a UI that reconnects can catch up.
+ ***************************************************************************/
+int core_bcst(
+    int      bkey,        // slot/rsc of the broadcast
+    ED_SAMPLE *ps,        // the broadcast data
+    int      nlisten)     // non-zero if a UI is watching the resource
+{
+    char    *buf;         // the sample in an encoding
+    int      len;         // number of bytes in buf
+    ED_RSC  *ped;         // daemon state of the resource
+    ED_RING *pr;          // the resource's ring
+    ED_RENT *pe;          // the entry to fill
+    uint64_t n;           // number of this sample
+    long long now = 0;    // time of the broadcast
+    int      keep = 0;    // set to keep the bkey
+    const ED_VALUE *vals; // the sample as values
+    int      nval;        // number of values
+
+    if ((HANDLE2SLOT(bkey) >= MX_PLUGIN) || (HANDLE2RSC(bkey) >= Slots[HANDLE2SLOT(bkey)].nrsc))
+        return(0);
+    ped = (ED_RSC *) RSCPTR(&(Slots[HANDLE2SLOT(bkey)]), HANDLE2RSC(bkey))->dpriv;
+    if (ped == 0)
+        return(0);
+
+    if (ped->replay) {
+        now = now_us();
+        buf = smp_text(ps, &len);
+        keep_bcst(ped, buf, len, now);
+        if (nlisten)
+            ped->tlisten = now;
+        keep = ((now - ped->tlisten) < (RPL_LINGER * 1000000LL));
+    }
+    if (ped->mcast) {
+        buf = smp_bin(ps, &len);
+        send_mcast(ped, bkey, buf, len, smp_ptype(ps));
+    }
+    if (ped->hist) {
+        now = (now) ? now : now_us();
+        vals = smp_values(ps, &nval);
+        hist_add(ped->hist, vals, nval, now);
+        keep = 1;
+    }
+    if (ped->ring == 0)
+        return(ped->mcast || keep);
+
+    // Seqlock the entry while the sample is copied into it
+    buf = smp_text(ps, &len);
+    pr = (ED_RING *) ped->ring;
+    n = pr->head;
+    pe = ED_RENT(pr, n);
+    len = (len > (int) (pr->entsz - ED_RENT_HDRSZ)) ? (int) (pr->entsz - ED_RENT_HDRSZ) : len;
+    __atomic_store_n(&pe->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    pe->ts = (uint64_t) ((now) ? now : now_us());
+    pe->len = (uint32_t) len;
+    memcpy(pe->data, buf, len);
+    __atomic_store_n(&pe->seq, n + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&pr->head, n + 1, __ATOMIC_RELEASE);
+    return(1);
+}
+
+// end of core.c
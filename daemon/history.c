@@ -0,0 +1,487 @@
+/*
+ * Name: history.c
+ *
+ * Description: This file keeps a history of the broadcasts of a
+ *              resource and answers the edhist command.  Samples are
+ *              kept as typed values in columns, one array for the times
+ *              and one for each value, rather than as lines of text.  A
+ *              history is sized in samples or in seconds.  One sized in
+ *              seconds grows until it holds that many seconds of data.
+ *
+ * Copyright:   Copyright (C) 2019 by Demand Peripherals, Inc.
+ *              All rights reserved.
+ *
+ * License:     This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the Version 2 of the GNU General
+ *              Public License as published by the Free Software Foundation.
+ *              GPL2.txt in the top level directory is a copy of this license.
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *              GNU General Public License for more details.
+ *
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "main.h"
+
+
+/***************************************************************************
+ *  - Limits and defines
+ ***************************************************************************/
+        // A since below this is seconds before now, not a Unix time
+#define HIST_RELSECS       1000000000.0
+
+
+/***************************************************************************
+ *  - Function prototypes, forward references, and externs
+ ***************************************************************************/
+int             hist_open(ED_RSC *, int, int);
+void            hist_close(ED_RSC *);
+void            hist_add(ED_HIST *, const ED_VALUE *, int, long long);
+void            do_hist(UI *, int, int, char *);
+int             list_hist(char *, int);
+static int      hist_grow(ED_HIST *, int);
+static int      hist_cols(ED_HIST *, int);
+static int      hist_find(ED_HIST *, long long);
+static int      hist_row(ED_HIST *, unsigned long long, ED_VALUE *, char (*)[HIST_TXTSZ]);
+extern int      fmt_values(char *, int, const ED_VALUE *, int);
+extern long long now_us();
+extern SLOT     Slots[];       // table of plug-in info
+
+
+/***************************************************************************
+ * hist_open(): - Start a history for a resource, dropping any old one.
+ * Give the number of samples to keep or the number of seconds.  Returns
+ * 0 on success or -1 on error.
+ ***************************************************************************/
+int hist_open(
+    ED_RSC  *ped,         // daemon state of the resource
+    int      nent,        // samples to keep, or 0
+    int      secs)        // seconds of samples to keep, or 0
+{
+    ED_HIST *ph;          // the new history
+
+    hist_close(ped);
+    ph = calloc(1, sizeof(ED_HIST));
+    if (ph == 0) {
+        edlog(M_NOMEM, "hist_open");
+        return(-1);
+    }
+    ph->nent = nent;
+    ph->secs = secs;
+    if (hist_grow(ph, ((nent) ? nent : HIST_MINENT)) < 0) {
+        free(ph);
+        return(-1);
+    }
+    ped->hist = ph;
+    return(0);
+}
+
+
+/***************************************************************************
+ * hist_close(): - Free the history of a resource.
+ ***************************************************************************/
+void hist_close(
+    ED_RSC  *ped)         // daemon state of the resource
+{
+    ED_HIST *ph;          // the history to free
+    int      i;
+
+    ph = ped->hist;
+    if (ph == 0)
+        return;
+    for (i = 0; i < ph->ncol; i++) {
+        free(ph->type[i]);
+        free(ph->val[i]);
+    }
+    free(ph->ts);
+    free(ph->nval);
+    free(ph);
+    ped->hist = (ED_HIST *) 0;
+    return;
+}
+
+
+/***************************************************************************
+ * hist_grow(): - Set the number of samples in each column, keeping the
+ * samples in the history.  Samples are moved so that sample n is at
+ * n % size in the new columns.  Returns 0 on success or -1 on error.
+ ***************************************************************************/
+static int hist_grow(
+    ED_HIST *ph,          // the history
+    int      nsize)       // new number of samples
+{
+    long long *nts;       // new time column
+    unsigned char *nnval; // new value count column
+    unsigned char *ntype[HIST_NCOL]; // new type columns
+    long long *nval[HIST_NCOL]; // new value columns
+    unsigned long long n; // sample being moved
+    unsigned long long tail; // oldest sample kept
+    int      i;
+
+    nts = malloc(nsize * sizeof(long long));
+    nnval = malloc(nsize);
+    for (i = 0; i < ph->ncol; i++) {
+        ntype[i] = malloc(nsize);
+        nval[i] = malloc(nsize * sizeof(long long));
+        if ((ntype[i] == 0) || (nval[i] == 0))
+            break;
+    }
+    if ((nts == 0) || (nnval == 0) || (i < ph->ncol)) {
+        edlog(M_NOMEM, "hist_grow");
+        while (i >= 0) {
+            if (i < ph->ncol) {
+                free(ntype[i]);
+                free(nval[i]);
+            }
+            i--;
+        }
+        free(nts);
+        free(nnval);
+        return(-1);
+    }
+
+    // Keep the newest samples that fit
+    tail = (ph->head > (unsigned long long) ph->size) ? ph->head - ph->size : 0;
+    if (ph->head - tail > (unsigned long long) nsize)
+        tail = ph->head - nsize;
+    for (n = tail; n < ph->head; n++) {
+        nts[n % nsize] = ph->ts[n % ph->size];
+        nnval[n % nsize] = ph->nval[n % ph->size];
+        for (i = 0; i < ph->ncol; i++) {
+            ntype[i][n % nsize] = ph->type[i][n % ph->size];
+            nval[i][n % nsize] = ph->val[i][n % ph->size];
+        }
+    }
+    free(ph->ts);
+    free(ph->nval);
+    ph->ts = nts;
+    ph->nval = nnval;
+    for (i = 0; i < ph->ncol; i++) {
+        free(ph->type[i]);
+        free(ph->val[i]);
+        ph->type[i] = ntype[i];
+        ph->val[i] = nval[i];
+    }
+    ph->size = nsize;
+    return(0);
+}
+
+
+/***************************************************************************
+ * hist_cols(): - Make sure the history has at least ncol value columns.
+ * Returns the number of columns it has.
+ ***************************************************************************/
+static int hist_cols(
+    ED_HIST *ph,          // the history
+    int      ncol)        // number of columns needed
+{
+    ncol = (ncol < HIST_NCOL) ? ncol : HIST_NCOL;
+    while (ph->ncol < ncol) {
+        // Older samples have no value in the new column
+        ph->type[ph->ncol] = calloc(ph->size, 1);
+        ph->val[ph->ncol] = calloc(ph->size, sizeof(long long));
+        if ((ph->type[ph->ncol] == 0) || (ph->val[ph->ncol] == 0)) {
+            edlog(M_NOMEM, "hist_cols");
+            free(ph->type[ph->ncol]);
+            free(ph->val[ph->ncol]);
+            break;
+        }
+        ph->ncol++;
+    }
+    return(ph->ncol);
+}
+
+
+/***************************************************************************
+ * hist_add(): - Add a sample to a history.  A history sized in seconds
+ * doubles in size rather than drop a sample younger than its span.
+ ***************************************************************************/
+void hist_add(
+    ED_HIST *ph,          // the history
+    const ED_VALUE *vals, // the values of the sample
+    int      n,           // number of values
+    long long now)        // time of the sample in microseconds
+{
+    unsigned long long tail; // oldest sample kept
+    int      idx;         // where the sample goes in each column
+    int      i;
+
+    tail = (ph->head > (unsigned long long) ph->size) ? ph->head - ph->size : 0;
+    if ((ph->secs) && (ph->head - tail == (unsigned long long) ph->size) &&
+        ((now - ph->ts[tail % ph->size]) < (ph->secs * 1000000LL)) &&
+        (ph->size < HIST_MXENT)) {
+        (void) hist_grow(ph, ((2 * ph->size < HIST_MXENT) ? 2 * ph->size : HIST_MXENT));
+    }
+
+    n = hist_cols(ph, n);
+    idx = ph->head % ph->size;
+    ph->ts[idx] = now;
+    ph->nval[idx] = n;
+    for (i = 0; i < n; i++) {
+        ph->type[i][idx] = vals[i].type;
+        if (vals[i].type == ED_VT_FLOAT) {
+            memcpy(&(ph->val[i][idx]), &(vals[i].v.d), sizeof(long long));
+        }
+        else if (vals[i].type == ED_VT_TEXT) {
+            ph->val[i][idx] = 0;
+            strncpy((char *) &(ph->val[i][idx]), ((vals[i].v.s) ? vals[i].v.s : ""),
+                    HIST_TXTSZ - 1);
+        }
+        else {
+            ph->val[i][idx] = vals[i].v.i;
+        }
+        ph->fmt[i].width = vals[i].width;
+        ph->fmt[i].prec = (vals[i].type == ED_VT_FLOAT) ? vals[i].prec : 0;
+    }
+    ph->head++;
+    return;
+}
+
+
+/***************************************************************************
+ * hist_find(): - Return the number of the first sample at or after the
+ * given time.  The times are in order so this is a binary search.
+ ***************************************************************************/
+static int hist_find(
+    ED_HIST *ph,          // the history
+    long long start)      // time in microseconds
+{
+    unsigned long long lo; // first sample that might be it
+    unsigned long long hi; // one past the last sample that might be it
+    unsigned long long mid;
+
+    lo = (ph->head > (unsigned long long) ph->size) ? ph->head - ph->size : 0;
+    hi = ph->head;
+    while (lo < hi) {
+        mid = lo + ((hi - lo) / 2);
+        if (ph->ts[mid % ph->size] < start)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return((int) (lo - ((ph->head > (unsigned long long) ph->size) ? ph->head - ph->size : 0)));
+}
+
+
+/***************************************************************************
+ * hist_row(): - Put the time and values of sample n into vals.  Text
+ * values are copied into txt.  Returns the number of values in vals.
+ ***************************************************************************/
+static int hist_row(
+    ED_HIST *ph,          // the history
+    unsigned long long n, // the sample
+    ED_VALUE *vals,       // where to put the values, 1 + HIST_NCOL of them
+    char   (*txt)[HIST_TXTSZ]) // room for the text values
+{
+    int      idx;         // the sample in each column
+    int      nval;        // number of values in the sample
+    int      i;
+
+    idx = n % ph->size;
+    vals[0].type = ED_VT_TS;
+    vals[0].width = 0;
+    vals[0].v.i = ph->ts[idx];
+    nval = ph->nval[idx];
+    for (i = 0; i < nval; i++) {
+        vals[i + 1] = ph->fmt[i];
+        vals[i + 1].type = ph->type[i][idx];
+        if (vals[i + 1].type == ED_VT_FLOAT) {
+            memcpy(&(vals[i + 1].v.d), &(ph->val[i][idx]), sizeof(double));
+        }
+        else if (vals[i + 1].type == ED_VT_TEXT) {
+            memcpy(txt[i], &(ph->val[i][idx]), HIST_TXTSZ);
+            txt[i][HIST_TXTSZ - 1] = (char) 0;
+            vals[i + 1].v.s = txt[i];
+        }
+        else {
+            vals[i + 1].v.i = ph->val[i][idx];
+        }
+    }
+    return(nval + 1);
+}
+
+
+/***************************************************************************
+ * do_hist(): - Send the history of a resource to a UI.  The optional
+ * arguments are the time to start from, as seconds before now or as a
+ * Unix time, and the width of a bucket in seconds.  With no bucket each
+ * sample is a line with its time and values.  With a bucket each line
+ * has the start of the bucket, the number of samples in it, and the
+ * mean of each integer and float.  Other values show the last one in
+ * the bucket.
+ ***************************************************************************/
+void do_hist(
+    UI      *pui,         // UI asking for the history
+    int      islot,       // slot of the resource
+    int      irsc,        // resource index in the slot
+    char    *args)        // [since] [bucket]
+{
+    static char out[MX_MGET]; // the reply
+    int      olen = 0;    // length of reply so far
+    ED_RSC  *ped;         // daemon state of the resource
+    ED_HIST *ph;          // its history
+    double   since = 0.0; // where to start
+    double   bucket = 0.0; // seconds per bucket, 0 for every sample
+    long long start = 0;  // first time to send in microseconds
+    long long width;      // bucket width in microseconds
+    long long bstart = 0; // start of the bucket being summed
+    unsigned long long n; // sample being sent
+    ED_VALUE row[1 + HIST_NCOL]; // time and values of a sample
+    char     txt[HIST_NCOL][HIST_TXTSZ]; // text values of a sample
+    ED_VALUE brow[2 + HIST_NCOL]; // a bucket
+    ED_VALUE blast[HIST_NCOL]; // last values of a bucket
+    char     btxt[HIST_NCOL][HIST_TXTSZ]; // last text values of a bucket
+    double   sum[HIST_NCOL]; // sums of the numbers in a bucket
+    int      nsum[HIST_NCOL]; // count of the numbers in a bucket
+    int      bcount = 0;  // samples in the bucket
+    int      ncol = 0;    // most values in a sample of the bucket
+    int      nrow;        // values in row
+    int      i;
+
+    ped = (ED_RSC *) RSCPTR(&(Slots[islot]), irsc)->dpriv;
+    ph = (ped) ? ped->hist : (ED_HIST *) 0;
+    if (ph == 0) {
+        olen = snprintf(out, MXRPLY, E_NOHIST, RSCPTR(&(Slots[islot]), irsc)->name);
+        send_ui(out, olen, pui->cn);
+        prompt(pui->cn);
+        return;
+    }
+    if ((args != 0) && ((sscanf(args, "%lf %lf", &since, &bucket) < 1) ||
+        (since < 0.0) || (bucket < 0.0))) {
+        olen = snprintf(out, MXRPLY, E_BDVAL, RSCPTR(&(Slots[islot]), irsc)->name);
+        send_ui(out, olen, pui->cn);
+        prompt(pui->cn);
+        return;
+    }
+    if (since >= HIST_RELSECS)
+        start = (long long) (since * 1000000.0);
+    else if (since > 0.0)
+        start = now_us() - (long long) (since * 1000000.0);
+    width = (long long) (bucket * 1000000.0);
+
+    n = ((ph->head > (unsigned long long) ph->size) ? ph->head - ph->size : 0) +
+        hist_find(ph, start);
+    for ( ; n <= ph->head; n++) {
+        // Send what we have if the next line might not fit
+        if (olen > MX_MGET - MXRPLY) {
+            send_ui(out, olen, pui->cn);
+            olen = 0;
+        }
+        if (width <= 0) {
+            if (n == ph->head)
+                break;
+            nrow = hist_row(ph, n, row, txt);
+            olen += fmt_values(&(out[olen]), MXRPLY, row, nrow);
+            continue;
+        }
+
+        // Close the bucket at the end or when the sample is past it
+        if ((bcount > 0) && ((n == ph->head) || (ph->ts[n % ph->size] >= bstart + width))) {
+            brow[0].type = ED_VT_TS;
+            brow[0].width = 0;
+            brow[0].v.i = bstart;
+            brow[1].type = ED_VT_INT;
+            brow[1].width = 0;
+            brow[1].v.i = bcount;
+            for (i = 0; i < ncol; i++) {
+                if (nsum[i] > 0) {
+                    brow[i + 2].type = ED_VT_FLOAT;
+                    brow[i + 2].width = ph->fmt[i].width;
+                    brow[i + 2].prec = (ph->fmt[i].prec > 3) ? ph->fmt[i].prec : 3;
+                    brow[i + 2].v.d = sum[i] / nsum[i];
+                }
+                else {
+                    brow[i + 2] = blast[i];
+                }
+            }
+            olen += fmt_values(&(out[olen]), MXRPLY, brow, ncol + 2);
+            bcount = 0;
+        }
+        if (n == ph->head)
+            break;
+        if (bcount == 0) {
+            bstart = ph->ts[n % ph->size] - (ph->ts[n % ph->size] % width);
+            ncol = 0;
+            for (i = 0; i < HIST_NCOL; i++) {
+                sum[i] = 0.0;
+                nsum[i] = 0;
+                blast[i].type = ED_VT_TEXT;
+                blast[i].width = 0;
+                blast[i].v.s = "-";
+            }
+        }
+        nrow = hist_row(ph, n, row, txt);
+        for (i = 0; i < nrow - 1; i++) {
+            if (row[i + 1].type == ED_VT_FLOAT) {
+                sum[i] += row[i + 1].v.d;
+                nsum[i]++;
+            }
+            else if (row[i + 1].type == ED_VT_INT) {
+                sum[i] += (double) row[i + 1].v.i;
+                nsum[i]++;
+            }
+            else {
+                blast[i] = row[i + 1];
+                if (blast[i].type == ED_VT_TEXT) {
+                    memcpy(btxt[i], txt[i], HIST_TXTSZ);
+                    blast[i].v.s = btxt[i];
+                }
+            }
+        }
+        ncol = (nrow - 1 > ncol) ? nrow - 1 : ncol;
+        bcount++;
+    }
+    send_ui(out, olen, pui->cn);
+    prompt(pui->cn);
+    return;
+}
+
+
+/***************************************************************************
+ * list_hist(): - Put a line for each resource with a history in buf:
+ * its name, the samples or seconds it keeps, the samples it has, and
+ * the seconds they span.  Returns the number of characters in buf.
+ ***************************************************************************/
+int list_hist(
+    char    *buf,         // where to put the list
+    int      size)        // size of buf
+{
+    ED_RSC  *ped;         // daemon state of a resource
+    ED_HIST *ph;          // its history
+    unsigned long long nkept; // samples in the history
+    long long span = 0;   // microseconds from the oldest to newest sample
+    int      islot;       // slot of a resource
+    int      irsc;        // resource index in slot
+    int      len = 0;     // bytes in buf
+
+    for (islot = 0; islot < MX_PLUGIN; islot++) {
+        for (irsc = 0; irsc < Slots[islot].nrsc; irsc++) {
+            ped = (ED_RSC *) RSCPTR(&(Slots[islot]), irsc)->dpriv;
+            if ((ped == 0) || (ped->hist == 0) || (len >= size))
+                continue;
+            ph = ped->hist;
+            nkept = (ph->head < (unsigned long long) ph->size) ? ph->head : ph->size;
+            if (nkept > 0)
+                span = ph->ts[(ph->head - 1) % ph->size] - ph->ts[(ph->head - nkept) % ph->size];
+            if (ph->secs)
+                len += snprintf(&(buf[len]), (size - len), "%s.%s %ds %llu %lld.%03lld\n",
+                        Slots[islot].name, RSCPTR(&(Slots[islot]), irsc)->name, ph->secs,
+                        nkept, (span / 1000000), ((span / 1000) % 1000));
+            else
+                len += snprintf(&(buf[len]), (size - len), "%s.%s %d %llu %lld.%03lld\n",
+                        Slots[islot].name, RSCPTR(&(Slots[islot]), irsc)->name, ph->nent,
+                        nkept, (span / 1000000), ((span / 1000) % 1000));
+        }
+    }
+    // An empty list is an empty line.  Zero length means a deferred read.
+    if (len == 0)
+        len = snprintf(buf, size, "\n");
+    return((len < size) ? len : size - 1);
+}
+
+// end of history.c
@@ -0,0 +1,330 @@
+/*
+ * Name: http.c
+ *
+ * Description: This file contains code to serve resources to web
+ *              browsers and dashboards over HTTP.  A GET of
+ *              /rsc/<slot>/<name> returns the current value of the
+ *              resource.  The same GET with 'Accept: text/event-stream'
+ *              streams its broadcasts as server-sent events.  HTTP
+ *              clients use the same UI table, output queue, and
+ *              broadcast path as the command line clients.
+ *
+ * Copyright:   Copyright (C) 2019 by Demand Peripherals, Inc.
+ *              All rights reserved.
+ *
+ * License:     This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the Version 2 of the GNU General
+ *              Public License as published by the Free Software Foundation.
+ *              GPL2.txt in the top level directory is a copy of this license.
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *              GNU General Public License for more details.
+ *
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>   /* for strncasecmp() */
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include "main.h"
+
+
+/***************************************************************************
+ *  - Limits and defines
+ ***************************************************************************/
+        // Path prefix of a resource
+#define HTTP_RSCPATH       "/rsc/"
+        // Reply headers.  Every reply but an event stream closes the connection.
+#define HTTP_TEXTHDR       "HTTP/1.1 200 OK\r\n" \
+                           "Content-Type: text/plain\r\n" \
+                           "Cache-Control: no-cache\r\n" \
+                           "Connection: close\r\n\r\n"
+#define HTTP_SSEHDR        "HTTP/1.1 200 OK\r\n" \
+                           "Content-Type: text/event-stream\r\n" \
+                           "Cache-Control: no-cache\r\n" \
+                           "Connection: keep-alive\r\n\r\n"
+#define HTTP_ERRHDR        "HTTP/1.1 %d %s\r\n" \
+                           "Content-Type: text/plain\r\n" \
+                           "Content-Length: %d\r\n" \
+                           "Connection: close\r\n\r\n%d %s\n"
+
+
+/***************************************************************************
+ *  - Function prototypes, forward references, and externs
+ ***************************************************************************/
+void            open_http_port();
+void            http_line(UI *, char *, int);
+void            http_reply(UI *, char *, int);
+int             http_event(char *, int, unsigned int, char *, int);
+static void     http_request(UI *);
+static void     http_error(UI *, int);
+extern void     open_ui_conn(int, int);
+extern void     send_iov(int, unsigned char *, int, char *, int, int);
+extern void     do_get(UI *, int, int, char *);
+extern void     do_cat(UI *, int, int, char *);
+extern void     do_replay(UI *, int, unsigned int);
+extern ED_RSC  *replay_on(RSC *);
+extern int      find_slot(char *);
+extern int      find_name(int, char *);
+extern SLOT     Slots[];       // table of plug-in info
+extern int      HttpPort;      // TCP port for HTTP clients
+extern int      UiaddrAny;     // Use any IP address if set
+
+
+/***************************************************************************
+ *  - Variable allocation and initialization
+ ***************************************************************************/
+int      httpfd = -1;          // FD to the listening HTTP socket
+
+
+/***************************************************************************
+ * open_http_port(): - Open the HTTP listen port.  Connections are
+ * accepted by open_ui_conn() into the UI table like any other UI.
+ ***************************************************************************/
+void open_http_port()
+{
+    struct sockaddr_in srvskt;
+    int      adrlen;
+    int      on = 1;
+
+    adrlen = sizeof(struct sockaddr_in);
+    (void) memset((void *) &srvskt, 0, (size_t) adrlen);
+    srvskt.sin_family = AF_INET;
+    srvskt.sin_addr.s_addr = (UiaddrAny) ? htonl(INADDR_ANY) : htonl(INADDR_LOOPBACK);
+    srvskt.sin_port = htons(HttpPort);
+    if ((httpfd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0)) < 0) {
+        edlog(M_BADCONN, strerror(errno));
+        return;
+    }
+    (void) setsockopt(httpfd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    if ((bind(httpfd, (struct sockaddr *) &srvskt, adrlen) < 0) ||
+        (listen(httpfd, UI_BACKLOG) < 0)) {
+        edlog(M_BADCONN, strerror(errno));
+        close(httpfd);
+        httpfd = -1;
+        return;
+    }
+    add_fd(httpfd, ED_READ, open_ui_conn, (void *) 0);
+    return;
+}
+
+
+/***************************************************************************
+ * http_line(): - Handle one line of an HTTP request.  The request line
+ * gives the resource and the headers say whether the client wants an
+ * event stream.  The request is answered at the blank line that ends
+ * the headers.  Anything after that is ignored.
+ ***************************************************************************/
+void http_line(
+    UI      *pui,         // HTTP client
+    char    *line,        // the line without its newline
+    int      len)         // length of line or ED_LINE_LONG
+{
+    ED_HTTP *ph;          // request state
+    char    *method;      // GET, HEAD, ...
+    char    *path;        // the path of the request
+    char    *cslot;       // slot ID or plug-in name from the path
+    char    *crsc;        // resource name from the path
+    char    *saveptr;     // for strtok_r()
+    int      islot;       // slot of the resource
+    int      irsc;        // resource index in the slot
+
+    ph = &(pui->http);
+    if (ph->state == HTTP_DONE) {
+        return;
+    }
+    if (len == ED_LINE_LONG) {
+        ph->state = HTTP_DONE;
+        http_error(pui, 431);
+        return;
+    }
+    if ((len > 0) && (line[len - 1] == '\r')) {
+        line[--len] = (char) 0;
+    }
+
+    if (ph->state == HTTP_REQLINE) {
+        if (len == 0) {
+            return;       // blank lines before the request are allowed
+        }
+        ph->state = HTTP_HEADERS;
+        ph->status = 200;
+        method = strtok_r(line, " ", &saveptr);
+        path = strtok_r(NULL, " ", &saveptr);
+        if ((method == 0) || (path == 0)) {
+            ph->status = 400;
+            return;
+        }
+        if (strcmp(method, "GET") != 0) {
+            ph->status = 405;
+            return;
+        }
+        if (strncmp(path, HTTP_RSCPATH, strlen(HTTP_RSCPATH)) != 0) {
+            ph->status = 404;
+            return;
+        }
+        path[strcspn(path, "?#")] = (char) 0;  // no query strings
+        cslot = strtok_r(&(path[strlen(HTTP_RSCPATH)]), "/", &saveptr);
+        crsc = strtok_r(NULL, "/", &saveptr);
+        islot = (cslot) ? find_slot(cslot) : -1;
+        irsc = ((islot >= 0) && (crsc)) ? find_name(islot, crsc) : -1;
+        if ((irsc < 0) || (strtok_r(NULL, "/", &saveptr) != 0)) {
+            ph->status = 404;
+            return;
+        }
+        pui->cslot = islot;
+        pui->crsc = irsc;
+        return;
+    }
+
+    // Headers.  Only two of them matter to us.
+    if (len > 0) {
+        if ((strncasecmp(line, "Accept:", 7) == 0) &&
+            (strstr(line, "text/event-stream") != 0)) {
+            ph->sse = 1;
+        }
+        else if ((strncasecmp(line, "Last-Event-ID:", 14) == 0) &&
+                 (sscanf(&(line[14]), "%u", &(ph->lastid)) == 1)) {
+            ph->hasid = 1;
+        }
+        return;
+    }
+    ph->state = HTTP_DONE;
+    http_request(pui);
+    return;
+}
+
+
+/***************************************************************************
+ * http_request(): - Answer a complete HTTP request.  An event stream
+ * subscribes to the resource just like edcat.  A browser that
+ * reconnects gives the id of the last event it saw and is sent what
+ * it missed from the resource's replay buffer.  A plain GET reads the
+ * resource just like edget, including waiting for a busy resource.
+ ***************************************************************************/
+static void http_request(
+    UI      *pui)         // HTTP client
+{
+    ED_HTTP *ph;          // request state
+    RSC     *prsc;        // the resource in the request
+
+    ph = &(pui->http);
+    if (ph->status == 200) {
+        prsc = RSCPTR(&(Slots[pui->cslot]), pui->crsc);
+        if (((ph->sse) && ((prsc->flags & CAN_BROADCAST) == 0)) ||
+            ((ph->sse == 0) && ((prsc->flags & IS_READABLE) == 0))) {
+            ph->status = 405;
+        }
+    }
+    if (ph->status != 200) {
+        http_error(pui, ph->status);
+        return;
+    }
+
+    if (ph->sse) {
+        pui->stats.ncmd[EDCAT]++;
+        ph->sent = 1;
+        send_iov(pui->cn, (unsigned char *) 0, 0, HTTP_SSEHDR, strlen(HTTP_SSEHDR), 0);
+        if (ph->hasid) {
+            do_replay(pui, MKHANDLE(pui->cslot, pui->crsc), ph->lastid);
+        }
+        else {
+            (void) replay_on(prsc);   // so a reconnect can catch up
+        }
+        do_cat(pui, pui->cslot, pui->crsc, (char *) 0);
+        return;
+    }
+    pui->stats.ncmd[EDGET]++;
+    do_get(pui, pui->cslot, pui->crsc, (char *) 0);
+    return;
+}
+
+
+/***************************************************************************
+ * http_reply(): - Queue the text of a reply for an HTTP client.  This
+ * is how send_ui() answers an HTTP client.  The header goes out in
+ * front of the first text.  The connection is closed when the reply
+ * is complete, that is, at its prompt.
+ ***************************************************************************/
+void http_reply(
+    UI      *pui,         // HTTP client
+    char    *buf,         // text of the reply
+    int      len)         // number of bytes in buf
+{
+    if (pui->http.state != HTTP_DONE) {
+        return;           // nothing was asked yet
+    }
+    if (pui->http.sent == 0) {
+        pui->http.sent = 1;
+        send_iov(pui->cn, (unsigned char *) 0, 0, HTTP_TEXTHDR, strlen(HTTP_TEXTHDR), 0);
+    }
+    send_iov(pui->cn, (unsigned char *) 0, 0, buf, len, 0);
+    return;
+}
+
+
+/***************************************************************************
+ * http_event(): - Format a broadcast as a server-sent event.  The event
+ * id is the broadcast's sequence number and each line of the broadcast
+ * is a data line.  Lines that do not fit in out are dropped.  Returns
+ * the length of the event.
+ ***************************************************************************/
+int http_event(
+    char    *out,         // where to put the event
+    int      size,        // size of out
+    unsigned int seq,     // sequence number of the broadcast
+    char    *buf,         // the broadcast
+    int      len)         // number of bytes in buf
+{
+    char    *peol;        // end of a line in buf
+    int      olen;        // bytes in out
+    int      start = 0;   // start of the line in buf
+    int      llen;        // length of the line
+
+    olen = snprintf(out, size, "id: %u\n", seq);
+    while (start < len) {
+        peol = memchr(&(buf[start]), '\n', (len - start));
+        llen = (peol) ? (int) (peol - &(buf[start])) : (len - start);
+        if (olen + llen + 8 > size)
+            break;
+        memcpy(&(out[olen]), "data: ", 6);
+        memcpy(&(out[olen + 6]), &(buf[start]), llen);
+        olen += 6 + llen;
+        out[olen++] = '\n';
+        start += llen + 1;
+    }
+    out[olen++] = '\n';   // a blank line ends the event
+    return(olen);
+}
+
+
+/***************************************************************************
+ * http_error(): - Send an HTTP error status and close the connection.
+ ***************************************************************************/
+static void http_error(
+    UI      *pui,         // HTTP client
+    int      status)      // HTTP status code
+{
+    char     rply[MXRPLY]; // the status line, headers, and body
+    char    *reason;      // text of the status
+    int      len;         // bytes in rply
+
+    reason = (status == 400) ? "Bad Request" :
+             (status == 404) ? "Not Found" :
+             (status == 405) ? "Method Not Allowed" :
+             (status == 431) ? "Request Header Fields Too Large" :
+                               "Internal Server Error";
+    len = snprintf(rply, MXRPLY, HTTP_ERRHDR, status, reason,
+                   (int) (strlen(reason) + 5), status, reason);
+    pui->http.sent = 1;
+    pui->http.close = 1;
+    send_iov(pui->cn, (unsigned char *) 0, 0, rply, len, 0);
+    return;
+}
+
+// end of http.c
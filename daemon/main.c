@@ -76,8 +76,9 @@ static void daemonize();
 static void invokerealtimeextensions();
 static void processcmdline(int, char *[]);
 extern void open_ui_port();
+extern void coreinit(SLOT *);   // Set up the daemon's own slot
 extern void muxmain();
-extern void initslot(SLOT *);  // Load and init this slot
+extern void start_slots();     // Load and init the plug-ins in all slots
 extern int  add_so(char *);
 
 
@@ -88,11 +89,22 @@ SLOT     Slots[MX_PLUGIN];     // Allocate the plug-in table
 ED_FD    Ed_Fd[MX_FD];         // Table of open FDs and callbacks
 ED_TIMER Timers[MX_TIMER];     // Table of timers
 UI       UiCons[MX_UI];        // Table of UI connections
+ED_WAIT  Waits[MX_WAIT];       // Reads waiting on busy resources
+ED_NAME *Names;                // Hash index of plug-in and resource names
+int      NNames;               // entries in Names, always a power of two
+ED_SUB   Subs[MX_SUB];         // Plug-ins subscribed to broadcasts
 int      UseStderr = 0; // use stderr
 int      Verbosity = 0; // verbosity level
 int      DebugMode = 0; // run in debug mode
 int      UiaddrAny = 0; // Use any IP address if set
 int      UiPort = DEF_UIPORT; // TCP port for ui connections
+char    *UiPath = 0;    // Path of Unix socket for ui connections, if any
+int      UiReusePort = 0; // Set SO_REUSEPORT on the ui TCP port
+int      HttpPort = 0;  // TCP port for HTTP clients, 0 if none
+int      UiRate = 0;    // commands per second per UI, 0 for no limit
+int      UiBurst = 0;   // commands a UI may send at once under UiRate
+int      UiIdle = 0;    // seconds before an idle UI is closed, 0 for never
+int      RspTimeout = DEF_RSPTO; // ms to finish a pending get or set, 0 for never
 int      ForegroundMode = 0; // run in foreground
 int      RealtimeMode = 0; // use realtime extension
 
@@ -102,7 +114,7 @@ int      RealtimeMode = 0; // use realtime extension
  ***************************************************************************/
 char    *CmdName;      // How this program was invoked
 const char *versionStr = "eedd Version 0.9.0, Copyright 2019 by Demand Peripherals, Inc.";
-const char *usageStr = "usage: eedd [-ev[level]dfrVmsh]\n";
+const char *usageStr = "usage: eedd [-ev[level]dfrVmsuRHh]\n";
 const char *helpText = "\
 eedd [options] \n\
  options:\n\
@@ -114,9 +126,15 @@ eedd [options] \n\
  -f, --foreground        Stay in foreground.\n\
  -a, --listen_any        Use any/all IP addresses for UI TCP connections\n\
  -p, --listen_port       Listen for incoming UI connections on this TCP port\n\
+ -R, --reuse_port        Set SO_REUSEPORT so other processes can share the TCP port.\n\
+ -u, --listen_unix       Also listen for UI connections on this Unix socket path.\n\
+                         A leading '@' gives a name in the abstract namespace.\n\
+ -H, --http_port         Also serve resources over HTTP on this TCP port.\n\
  -r, --realtime          Try to run with real-time extensions.\n\
  -V, --version           Print version number and exit.\n\
  -s, --slot              Load .so.X file for slot specified, as slotID:file.so\n\
+                         Add @thread, as file.so@thread, to run the plug-in on\n\
+                         a thread with its own select loop.\n\
  -h, --help              Print usage message.\n\
 ";
 
@@ -126,8 +144,6 @@ eedd [options] \n\
  ***************************************************************************/
 int main(int argc, char *argv[])
 {
-    int     i;      // loop counter
-
     // Ignore the SIGPIPE signal since that can occur if a
     // UI socket closes just before we try to write to it.
     (void) signal(SIGPIPE, SIG_IGN);
@@ -135,10 +151,13 @@ int main(int argc, char *argv[])
     // Initialize globals for slots, timers, ui connections, and select fds
     globalinit();
 
+    // The daemon's own resources are in slot 0
+    coreinit(&(Slots[0]));
+
     // Add plug-ins here to always have them when the program starts
-    // The first loaded is in slot 0, the next in slot 1, ...
-    //(void) add_so("gamepad.so");      // first available slot (0)
-    //(void) add_so("tts.so");          // second available slot (1)
+    // The first loaded is in slot 1, the next in slot 2, ...
+    //(void) add_so("gamepad.so");      // first available slot (1)
+    //(void) add_so("tts.so");          // second available slot (2)
 
     // Parse the command line and set global flags 
     processcmdline(argc, argv);
@@ -152,14 +171,15 @@ int main(int argc, char *argv[])
     if (RealtimeMode)
         invokerealtimeextensions();
 
-    // Start eedd and the plug-ins loaded from the command line 
-    for (i = 0; i < MX_PLUGIN; i++) {
-        initslot(&(Slots[i]));
-    }
-
-    // Open the TCP listen port for UI connections
+    // Open the TCP listen port for UI connections.  Clients can connect
+    // while the plug-ins start and their commands are read once the
+    // daemon's loop runs.
     open_ui_port();
 
+    // Start the plug-ins loaded from the command line, each on its own
+    // thread.  Slot 0 is already running.
+    start_slots();
+
     // Drop into the select loop and wait for events
     muxmain();
 
@@ -185,21 +205,57 @@ void globalinit()
         Slots[i].priv    = (void *) NULL;
         Slots[i].desc    = (void *) NULL;
         Slots[i].help    = (void *) NULL;
+        Slots[i].xrsc    = (RSC *) NULL;  // resources added past MX_RSC
+        Slots[i].nrsc    = MX_RSC;
         for (j = 0; j < MX_RSC; j++) {
             Slots[i].rsc[j].name   = (char *) NULL;
             Slots[i].rsc[j].pgscb  = NULL;
             Slots[i].rsc[j].slot   = (void *) NULL;
             Slots[i].rsc[j].bkey   = 0;
-            Slots[i].rsc[j].uilock = 0;
+            Slots[i].rsc[j].uilock = -1;
             Slots[i].rsc[j].flags  = 0;
+            Slots[i].rsc[j].dpriv  = (void *) NULL;
         }
     }
 
+    for (i = 0; i < MX_WAIT; i++) {
+        Waits[i].cn       = -1;   // cn=-1 says entry is not in use
+        Waits[i].slot     = 0;
+        Waits[i].rsc      = 0;
+        Waits[i].tag      = 0;    // request ID of the queued get
+        Waits[i].active   = 0;    // set while plug-in does the read
+        Waits[i].order    = 0;    // order in which reads were queued
+        Waits[i].t_start  = 0;    // when the plug-in started the request
+        Waits[i].req      = 0;    // cn and request ID given to the plug-in
+        Waits[i].val[0]   = (char) 0; // arguments of the queued get
+    }
+
+    for (i = 0; i < MX_SUB; i++) {
+        Subs[i].bkey      = 0;
+        Subs[i].cb        = NULL; // cb=NULL says entry is not in use
+        Subs[i].arg       = (void *) NULL;
+        Subs[i].owner     = 0;    // slot of the subscriber
+    }
+
+    // The name index starts at MX_NAMES and grows with ed_add_rsc()
+    NNames = MX_NAMES;
+    Names = malloc(NNames * sizeof(ED_NAME));
+    if (Names == 0) {
+        edlog(M_NOMEM, "globalinit");
+        exit(-1);
+    }
+    for (i = 0; i < NNames; i++) {
+        Names[i].slot     = -1;   // slot=-1 says entry is not in use
+        Names[i].rsc      = -1;   // -1 for a plug-in name
+        Names[i].hash     = 0;
+    }
+
     for (i = 0; i < MX_FD; i++) {
         Ed_Fd[i].fd       = -1;
         Ed_Fd[i].stype    = 0;    // read, write, or except
         Ed_Fd[i].scb      = NULL; // callback on select() activity
         Ed_Fd[i].pcb_data = (void *) NULL; // data included in call of callback
+        Ed_Fd[i].owner    = 0;    // slot that added the FD
     }
 
     for (i = 0; i < MX_TIMER; i++) {
@@ -209,6 +265,7 @@ void globalinit()
         Timers[i].us       = 0;           // period or timeout interval in uS
         Timers[i].cb       = NULL;        // Callback on timeout
         Timers[i].pcb_data = (void *) NULL; // data included in call of callbacks
+        Timers[i].owner    = 0;           // slot that added the timer
     }
 
     for (i = 0; i <MX_UI; i++) {
@@ -217,8 +274,27 @@ void globalinit()
         UiCons[i].bkey = 0;               // if set, brdcst data from this slot/rsc
         UiCons[i].o_port = 0;             // Other-end TCP port number
         UiCons[i].o_ip = 0;               // Other-end IP address
-        UiCons[i].cmdindx = 0;            // Index of next location in cmd buffer
+        UiCons[i].o_uid = -1;             // Other-end user ID on Unix sockets
+        UiCons[i].proto = ED_PROTO_ASCII; // printable ASCII until edproto
+        UiCons[i].txseq = 0;              // Sequence number of next frame
+        UiCons[i].cslot = ED_NOID;        // Slot of command in progress
+        UiCons[i].crsc = ED_NOID;         // Resource of command in progress
+        UiCons[i].tag = 0;                // Request ID of command being parsed
+        UiCons[i].otag = 0;               // Request ID of reply being sent
+        UiCons[i].catseq = 0;             // Broadcasts without seq numbers
+        memset(&(UiCons[i].http), 0, sizeof(ED_HTTP)); // No HTTP request
         UiCons[i].cmd[0] = (char) 0;      // command from UI program
+        ed_line_init(&(UiCons[i].cmdbuf), UiCons[i].cmd, MXCMD, 0);
+        UiCons[i].olen = 0;               // Bytes waiting to be sent
+        UiCons[i].osize = 0;              // Output buffer not allocated yet
+        UiCons[i].obuf = (char *) 0;
+        UiCons[i].wpend = 0;              // Not waiting for FD to be writable
+        memset(&(UiCons[i].stats), 0, sizeof(ED_UISTAT)); // Traffic counters
+        UiCons[i].credit = 0;             // Rate limit credit
+        UiCons[i].t_fill = 0;
+        UiCons[i].throttled = 0;          // Reading commands
+        UiCons[i].prio = ED_PRIO_NORMAL;  // Not shed before other UIs
+        UiCons[i].t_defer = 0;            // No bulk command waiting
     }
 }
 
@@ -239,11 +315,14 @@ void processcmdline(int argc, char *argv[])
         {"version", 0, 0, 'V'},
         {"listen_any", 0, 0, 'a'},
         {"listen_port", 1, 0, 'p'},
+        {"listen_unix", 1, 0, 'u'},
+        {"reuse_port", 0, 0, 'R'},
+        {"http_port", 1, 0, 'H'},
         {"slot", 1, 0, 's'},
         {"help", 0, 0, 'h'},
         {0, 0, 0, 0}
     };
-    static char optStr[] = "ev:dfrVs:p:ah";
+    static char optStr[] = "ev:dfrVs:p:u:aRH:h";
 
     while (1) {
         c = getopt_long(argc, argv, optStr, longoptions, &optidx);
@@ -278,6 +357,18 @@ void processcmdline(int argc, char *argv[])
                 UiPort = atoi(optarg);
                 break;
 
+            case 'u':
+                UiPath = optarg;
+                break;
+
+            case 'R':
+                UiReusePort = 1;
+                break;
+
+            case 'H':
+                HttpPort = atoi(optarg);
+                break;
+
             case 'r':
                 RealtimeMode = 1;
                 break;
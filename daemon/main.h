@@ -22,6 +22,9 @@
 #ifndef MAIN_H_
 #define MAIN_H_
 
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <pthread.h>
 #include "../plug-ins/include/eedd.h"
 
 
@@ -39,9 +42,79 @@
 /***************************************************************************
  *  - Defines
  ***************************************************************************/
-#define MX_FD           50     /* maximum # of file descriptor in select() call */
+#define MX_FD   (MX_UI + 50)   /* maximum # of file descriptor in select() call */
 #define MX_TIMER        50     /* maximum # of timers */
 #define MX_UI           50     /* maximum # of UI connections */
+#define UI_BACKLOG     128     /* listen() backlog of the UI sockets */
+#define MX_OBUF      32768     /* bytes of output buffered per UI connection */
+#define MX_OBUFMAX  1048576    /* most bytes queued for a UI that is not reading */
+#define UI_NCMD         13     /* command types counted per UI, 0 = unknown */
+#define MX_GETRPLY    8192     /* edget reply buffer, room for daemon tables */
+#define RPL_NENT        64     /* broadcasts kept per resource for edcat --since */
+#define RPL_LINGER      60     /* seconds to keep recording after the last edcat */
+#define ED_PROTO_HTTP    2     /* UI is a client of the HTTP port */
+#define HTTP_REQLINE     0     /* HTTP UI is waiting for the request line */
+#define HTTP_HEADERS     1     /* HTTP UI is reading the request headers */
+#define HTTP_DONE        2     /* HTTP request is being answered */
+#define HTTP_MXEVENT  (4 * MXRPLY) /* largest server-sent event of a broadcast */
+#define MX_WAIT        100     /* maximum # of gets and sets waiting on resources */
+#define DEF_RSPTO     2000     /* default ms a plug-in has to finish a pending request */
+#define UI_RSPCHK      100     /* ms between checks for late pending requests */
+#define MX_TAG       65535     /* largest request ID, #<id>, on a command */
+#define MX_NAMES      1024     /* initial entries in plug-in/resource name index (2^n) */
+#define MX_NRSC       0xffff   /* most resources in a slot, limited by HANDLE2RSC */
+#define MX_XRSC0          8    /* first size of a slot's xrsc, doubled as it fills (2^n) */
+#define MX_MGET      64000     /* bytes in one edmget or eddump reply */
+#define MX_MARG       (MXCMD / 2) /* most arguments to edmget */
+#define UI_BATCH     MX_UI     /* uilock of a deferred batch read.  No UI. */
+        // What a waiting request in Waits[] is doing
+#define WT_QUEUED        0     /* a read to issue when the resource is free */
+#define WT_DEFER         1     /* a read the plug-in answers with send_ui() */
+#define WT_PENDING       2     /* a get or set the plug-in left ED_PENDING */
+#define WT_ROUTED        3     /* a read a plug-in thread answers with send_ui() */
+#define MX_RINGNAME     64     /* chars in name of a shared memory ring */
+#define MX_RINGENT   65536     /* most entries in a shared memory ring */
+#define DEF_RINGDATA   232     /* default data bytes per ring entry */
+#define UI_IDLECHK    1000     /* ms between checks for idle UI connections */
+#define OVL_PERIOD     100     /* ms between checks of the loop's load */
+#define OVL_CALM        10     /* quiet checks before the load level drops */
+#define OVL_NLEVEL       3     /* number of overload levels above normal */
+#define OVL_DEFER        1     /* level that defers edlist, eddump, edloadso */
+#define OVL_DECIMATE     2     /* level that thins broadcasts to low priority UIs */
+#define OVL_REFUSE       3     /* level that refuses new UI connections */
+#define OVL_KEEP         4     /* low priority UIs get one in OVL_KEEP broadcasts */
+#define OVL_MAXWAIT   2000     /* most ms a bulk command waits while overloaded */
+#define ED_PRIO_NORMAL   0     /* UI priority, see 'edset 0 priority' */
+#define ED_PRIO_LOW      1
+#define MX_SUB          50     /* maximum # of ed_subscribe() subscriptions */
+#define MX_SMPVAL       32     /* most values parsed from a text broadcast */
+#define HIST_NCOL        8     /* most values per sample kept in a history */
+#define HIST_TXTSZ       8     /* bytes of a text value kept, with its null */
+#define HIST_MINENT     64     /* first size of a history sized in seconds */
+#define HIST_MXENT  (1 << 22)  /* most samples in one history */
+#define THR_SUFFIX   "@thread" /* after a .so name to run the plug-in on its own thread */
+#define THR_NFD         16     /* FDs in the loop of a plug-in thread */
+#define THR_NTIMER      16     /* timers in the loop of a plug-in thread */
+#define THR_NMSG        64     /* messages in each queue to or from a plug-in thread */
+#define THR_NBACK0       8     /* first size of a thread's backlog of calls (doubled) */
+#define THR_CALL         1     /* to a thread: call a get, set, or cat routine */
+#define THR_SUB          2     /* to a thread: a broadcast for an ed_subscribe() callback */
+#define THR_DONE         3     /* from a thread: Finalize() returned and the thread exits */
+#define THR_REPLY        4     /* from a thread: the reply of a call or ed_complete() */
+#define THR_FAIL         5     /* from a thread: ed_fail() */
+#define THR_BCST         6     /* from a thread: bcst_ui() */
+#define THR_PUBLISH      7     /* from a thread: ed_publish() */
+#define THR_SENDUI       8     /* from a thread: send_ui() */
+#define THR_PROMPT       9     /* from a thread: prompt() */
+#define THR_CACHE       10     /* from a thread: ed_cache() */
+#define THR_SET         11     /* from a thread: ed_set() */
+#define THR_UNSUB       12     /* from a thread: ed_unsubscribe() */
+#define THR_DEFER       13     /* from a thread: a get the plug-in answers itself */
+
+    /* Handles from edresolve and broadcast keys are slot/rsc in an int */
+#define MKHANDLE(s, r)   ((((s) & 0xffff) << 16) | ((r) & 0xffff))
+#define HANDLE2SLOT(h)   (((h) >> 16) & 0xffff)
+#define HANDLE2RSC(h)    ((h) & 0xffff)
 
     /* UI sessions are stateful.  Here are the states */
 #define CMDSTATE         0     /* waiting for command from UI */
@@ -55,22 +128,164 @@
 /***************************************************************************
  *  - Data structures  (please see design.txt for more explanation)
  ***************************************************************************/
+    /* Traffic counters of a UI connection.  See 'edget 0 connections' */
+typedef struct {
+    long long t_open;          // when the UI connected, in microseconds
+    unsigned long long nbin;   // bytes received from the UI
+    unsigned long long nbout;  // bytes sent to the UI
+    unsigned int ncmd[UI_NCMD]; // commands received, indexed by EDxxx
+    unsigned int nbcst;        // broadcasts queued for the UI
+    unsigned int bdrops;       // broadcasts dropped since obuf was full
+    int       omax;            // most bytes ever waiting in obuf
+    unsigned int nthrottle;    // times commands were held by the rate limit
+    long long t_last;          // when the UI last sent anything
+} ED_UISTAT;
+
+    /* A broadcast on its way to the subscribers.  The encodings of a
+     * typed sample are made when the first subscriber needs them. */
+typedef struct {
+    const ED_VALUE *vals;      // values from ed_publish(), 0 for bcst_ui()
+    int       nval;            // number of vals
+    char     *txt;             // ASCII form, 0 until needed
+    int       tlen;            // bytes in txt
+    char     *bin;             // binary form, 0 until needed
+    int       blen;            // bytes in bin
+    char     *json;            // JSON form, 0 until needed
+    int       jlen;            // bytes in json
+    ED_VALUE *tvals;           // values parsed from the text, 0 until needed
+    int       ntval;           // number of tvals
+    char      tbuf[MXRPLY];    // room for each form
+    char      bbuf[MXRPLY];
+    char      jbuf[MXRPLY];
+    ED_VALUE  vbuf[MX_SMPVAL]; // room for tvals
+    char      wbuf[MXRPLY];    // the words of the text values
+} ED_SAMPLE;
+
+    /* A plug-in receiving the broadcasts of a resource with ed_subscribe() */
+typedef struct {
+    int       bkey;            // slot/rsc of the resource
+    void      (*cb) ();        // callback with the values (=0 if not in use)
+    void     *arg;             // data included in call of callback
+    int       owner;           // slot of the subscribing plug-in, 0 for the daemon
+} ED_SUB;
+
+    /* Progress of the request on an HTTP connection */
+typedef struct {
+    int       state;           // HTTP_REQLINE, HTTP_HEADERS, or HTTP_DONE
+    int       status;          // HTTP status for the reply
+    int       sse;             // set if the client accepts text/event-stream
+    int       hasid;           // set if the client gave a Last-Event-ID
+    unsigned int lastid;       // the Last-Event-ID
+    int       sent;            // set once the reply header is queued
+    int       close;           // close once the queued output is sent
+} ED_HTTP;
+
 typedef struct {
     int       cn;              // connection index for this conn
     int       fd;              // FD of TCP conn (=-1 if not in use)
     int       bkey;            // if set, brdcst data from this slot/rsc
     int       o_port;          // Other-end TCP port number
     int       o_ip;            // Other-end IP address
-    int       cmdindx;         // Index of next location in cmd buffer
+    int       o_uid;           // Other-end user ID, -1 if not a Unix socket
+    int       proto;           // ED_PROTO_ASCII or ED_PROTO_BINARY
+    unsigned int txseq;        // Sequence number of next binary frame
+    int       cslot;           // Slot of command in progress (for frames)
+    int       crsc;            // Resource of command in progress
+    int       tag;             // Request ID of command being parsed, or 0
+    int       otag;            // Request ID of reply being sent, or 0
+    int       catseq;          // Set if ASCII broadcasts start with their seq
+    ED_LINEBUF cmdbuf;         // Splits cmd[] into command lines
     char      cmd[MXCMD];      // command from UI program
+    int       olen;            // Number of bytes waiting in obuf
+    int       osize;           // Number of bytes allocated for obuf
+    int       wpend;           // Set if waiting for the FD to be writable
+    ED_UISTAT stats;           // Traffic counters
+    long long credit;          // rate limit credit in microseconds of commands
+    long long t_fill;          // when credit was last brought up to date
+    int       throttled;       // set while reads wait for more credit
+    int       prio;            // ED_PRIO_NORMAL or ED_PRIO_LOW
+    long long t_defer;         // when a bulk command started to wait, or 0
+    ED_HTTP   http;            // Request state if proto is ED_PROTO_HTTP
+    char     *obuf;            // output waiting for the end of the loop pass
 } UI;
 
+    /* A UI waiting for the value of a resource the plug-in is reading,
+     * or for a pending get or set to finish */
+typedef struct {
+    int       cn;              // UI waiting for the value (=-1 if not in use)
+    int       slot;            // slot of the resource being read
+    int       rsc;             // index of the resource in the slot
+    int       tag;             // request ID of the get, or 0
+    int       active;          // WT_xxx, non-zero if plug-in is doing it now
+    unsigned int order;        // to reissue queued reads in order
+    long long t_start;         // when the plug-in started, in microseconds
+    int       req;             // cn and request ID given to pgscb
+    char      val[MXCMD];      // arguments of a queued get, if any
+} ED_WAIT;
+
+    /* An entry in the hash index of plug-in and resource names */
+typedef struct {
+    int       slot;            // slot of the name (=-1 if not in use)
+    int       rsc;             // resource index or -1 for the plug-in name
+    unsigned int hash;         // hash of the name
+} ED_NAME;
+
+    /* A broadcast kept so that a UI can replay it with edcat --since */
+typedef struct {
+    unsigned int seq;          // sequence number of the broadcast, 0 if unused
+    int       len;             // bytes of data
+    int       size;            // bytes allocated at data
+    long long ts;              // time of the broadcast in microseconds
+    char     *data;            // copy of the broadcast
+} ED_RPLENT;
+
+    /* Typed history of the broadcasts of a resource.  Each column has one
+     * entry per sample and sample n is at n % size in every column.  Value
+     * columns are allocated when a sample first has that many values.  A
+     * value is 8 bytes: an integer, the bits of a double, or short text. */
+typedef struct {
+    int       size;            // samples allocated in each column
+    int       nent;            // samples to keep, 0 if sized by secs
+    int       secs;            // seconds of samples to keep, 0 if sized by nent
+    unsigned long long head;   // number of samples ever added
+    int       ncol;            // number of value columns allocated
+    long long *ts;             // time of each sample in microseconds
+    unsigned char *nval;       // number of values in each sample
+    unsigned char *type[HIST_NCOL]; // ED_VT_ type of each value
+    long long *val[HIST_NCOL]; // each value
+    ED_VALUE  fmt[HIST_NCOL];  // width and prec of the last value in each column
+} ED_HIST;
+
+    /* The daemon's own state for a resource.  This is allocated the
+     * first time the daemon needs it and is at RSC.dpriv. */
+typedef struct {
+    unsigned int bseq;         // number of broadcasts seen from the resource
+    ED_RPLENT *replay;         // last RPL_NENT broadcasts, sample n at n%RPL_NENT
+    unsigned int rplseq;       // bseq when the replay buffer was turned on
+    long long tlisten;         // when a UI last watched the resource, in usec
+    void     *ring;            // shared memory ring of broadcasts (ED_RING)
+    int       ringsz;          // bytes mapped at ring
+    char      ringname[MX_RINGNAME]; // shared memory name of the ring
+    int       mcast;           // set if broadcasts go to a multicast group
+    struct sockaddr_in mcaddr; // multicast group and port
+    int       maxage;          // ms a cached value is served, 0 if not cached
+    char     *cval;            // last value read, MXRPLY bytes
+    int       clen;            // bytes in cval
+    long long ctime;           // when cval was stored, 0 if there is none
+    unsigned int chits;        // reads answered from cval
+    unsigned int cmiss;        // reads of a cached resource sent to the plug-in
+    ED_HIST  *hist;            // history of broadcasts for edhist, if any
+    int       told;            // set if the plug-in was last given EDSUB
+    int       tell;            // set if EDSUB or EDUNSUB may be due
+} ED_RSC;
+
     /* the information kept for each file descriptor callback */
 typedef struct {
     int       fd;              // FD of TCP conn (=-1 if not in use)
     int       stype;           // OR of ED_ READ, WRITE, and EXCEPT
     void      (*scb) ();       // Callback on select() activity
     void     *pcb_data;        // data included in call of callbacks
+    int       owner;           // slot of the plug-in that added it, 0 for the daemon
 } ED_FD;
 
     /* structure for the timers and their callbacks */
@@ -80,8 +295,87 @@ typedef struct {
     unsigned int us;           // period or timeout interval
     void      (*cb) ();        // Callback on timeout
     void     *pcb_data;        // data included in call of callbacks
+    int       owner;           // slot of the plug-in that added it, 0 for the daemon
 } ED_TIMER;
 
+    /* The FDs and timers of one select() loop.  The daemon has one loop
+     * and each plug-in loaded with @thread has a loop of its own. */
+typedef struct {
+    ED_FD    *fds;             // FDs and callbacks
+    int       nfd;             // entries at fds
+    ED_TIMER *timers;          // timers and callbacks
+    int       ntimer;          // entries at timers
+    int       ntimers;         // timers in use
+    int       fdcount;         // FDs in use
+    int       mxfd;            // highest numbered FD
+    fd_set    rfds;            // read FDs
+    fd_set    wfds;            // write FDs
+    fd_set    xfds;            // exception FDs
+    struct timeval tv;         // time to the next timeout, given to select()
+} ED_LOOP;
+
+    /* A call, reply, or broadcast passed between the daemon and a plug-in
+     * thread.  Which fields are used depends on the type. */
+typedef struct {
+    int       type;            // THR_CALL, THR_BCST, ...
+    int       cmd;             // EDGET, EDSET, or EDCAT of a call or reply.
+                               // EDGET in a THR_DEFER if not yet answered.
+    int       plain;           // set if a reply to a get with no arguments
+    int       rsc;             // resource index of a call
+    int       cn;              // UI of a call, reply, or send_ui()
+    int       bkey;            // slot/rsc of a subscription or ed_set()
+    void     *ptr;             // the RSC, bkey pointer, or callback
+    void     *arg;             // data included in call of a callback
+    int       nval;            // number of vals
+    ED_VALUE  vals[MX_SMPVAL]; // values of a sample
+    int       len;             // bytes in data
+    char      data[MXCMD];     // value, reply, or text of a broadcast
+} ED_TMSG;
+
+    /* Messages going one way between two threads.  Only the producer
+     * changes head and only the consumer changes tail so no lock is
+     * needed.  A byte written to the pipe wakes the consumer's loop.
+     * A plug-in thread that finds its queue to the daemon full sleeps
+     * on room until the daemon takes a message. */
+typedef struct {
+    unsigned int head;         // count of messages added
+    unsigned int tail;         // count of messages taken
+    int       rfd;             // read end of the wakeup pipe
+    int       wfd;             // write end of the wakeup pipe
+    int       waiting;         // set while the producer waits for room
+    pthread_mutex_t lock;      // held to wait on or signal room
+    pthread_cond_t room;       // signalled when a message is taken
+    ED_TMSG   ent[THR_NMSG];   // message n is at n % THR_NMSG
+} ED_TQUEUE;
+
+    /* A plug-in running its callbacks in a thread with its own loop */
+typedef struct {
+    SLOT     *pslot;           // the plug-in's slot
+    pthread_t tid;             // the thread
+    int       stop;            // set when the thread should exit
+    unsigned int ndrop;        // broadcasts dropped while the thread was behind
+    ED_LOOP   loop;            // the thread's FDs and timers
+    ED_FD     fds[THR_NFD];
+    ED_TIMER  timers[THR_NTIMER];
+    void    (**pgscb) ();      // the plug-in's get/set callbacks, by resource
+    int       npgscb;          // entries at pgscb
+    ED_TQUEUE in;              // calls from the daemon
+    ED_TQUEUE out;             // replies and broadcasts to the daemon
+    ED_TMSG  *back;            // cat, sub, and unsub calls that found in full
+    int       nback;           // calls at back, oldest first
+    int       mxback;          // room at back
+    int       backed;          // set while calls wait.  The thread wakes the daemon.
+} ED_THR;
+
+    /* An unload or reload waiting for the thread of a plug-in to stop */
+typedef struct {
+    int       active;          // set while the thread is stopping
+    int       reload;          // set to load the .so again
+    int       cn;              // UI that gave the command
+    int       tag;             // request ID of the command, or 0
+    long long t_open;          // when that UI connected, to know it is the same UI
+} ED_UNLOAD;
+
 
 
 
@@ -0,0 +1,566 @@
+/*
+ * Name: publish.c
+ *
+ * Description: This file contains ed_publish() and the code that turns
+ *              a sample of typed values into the encoding each kind of
+ *              subscriber wants.  ASCII UIs get a line of text, binary
+ *              UIs get the values in network byte order, and HTTP
+ *              event streams get a JSON array.  An encoding is made
+ *              only when a subscriber needs it and at most once for
+ *              each sample.
+ *                Plug-ins can subscribe to the broadcasts of other
+ *              plug-ins with ed_subscribe() and get the values with no
+ *              formatting at all.  ed_set() calls the set routine of a
+ *              resource directly.
+ *
+ * Copyright:   Copyright (C) 2019 by Demand Peripherals, Inc.
+ *              All rights reserved.
+ *
+ * License:     This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the Version 2 of the GNU General
+ *              Public License as published by the Free Software Foundation.
+ *              GPL2.txt in the top level directory is a copy of this license.
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *              GNU General Public License for more details.
+ *
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include "main.h"
+
+
+/***************************************************************************
+ *  - Limits and defines
+ ***************************************************************************/
+        // Most bytes one value takes in the binary form
+#define BIN_VALSZ          (1 + 8)
+        // Most bytes of an ED_VT_TEXT value in the binary form
+#define BIN_MXTEXT         255
+
+
+/***************************************************************************
+ *  - Function prototypes, forward references, and externs
+ ***************************************************************************/
+void            ed_publish(RSC *, const ED_VALUE *, int);
+void            smp_init(ED_SAMPLE *, const ED_VALUE *, int, char *, int);
+char           *smp_text(ED_SAMPLE *, int *);
+int             fmt_values(char *, int, const ED_VALUE *, int);
+char           *smp_bin(ED_SAMPLE *, int *);
+char           *smp_json(ED_SAMPLE *, int *);
+int             smp_ptype(ED_SAMPLE *);
+const ED_VALUE *smp_values(ED_SAMPLE *, int *);
+int             ed_subscribe(int, int, void (*) (), void *);
+void            ed_unsubscribe(int);
+void            unsub_slot(int, int);
+int             bus_bcst(int, ED_SAMPLE *);
+int             bus_listens(int);
+int             ed_set(int, int, char *);
+static int      put_u64(char *, uint64_t);
+extern void     bcst_sample(ED_SAMPLE *, int *);
+extern void     watch_rsc(RSC *, int);
+extern void     unwatch_rsc(int);
+extern int      add_wait(int, int, int, int, int, int, char *);
+extern int      mkreq(int);
+extern void     ed_cache(RSC *, char *, int);
+extern int      so_owner(void (*)());
+extern int      thr_slot();
+extern int      thr_route(int, int, void *, char *, int);
+extern int      thr_publish(RSC *, const ED_VALUE *, int);
+extern int      thr_sub(ED_SUB *, int, const ED_VALUE *, int);
+extern void     start_lock();
+extern void     start_unlock();
+extern SLOT     Slots[];       // table of plug-in info
+extern ED_SUB   Subs[MX_SUB];  // plug-ins subscribed to broadcasts
+
+
+/***************************************************************************
+ * ed_publish(): - Broadcast a sample of typed values to the subscribers
+ * of a resource.  Nothing is formatted here.  The broadcast path asks
+ * for each encoding as it finds a subscriber that needs it.
+ ***************************************************************************/
+void ed_publish(
+    RSC     *prsc,        // the broadcast resource
+    const ED_VALUE *vals, // the values of the sample
+    int      n)           // number of values
+{
+    ED_SAMPLE smp;        // the sample and its encodings
+
+    if ((prsc == 0) || (prsc->bkey == 0) || (vals == 0) || (n <= 0)) {
+        return;           // no one is listening
+    }
+    if (thr_publish(prsc, vals, n) == 0) {
+        return;           // a plug-in thread, sent from the daemon's loop
+    }
+    start_lock();
+    smp_init(&smp, vals, n, (char *) 0, 0);
+    // bkey will return cleared if UIs are no longer monitoring us
+    bcst_sample(&smp, &(prsc->bkey));
+    start_unlock();
+    return;
+}
+
+
+/***************************************************************************
+ * smp_init(): - Set up a sample.  A sample from bcst_ui() is already
+ * text and that text is used for every encoding.
+ ***************************************************************************/
+void smp_init(
+    ED_SAMPLE *ps,        // the sample to set up
+    const ED_VALUE *vals, // typed values, or 0
+    int      n,           // number of values
+    char    *buf,         // text of the sample if vals is 0
+    int      len)         // bytes in buf
+{
+    ps->vals = vals;
+    ps->nval = n;
+    ps->txt = buf;
+    ps->tlen = len;
+    ps->bin = (vals) ? (char *) 0 : buf;
+    ps->blen = len;
+    ps->json = (vals) ? (char *) 0 : buf;
+    ps->jlen = len;
+    ps->tvals = (ED_VALUE *) 0;
+    ps->ntval = 0;
+    return;
+}
+
+
+/***************************************************************************
+ * smp_ptype(): - Return the binary payload type of a sample.
+ ***************************************************************************/
+int smp_ptype(
+    ED_SAMPLE *ps)        // the sample
+{
+    return((ps->vals) ? ED_PT_VALUES : ED_PT_TEXT);
+}
+
+
+/***************************************************************************
+ * smp_text(): - Return the sample as a line of ASCII text, making it
+ * if this is the first subscriber to need it.
+ ***************************************************************************/
+char *smp_text(
+    ED_SAMPLE *ps,        // the sample
+    int     *plen)        // set to the bytes in the text
+{
+    if (ps->txt == 0) {
+        ps->tlen = fmt_values(ps->tbuf, MXRPLY, ps->vals, ps->nval);
+        ps->txt = ps->tbuf;
+    }
+    *plen = ps->tlen;
+    return(ps->txt);
+}
+
+
+/***************************************************************************
+ * fmt_values(): - Print values as a line of ASCII text separated by
+ * spaces and ending with a newline.  Returns the length of the line.
+ ***************************************************************************/
+int fmt_values(
+    char    *out,         // where the text goes
+    int      osize,       // bytes in out
+    const ED_VALUE *vals, // the values
+    int      n)           // number of values
+{
+    const ED_VALUE *pv;   // value being formatted
+    int      size;        // room in out
+    int      len = 0;     // bytes in out
+    int      i;
+
+    size = osize - 1;     // room for the newline
+    for (i = 0, pv = vals; (i < n) && (len < size); i++, pv++) {
+        if (i > 0)
+            out[len++] = ' ';
+        if (pv->type == ED_VT_HEX)
+            len += snprintf(&(out[len]), (size - len), "%0*llx", pv->width, pv->v.i);
+        else if (pv->type == ED_VT_FLOAT)
+            len += snprintf(&(out[len]), (size - len), "%*.*f", pv->width, pv->prec, pv->v.d);
+        else if (pv->type == ED_VT_TS)
+            len += snprintf(&(out[len]), (size - len), "%lld.%06lld",
+                            (pv->v.i / 1000000), (pv->v.i % 1000000));
+        else if (pv->type == ED_VT_TEXT)
+            len += snprintf(&(out[len]), (size - len), "%*s", pv->width,
+                            (pv->v.s) ? pv->v.s : "");
+        else
+            len += snprintf(&(out[len]), (size - len), "%*lld", pv->width, pv->v.i);
+    }
+    len = (len < size) ? len : size - 1;
+    out[len++] = '\n';
+    out[len] = (char) 0;
+    return(len);
+}
+
+
+/***************************************************************************
+ * smp_bin(): - Return the sample as an ED_PT_VALUES payload, making it
+ * if this is the first subscriber to need it.  Each value is a type
+ * byte followed by eight bytes in network byte order, a signed integer
+ * or an IEEE double.  An ED_VT_TEXT value is a type byte, a length
+ * byte, and the characters.
+ ***************************************************************************/
+char *smp_bin(
+    ED_SAMPLE *ps,        // the sample
+    int     *plen)        // set to the bytes in the payload
+{
+    const ED_VALUE *pv;   // value being encoded
+    char    *out;         // where the payload goes
+    uint64_t u;           // the value as 64 bits
+    int      len = 0;     // bytes in out
+    int      slen;        // length of a text value
+    int      i;
+
+    if (ps->bin == 0) {
+        out = ps->bbuf;
+        for (i = 0, pv = ps->vals; i < ps->nval; i++, pv++) {
+            if (pv->type == ED_VT_TEXT) {
+                slen = (pv->v.s) ? strlen(pv->v.s) : 0;
+                slen = (slen > BIN_MXTEXT) ? BIN_MXTEXT : slen;
+                if (len + 2 + slen > MXRPLY)
+                    break;
+                out[len++] = (char) pv->type;
+                out[len++] = (char) slen;
+                memcpy(&(out[len]), pv->v.s, slen);
+                len += slen;
+                continue;
+            }
+            if (len + BIN_VALSZ > MXRPLY)
+                break;
+            if (pv->type == ED_VT_FLOAT)
+                memcpy(&u, &(pv->v.d), sizeof(u));
+            else
+                u = (uint64_t) pv->v.i;
+            out[len++] = (char) pv->type;
+            len += put_u64(&(out[len]), u);
+        }
+        ps->bin = out;
+        ps->blen = len;
+    }
+    *plen = ps->blen;
+    return(ps->bin);
+}
+
+
+/***************************************************************************
+ * smp_json(): - Return the sample as a JSON array on one line, making
+ * it if this is the first subscriber to need it.  Times are in
+ * microseconds.  Floats that are not finite are null.
+ ***************************************************************************/
+char *smp_json(
+    ED_SAMPLE *ps,        // the sample
+    int     *plen)        // set to the bytes in the JSON
+{
+    const ED_VALUE *pv;   // value being formatted
+    const char *pc;       // loop over the characters of a text value
+    char    *out;         // where the JSON goes
+    int      size;        // room in out
+    int      len = 0;     // bytes in out
+    int      i;
+
+    if (ps->json == 0) {
+        out = ps->jbuf;
+        size = MXRPLY - 2;   // room for the ] and newline
+        out[len++] = '[';
+        for (i = 0, pv = ps->vals; (i < ps->nval) && (len < size - 2); i++, pv++) {
+            if (i > 0)
+                out[len++] = ',';
+            if (pv->type == ED_VT_FLOAT) {
+                if (isfinite(pv->v.d))
+                    len += snprintf(&(out[len]), (size - len), "%.*f", pv->prec, pv->v.d);
+                else
+                    len += snprintf(&(out[len]), (size - len), "null");
+            }
+            else if (pv->type == ED_VT_TEXT) {
+                out[len++] = '"';
+                for (pc = (pv->v.s) ? pv->v.s : ""; (*pc) && (len < size - 3); pc++) {
+                    if ((*pc == '"') || (*pc == '\\'))
+                        out[len++] = '\\';
+                    out[len++] = ((unsigned char) *pc < ' ') ? ' ' : *pc;
+                }
+                out[len++] = '"';
+            }
+            else {
+                len += snprintf(&(out[len]), (size - len), "%lld", pv->v.i);
+            }
+        }
+        len = (len < size) ? len : size - 1;
+        out[len++] = ']';
+        out[len++] = '\n';
+        ps->json = out;
+        ps->jlen = len;
+    }
+    *plen = ps->jlen;
+    return(ps->json);
+}
+
+
+/***************************************************************************
+ * smp_values(): - Return the values of a sample and set *pn to how many
+ * there are.  The text of a bcst_ui() sample is split into words the
+ * first time a subscriber needs it.  A word is an ED_VT_INT if it is all
+ * a decimal integer, an ED_VT_FLOAT if it is all a number, and an
+ * ED_VT_TEXT otherwise.
+ ***************************************************************************/
+const ED_VALUE *smp_values(
+    ED_SAMPLE *ps,        // the sample
+    int     *pn)          // set to the number of values
+{
+    ED_VALUE *pv;         // value being parsed
+    char    *word;        // start of a word in wbuf
+    char    *end;         // first character not converted
+    char    *pc;          // the decimal point in a word
+    int      len;         // bytes of text
+    int      i;
+
+    if (ps->vals) {
+        *pn = ps->nval;
+        return(ps->vals);
+    }
+    if (ps->tvals == 0) {
+        len = (ps->tlen < MXRPLY) ? ps->tlen : MXRPLY - 1;
+        memcpy(ps->wbuf, ps->txt, len);
+        ps->wbuf[len] = (char) 0;
+        i = 0;
+        for (word = strtok_r(ps->wbuf, " \t\r\n", &end);
+             (word) && (i < MX_SMPVAL);
+             word = strtok_r((char *) 0, " \t\r\n", &end), i++) {
+            pv = &(ps->vbuf[i]);
+            pv->width = 0;
+            pv->prec = 0;
+            pv->v.i = strtoll(word, &pc, 10);
+            if ((*pc == (char) 0) && (pc != word)) {
+                pv->type = ED_VT_INT;
+                continue;
+            }
+            pv->v.d = strtod(word, &pc);
+            if ((*pc == (char) 0) && (pc != word)) {
+                pv->type = ED_VT_FLOAT;
+                pc = strchr(word, '.');
+                pv->prec = (pc) ? strspn(pc + 1, "0123456789") : 0;
+                continue;
+            }
+            pv->type = ED_VT_TEXT;
+            pv->v.s = word;
+        }
+        ps->tvals = ps->vbuf;
+        ps->ntval = i;
+    }
+    *pn = ps->ntval;
+    return(ps->tvals);
+}
+
+
+/***************************************************************************
+ * ed_subscribe(): - Call cb with the values of each broadcast from the
+ * resource at slot/rsc.  The callback is called as
+ *     cb(slot, rsc, const ED_VALUE *vals, int nval, arg)
+ * and the values are valid only during the call.  Returns an ID to give
+ * to ed_unsubscribe(), or -1 if the resource can not broadcast or there
+ * are no free subscriptions.
+ ***************************************************************************/
+int ed_subscribe(
+    int      slot,        // slot of the resource
+    int      rsc,         // resource index in the slot
+    void   (*cb) (),      // called with the values of each broadcast
+    void    *arg)         // data included in call of callback
+{
+    RSC     *prsc;        // the resource
+    char     rply[MXRPLY]; // replies from the plug-in are ignored
+    int      len;
+    int      id;
+
+    // Subscriptions are made from Initialize(), not from a plug-in thread
+    if ((slot < 0) || (slot >= MX_PLUGIN) || (rsc < 0) || (rsc >= Slots[slot].nrsc) ||
+        (cb == 0) || (thr_slot() != 0))
+        return(-1);
+    prsc = RSCPTR(&(Slots[slot]), rsc);
+    if ((prsc->flags & CAN_BROADCAST) == 0)
+        return(-1);
+    start_lock();
+    for (id = 0; id < MX_SUB; id++) {
+        if (Subs[id].cb == 0)
+            break;
+    }
+    if (id == MX_SUB) {
+        start_unlock();
+        edlog(M_NOSUB, prsc->name);
+        return(-1);
+    }
+    Subs[id].bkey = MKHANDLE(slot, rsc);
+    Subs[id].cb = cb;
+    Subs[id].arg = arg;
+    Subs[id].owner = so_owner(cb);
+
+    // Tell the resource that someone is listening, just as edcat does
+    watch_rsc(prsc, Subs[id].bkey);
+    if (prsc->pgscb) {
+        len = MXRPLY;
+        (prsc->pgscb)(EDCAT, rsc, (char *) 0, &(Slots[slot]), UI_BATCH, &len, rply);
+    }
+    start_unlock();
+    return(id);
+}
+
+
+/***************************************************************************
+ * ed_unsubscribe(): - Stop a subscription.  The resource's bkey is
+ * cleared if no one else is watching.  It is safe to call this from the
+ * subscription's own callback.
+ ***************************************************************************/
+void ed_unsubscribe(
+    int      id)          // ID from ed_subscribe()
+{
+    int      bkey;        // slot/rsc of the resource
+
+    if ((id < 0) || (id >= MX_SUB))
+        return;
+    if (thr_route(THR_UNSUB, id, (void *) 0, (char *) 0, 0) == 0)
+        return;           // a plug-in thread, done in the daemon's loop
+    start_lock();
+    bkey = Subs[id].bkey;
+    Subs[id].cb = NULL;
+    Subs[id].arg = (void *) NULL;
+    Subs[id].bkey = 0;
+    if (bkey != 0)
+        unwatch_rsc(bkey);
+    start_unlock();
+    return;
+}
+
+
+/***************************************************************************
+ * unsub_slot(): - Stop the subscriptions made by a plug-in that is
+ * being unloaded, or the subscriptions to one of its resources.
+ ***************************************************************************/
+void unsub_slot(
+    int      owner,       // slot of the subscribing plug-in, or 0
+    int      bkey)        // slot/rsc of the resource, or 0
+{
+    int      id;
+
+    for (id = 0; id < MX_SUB; id++) {
+        if ((Subs[id].cb != 0) && (((owner != 0) && (Subs[id].owner == owner)) ||
+            ((bkey != 0) && (Subs[id].bkey == bkey))))
+            ed_unsubscribe(id);
+    }
+    return;
+}
+
+
+/***************************************************************************
+ * bus_bcst(): - Give a broadcast to the plug-ins that subscribed to it.
+ * Returns the number of subscribers so the broadcast key is kept while
+ * any remain.
+ ***************************************************************************/
+int bus_bcst(
+    int      bkey,        // slot/rsc of the broadcast
+    ED_SAMPLE *ps)        // the broadcast
+{
+    ED_SUB  *psub;        // subscription to check
+    const ED_VALUE *vals = 0; // the values of the sample
+    int      n = 0;       // number of values
+    int      nsub = 0;    // number of subscribers
+    int      i;
+
+    for (i = 0, psub = Subs; i < MX_SUB; i++, psub++) {
+        if ((psub->cb == 0) || (psub->bkey != bkey))
+            continue;
+        if (nsub++ == 0)
+            vals = smp_values(ps, &n);
+        // A subscriber loaded with @thread gets a copy in its thread
+        if (thr_sub(psub, bkey, vals, n) == 0)
+            continue;
+        (psub->cb)(HANDLE2SLOT(bkey), HANDLE2RSC(bkey), vals, n, psub->arg);
+    }
+    return(nsub);
+}
+
+
+/***************************************************************************
+ * bus_listens(): - Return the number of plug-ins subscribed to a
+ * resource.
+ ***************************************************************************/
+int bus_listens(
+    int      bkey)        // slot/rsc of the resource
+{
+    int      nsub = 0;    // number of subscribers
+    int      i;
+
+    for (i = 0; i < MX_SUB; i++) {
+        if ((Subs[i].cb != 0) && (Subs[i].bkey == bkey))
+            nsub++;
+    }
+    return(nsub);
+}
+
+
+/***************************************************************************
+ * ed_set(): - Set the value of a resource by calling its set routine
+ * directly.  Returns 0 on success, or -1 if the resource is not
+ * writable, is busy, or the plug-in did not accept the value.  A write
+ * the plug-in leaves pending counts as a success.
+ ***************************************************************************/
+int ed_set(
+    int      slot,        // slot of the resource
+    int      rsc,         // resource index in the slot
+    char    *val)         // the new value as it would be given to edset
+{
+    RSC     *prsc;        // the resource
+    char     rply[MXRPLY]; // error message from the plug-in, if any
+    int      req;         // cn and request ID for the plug-in
+    int      len;
+
+    if ((slot < 0) || (slot >= MX_PLUGIN) || (rsc < 0) || (rsc >= Slots[slot].nrsc) ||
+        (val == 0) || (*val == (char) 0))
+        return(-1);
+    // A plug-in thread can not wait for the answer.  The set is done in
+    // the daemon's loop and counts as a success, like a pending one.
+    if (thr_route(THR_SET, MKHANDLE(slot, rsc), (void *) 0, val, strlen(val)) == 0)
+        return(0);
+    start_lock();
+    prsc = RSCPTR(&(Slots[slot]), rsc);
+    if (((prsc->flags & IS_WRITABLE) == 0) || (prsc->pgscb == 0) ||
+        (prsc->uilock >= 0)) {
+        start_unlock();
+        return(-1);
+    }
+    if (prsc->dpriv != 0)
+        ed_cache(prsc, (char *) 0, 0);
+    prsc->uilock = UI_BATCH;
+    req = mkreq(UI_BATCH);
+    len = MXRPLY;
+    (prsc->pgscb)(EDSET, rsc, val, &(Slots[slot]), req, &len, rply);
+    if (len == ED_PENDING) {
+        (void) add_wait(UI_BATCH, slot, rsc, 0, WT_PENDING, req, (char *) 0);
+        start_unlock();
+        return(0);
+    }
+    prsc->uilock = -1;
+    start_unlock();
+    return(((len > 0) && (len < MXRPLY)) ? -1 : 0);
+}
+
+
+/***************************************************************************
+ * put_u64(): - Put a 64 bit value in network byte order.  Returns 8.
+ ***************************************************************************/
+static int put_u64(
+    char    *out,         // where to put the value
+    uint64_t u)           // the value
+{
+    int      i;
+
+    for (i = 7; i >= 0; i--) {
+        out[i] = (char) (u & 0xff);
+        u >>= 8;
+    }
+    return(8);
+}
+
+// end of publish.c
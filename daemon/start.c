@@ -0,0 +1,363 @@
+/*
+ * Name: start.c
+ *
+ * Description: This file starts the plug-ins given on the command line.
+ *              Each plug-in is loaded and initialized on a thread of its
+ *              own so a plug-in that spends a long time in Initialize(),
+ *              calibrating a sensor or waiting on a device, does not hold
+ *              up the others.  The daemon's loop starts once they have
+ *              all returned.
+ *                A plug-in that uses another plug-in from Initialize()
+ *              names its .so file in a string called Depends, as in
+ *                  const char *Depends = "gps.so";
+ *              and is not initialized until that plug-in is.
+ *                The calls that change the daemon's tables hold the start
+ *              lock while the plug-ins start.  The time each plug-in
+ *              took is kept for the daemon's startup resource.
+ *
+ * Copyright:   Copyright (C) 2019 by Demand Peripherals, Inc.
+ *              All rights reserved.
+ *
+ * License:     This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the Version 2 of the GNU General
+ *              Public License as published by the Free Software Foundation.
+ *              GPL2.txt in the top level directory is a copy of this license.
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *              GNU General Public License for more details.
+ *
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dlfcn.h>
+#include "main.h"
+
+
+/***************************************************************************
+ *  - Limits and defines
+ ***************************************************************************/
+        // Where a slot is in starting
+#define ST_IDLE         0      /* not started at startup */
+#define ST_INIT         1      /* loading, waiting, or in Initialize() */
+#define ST_DONE         2      /* Initialize() returned or the load failed */
+#define ST_LATER        3      /* to start in the daemon's thread */
+        // Name of the string of dependencies in a plug-in
+#define DEPENDS_SYM     "Depends"
+
+
+/***************************************************************************
+ *  - Function prototypes, forward references, and externs
+ ***************************************************************************/
+void            start_slots();
+void            start_lock();
+void            start_unlock();
+void            start_deps(SLOT *, void *);
+void            start_time(SLOT *, long long);
+void            start_done(SLOT *);
+int             start_ready(int);
+int             list_start(char *, int);
+static void    *start_main(void *);
+static int      start_cycle(int, int);
+extern void     initslot(SLOT *);
+extern long long now_us();
+extern SLOT     Slots[];       // table of plug-in info
+extern int      Verbosity;     // verbosity level
+
+
+/***************************************************************************
+ *  - Statically allocated variables and arrays
+ ***************************************************************************/
+static pthread_mutex_t StartLock;  // held by calls that change the daemon's tables
+static pthread_cond_t  StartDone = PTHREAD_COND_INITIALIZER; // a slot finished
+static int       Starting = 0;     // set while the plug-ins start
+static int       StState[MX_PLUGIN]; // where each slot is in starting, ST_xxx
+static int       StWaitFor[MX_PLUGIN]; // slot being waited on, or -1
+static long long StWaitUs[MX_PLUGIN]; // us waiting on dependencies
+static long long StInitUs[MX_PLUGIN]; // us loading and in Initialize()
+static long long StReadyUs = 0;    // us from the first load to ready
+
+
+/***************************************************************************
+ * start_slots(): - Load and initialize the plug-ins of all slots, each
+ * on a thread of its own, and wait for them all to finish.  A slot is
+ * initialized in the daemon's thread, after the others have started, if
+ * its thread can not start.
+ ***************************************************************************/
+void start_slots()
+{
+    pthread_mutexattr_t attr;     // to make the start lock recursive
+    pthread_t tids[MX_PLUGIN];    // thread of each slot
+    int      started[MX_PLUGIN];  // set if tids[] has a thread
+    int      later[MX_PLUGIN];    // set if the slot starts in this thread
+    int      ret;                 // return value of pthread_create()
+    long long t0;                 // when the first load started
+    char     num[2][20];          // numbers for the log
+    int      i;
+
+    // A call that changes the tables can call another, so the lock is
+    // recursive
+    (void) pthread_mutexattr_init(&attr);
+    (void) pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    (void) pthread_mutex_init(&StartLock, &attr);
+    (void) pthread_mutexattr_destroy(&attr);
+
+    t0 = now_us();
+    for (i = 1; i < MX_PLUGIN; i++) {
+        StWaitFor[i] = -1;
+        StState[i] = (Slots[i].soname[0] != (char) 0) ? ST_INIT : ST_IDLE;
+    }
+    Starting = 1;
+
+    for (i = 1; i < MX_PLUGIN; i++) {
+        started[i] = 0;
+        later[i] = 0;
+        if (StState[i] == ST_IDLE)
+            continue;
+        ret = pthread_create(&(tids[i]), (pthread_attr_t *) 0, start_main,
+                (void *) &(Slots[i]));
+        if (ret == 0) {
+            started[i] = 1;
+            continue;
+        }
+        edlog(M_NOTHREAD, Slots[i].soname, strerror(ret));
+        start_lock();
+        StState[i] = ST_LATER;
+        start_unlock();
+        later[i] = 1;
+    }
+    for (i = 1; i < MX_PLUGIN; i++) {
+        if (!later[i])
+            continue;
+        // A slot that depends on it may have started it already
+        start_lock();
+        if (StState[i] != ST_LATER) {
+            start_unlock();
+            continue;
+        }
+        StState[i] = ST_INIT;
+        start_unlock();
+        (void) start_main((void *) &(Slots[i]));
+    }
+    for (i = 1; i < MX_PLUGIN; i++) {
+        if (started[i])
+            (void) pthread_join(tids[i], (void **) 0);
+    }
+
+    // The start lock is not needed once the daemon's loop runs
+    Starting = 0;
+    StReadyUs = now_us() - t0;
+    if (Verbosity >= ED_VERB_INFO) {
+        for (i = 1; i < MX_PLUGIN; i++) {
+            if ((StState[i] == ST_IDLE) || (Slots[i].soname[0] == (char) 0))
+                continue;
+            (void) snprintf(num[0], sizeof(num[0]), "%lld", StInitUs[i] / 1000);
+            (void) snprintf(num[1], sizeof(num[1]), "%lld", StWaitUs[i] / 1000);
+            edlog(M_STARTED, Slots[i].soname, num[0], num[1]);
+        }
+        (void) snprintf(num[0], sizeof(num[0]), "%lld", StReadyUs / 1000);
+        edlog(M_READY, num[0]);
+    }
+    return;
+}
+
+
+/***************************************************************************
+ * start_main(): - Load and initialize the plug-in of one slot and tell
+ * the slots that depend on it that it is done.
+ ***************************************************************************/
+static void *start_main(
+    void    *arg)         // the slot to start
+{
+    SLOT    *pslot;       // the slot to start
+
+    pslot = (SLOT *) arg;
+    initslot(pslot);
+
+    start_lock();
+    StState[pslot->slot_id] = ST_DONE;
+    (void) pthread_cond_broadcast(&StartDone);
+    start_unlock();
+    return((void *) 0);
+}
+
+
+/***************************************************************************
+ * start_lock(): - Take the start lock if the plug-ins are starting.
+ * Calls that change the daemon's tables take it so that plug-ins in
+ * Initialize() at the same time do not change them at once.
+ ***************************************************************************/
+void start_lock()
+{
+    if (Starting)
+        (void) pthread_mutex_lock(&StartLock);
+    return;
+}
+
+
+/***************************************************************************
+ * start_unlock(): - Give back the start lock.
+ ***************************************************************************/
+void start_unlock()
+{
+    if (Starting)
+        (void) pthread_mutex_unlock(&StartLock);
+    return;
+}
+
+
+/***************************************************************************
+ * start_deps(): - Wait for the plug-ins named in the Depends string of
+ * a plug-in to finish their Initialize().  This is called from
+ * initslot() with the start lock held.  A dependency whose thread did
+ * not start is started here, on this thread, rather than waiting for
+ * the daemon's thread to get to it.  Names of plug-ins that are not
+ * loaded are ignored, as is a dependency that would wait forever.
+ ***************************************************************************/
+void start_deps(
+    SLOT    *pslot,       // the slot about to be initialized
+    void    *handle)      // its .so file from dlopen()
+{
+    const char **pdeps;   // the plug-in's Depends string
+    char     deps[MXCMD]; // a copy to tokenize
+    char    *dep;         // a .so file name in deps
+    char    *saveptr;     // for strtok_r
+    long long t0;         // when the wait started
+    int      self;        // slot of pslot
+    int      i;
+
+    self = pslot->slot_id;
+    if ((!Starting) || (StState[self] != ST_INIT))
+        return;
+    dlerror();
+    pdeps = (const char **) dlsym(handle, DEPENDS_SYM);
+    if ((dlerror() != NULL) || (pdeps == 0) || (*pdeps == 0))
+        return;
+    (void) strncpy(deps, *pdeps, sizeof(deps) - 1);
+    deps[sizeof(deps) - 1] = (char) 0;
+
+    t0 = now_us();
+    for (dep = strtok_r(deps, " ,", &saveptr); dep != 0;
+         dep = strtok_r((char *) 0, " ,", &saveptr)) {
+        for (i = 1; i < MX_PLUGIN; i++) {
+            if ((i == self) || (strcmp(Slots[i].soname, dep) != 0))
+                continue;
+            if (StState[i] == ST_LATER) {
+                // The lock is recursive.  Give it up so the dependency
+                // can wait and run Initialize() as it would on its own.
+                StState[i] = ST_INIT;
+                StWaitFor[self] = i;
+                start_unlock();
+                (void) start_main((void *) &(Slots[i]));
+                start_lock();
+                StWaitFor[self] = -1;
+            }
+            while (StState[i] == ST_INIT) {
+                if (start_cycle(self, i)) {
+                    edlog(M_DEPCYCLE, pslot->soname, dep);
+                    break;
+                }
+                StWaitFor[self] = i;
+                (void) pthread_cond_wait(&StartDone, &StartLock);
+                StWaitFor[self] = -1;
+            }
+        }
+    }
+    StWaitUs[self] = now_us() - t0;
+    return;
+}
+
+
+/***************************************************************************
+ * start_cycle(): - Return 1 if a slot waiting for another slot would
+ * wait forever since the other slot waits, perhaps through others, for
+ * it.  Each waiting slot waits for one slot at a time.
+ ***************************************************************************/
+static int start_cycle(
+    int      self,        // slot that is to wait
+    int      other)       // slot it is to wait for
+{
+    int      n;           // limit on the slots to walk
+
+    for (n = 0; (other >= 0) && (n < MX_PLUGIN); n++) {
+        if (other == self)
+            return(1);
+        other = StWaitFor[other];
+    }
+    return(0);
+}
+
+
+/***************************************************************************
+ * start_time(): - Note how long a slot took to load and initialize,
+ * not counting the wait for its dependencies.  Plug-ins loaded with
+ * edloadso are included.
+ ***************************************************************************/
+void start_time(
+    SLOT    *pslot,       // the slot
+    long long us)         // us from dlopen() to the return of Initialize()
+{
+    if (StState[pslot->slot_id] != ST_INIT)
+        StWaitUs[pslot->slot_id] = 0;
+    StInitUs[pslot->slot_id] = us - StWaitUs[pslot->slot_id];
+    return;
+}
+
+
+/***************************************************************************
+ * start_done(): - Mark a slot done as soon as its Initialize() returns
+ * so that index_names() adds its names.  The slots waiting for it wake
+ * once the start lock is given back.
+ ***************************************************************************/
+void start_done(
+    SLOT    *pslot)       // the slot
+{
+    if ((!Starting) || (StState[pslot->slot_id] != ST_INIT))
+        return;
+    StState[pslot->slot_id] = ST_DONE;
+    (void) pthread_cond_broadcast(&StartDone);
+    return;
+}
+
+
+/***************************************************************************
+ * start_ready(): - Return 1 if the names of a slot can be indexed, or 0
+ * if the slot is still loading or in Initialize() while the plug-ins
+ * start and its resources may be changing.
+ ***************************************************************************/
+int start_ready(
+    int      slot)        // the slot
+{
+    return((!Starting) || (StState[slot] == ST_DONE) || (StState[slot] == ST_IDLE));
+}
+
+
+/***************************************************************************
+ * list_start(): - Put a line for each loaded plug-in in buf with its
+ * slot, its .so file, the ms it took to load and initialize, and the ms
+ * it waited for its dependencies.  The last line gives the ms from the
+ * start of the first plug-in to the daemon being ready.  Returns the
+ * number of characters in buf.
+ ***************************************************************************/
+int list_start(
+    char    *buf,         // where to put the list
+    int      size)        // size of buf
+{
+    int      i;
+    int      len = 0;     // bytes in buf
+
+    for (i = 1; (i < MX_PLUGIN) && (len < size); i++) {
+        if ((Slots[i].soname[0] == (char) 0) || (Slots[i].name == 0))
+            continue;
+        len += snprintf(&(buf[len]), (size - len), "%d %s %lld %lld\n", i,
+                Slots[i].soname, StInitUs[i] / 1000, StWaitUs[i] / 1000);
+    }
+    if (len < size)
+        len += snprintf(&(buf[len]), (size - len), "ready %lld\n", StReadyUs / 1000);
+    return((len < size) ? len : size - 1);
+}
+
+// end of start.c
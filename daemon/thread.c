@@ -0,0 +1,826 @@
+/*
+ * Name: thread.c
+ *
+ * Description: This file runs a plug-in loaded as file.so@thread on a
+ *              thread of its own.  The thread has its own select() loop
+ *              so the FDs and timers the plug-in adds are served there
+ *              and a slow or blocking callback does not delay the other
+ *              plug-ins or the UIs.
+ *                The daemon and the thread pass messages in two queues
+ *              with no locks.  Gets, sets, and broadcasts for the
+ *              plug-in's subscriptions go to the thread.  bcst_ui(),
+ *              ed_publish(), send_ui(), prompt(), ed_complete(), and
+ *              the other calls that change the daemon's tables come
+ *              back and are done in the daemon's loop.
+ *
+ * Copyright:   Copyright (C) 2019 by Demand Peripherals, Inc.
+ *              All rights reserved.
+ *
+ * License:     This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the Version 2 of the GNU General
+ *              Public License as published by the Free Software Foundation.
+ *              GPL2.txt in the top level directory is a copy of this license.
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *              GNU General Public License for more details.
+ *
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <dlfcn.h>
+#include "main.h"
+
+
+/***************************************************************************
+ *  - Limits and defines
+ ***************************************************************************/
+
+
+/***************************************************************************
+ *  - Function prototypes, forward references, and externs
+ ***************************************************************************/
+int             thr_parse(int, char *);
+ED_LOOP        *thr_loop();
+int             thr_slot();
+int             thr_init(SLOT *);
+void            thr_start(SLOT *, int);
+int             thr_stop(int);
+int             thr_route(int, int, void *, char *, int);
+int             thr_publish(RSC *, const ED_VALUE *, int);
+int             thr_sub(ED_SUB *, int, const ED_VALUE *, int);
+static ED_TMSG *thr_msg(int, int, void *, char *, int);
+static ED_TMSG *thr_back(ED_THR *);
+static void     thr_flush(ED_THR *);
+static void     thr_free(ED_THR *);
+static void     thr_end(ED_THR *);
+static void    *thr_main(void *);
+static void     thr_pgscb(int, int, char *, SLOT *, int, int *, char *);
+static void     thr_tothr(int, void *, int);
+static void     thr_fromthr(int, void *, int);
+static void     thr_vals(ED_TMSG *, const ED_VALUE *, int);
+static int      q_open(ED_TQUEUE *);
+static ED_TMSG *q_next(ED_TQUEUE *);
+static ED_TMSG *q_wait(ED_TQUEUE *);
+static void     q_add(ED_TQUEUE *);
+static ED_TMSG *q_peek(ED_TQUEUE *);
+static void     q_take(ED_TQUEUE *);
+extern struct timeval *doTimer(ED_LOOP *);
+extern int      loop_select(ED_LOOP *, struct timeval *);
+extern void     ed_publish(RSC *, const ED_VALUE *, int);
+extern void     ed_cache(RSC *, char *, int);
+extern int      ed_set(int, int, char *);
+extern void     ed_unsubscribe(int);
+extern void     unload_slot(int);
+extern void     defer_wait(int, RSC *, int);
+extern SLOT     Slots[];       // table of plug-in info
+
+
+/***************************************************************************
+ *  - Statically allocated variables and arrays
+ ***************************************************************************/
+static ED_THR  *Thrs[MX_PLUGIN];  // thread of each slot loaded with @thread
+static int      ThrWant[MX_PLUGIN]; // set if the slot's plug-in gets a thread
+static __thread ED_THR *Initing = 0; // thread whose plug-in is in Initialize()
+static __thread ED_THR *Self = 0; // thread of the calling plug-in, 0 in the daemon
+
+
+/***************************************************************************
+ * thr_parse(): - Note if a .so file name in a slot ends in @thread and
+ * remove the suffix.  Returns 1 if the plug-in is to run on a thread.
+ ***************************************************************************/
+int thr_parse(
+    int      slot,        // slot of the plug-in
+    char    *soname)      // its file name
+{
+    int      len;         // chars in soname
+    int      slen;        // chars in the suffix
+
+    len = strlen(soname);
+    slen = strlen(THR_SUFFIX);
+    ThrWant[slot] = ((len > slen) && (!strcmp(&(soname[len - slen]), THR_SUFFIX)));
+    if (ThrWant[slot])
+        soname[len - slen] = (char) 0;
+    return(ThrWant[slot]);
+}
+
+
+/***************************************************************************
+ * thr_loop(): - Return the loop of the calling plug-in thread, or of
+ * the threaded plug-in being initialized, or 0 for the daemon's loop.
+ ***************************************************************************/
+ED_LOOP *thr_loop()
+{
+    if (Self)
+        return(&(Self->loop));
+    if (Initing)
+        return(&(Initing->loop));
+    return((ED_LOOP *) 0);
+}
+
+
+/***************************************************************************
+ * thr_slot(): - Return the slot of the plug-in thread making the call,
+ * or 0 if the call is made in the daemon's loop.
+ ***************************************************************************/
+int thr_slot()
+{
+    return((Self) ? Self->pslot->slot_id : 0);
+}
+
+
+/***************************************************************************
+ * thr_init(): - Set up the thread of a slot loaded with @thread.  This
+ * is called just before the plug-in's Initialize() so the FDs and
+ * timers it adds go to the thread's loop.  Returns 0 on success, or -1
+ * if the thread can not be set up.
+ ***************************************************************************/
+int thr_init(
+    SLOT    *pslot)       // the plug-in's slot
+{
+    ED_THR  *pt;          // the new thread
+    int      i;
+
+    if (ThrWant[pslot->slot_id] == 0)
+        return(0);
+    pt = calloc(1, sizeof(ED_THR));
+    if (pt == 0) {
+        edlog(M_NOMEM, "thr_init");
+        return(-1);
+    }
+    pt->pslot = pslot;
+    pt->in.rfd = pt->in.wfd = pt->out.rfd = pt->out.wfd = -1;
+    for (i = 0; i < THR_NFD; i++) {
+        pt->fds[i].fd = -1;
+    }
+    for (i = 0; i < THR_NTIMER; i++) {
+        pt->timers[i].type = ED_UNUSED;
+    }
+    pt->loop.fds = pt->fds;
+    pt->loop.nfd = THR_NFD;
+    pt->loop.timers = pt->timers;
+    pt->loop.ntimer = THR_NTIMER;
+    pt->loop.mxfd = -1;
+    if ((q_open(&(pt->in)) < 0) || (q_open(&(pt->out)) < 0)) {
+        edlog(M_NOTHREAD, pslot->soname, strerror(errno));
+        thr_free(pt);
+        return(-1);
+    }
+    Thrs[pslot->slot_id] = pt;
+    Initing = pt;
+    return(0);
+}
+
+
+/***************************************************************************
+ * thr_start(): - Start the thread of a plug-in after its Initialize()
+ * returns.  The get/set routine of each resource is replaced with one
+ * that passes the call to the thread.  The thread is freed if the
+ * plug-in did not initialize.
+ ***************************************************************************/
+void thr_start(
+    SLOT    *pslot,       // the plug-in's slot
+    int      ok)          // set if Initialize() succeeded
+{
+    ED_THR  *pt;          // the slot's thread
+    RSC     *prsc;        // a resource of the plug-in
+    int      i;
+
+    pt = Thrs[pslot->slot_id];
+    if (pt == 0)
+        return;
+    if (ok) {
+        // The wakeup FD of the calls is in the thread's loop
+        add_fd(pt->in.rfd, ED_READ, thr_tothr, (void *) pt);
+    }
+    Initing = (ED_THR *) 0;
+    if (ok) {
+        pt->npgscb = pslot->nrsc;
+        pt->pgscb = calloc(pt->npgscb, sizeof(void (*) ()));
+        ok = (pt->pgscb != 0);
+    }
+    if (ok) {
+        for (i = 0; i < pt->npgscb; i++) {
+            prsc = RSCPTR(pslot, i);
+            pt->pgscb[i] = prsc->pgscb;
+            if (prsc->pgscb)
+                prsc->pgscb = thr_pgscb;
+        }
+        add_fd(pt->out.rfd, ED_READ, thr_fromthr, (void *) pt);
+        errno = pthread_create(&(pt->tid), (pthread_attr_t *) 0, thr_main, (void *) pt);
+        if (errno == 0)
+            return;
+        edlog(M_NOTHREAD, pslot->soname, strerror(errno));
+        del_fd(pt->out.rfd);
+        for (i = 0; i < pt->npgscb; i++) {
+            RSCPTR(pslot, i)->pgscb = pt->pgscb[i];
+        }
+    }
+    Thrs[pslot->slot_id] = (ED_THR *) 0;
+    thr_free(pt);
+    return;
+}
+
+
+/***************************************************************************
+ * thr_stop(): - Tell the thread of a plug-in that is being unloaded to
+ * stop.  The thread calls the plug-in's Finalize(), if it has one, and
+ * sends THR_DONE as it exits.  thr_fromthr() then frees the thread and
+ * calls unload_slot() to finish the unload, so the daemon's loop does
+ * not wait on the plug-in.  Returns -1 if the plug-in has no thread.
+ ***************************************************************************/
+int thr_stop(
+    int      slot)        // slot of the plug-in
+{
+    ED_THR  *pt;          // the slot's thread
+
+    pt = Thrs[slot];
+    if (pt == 0)
+        return(-1);
+    __atomic_store_n(&(pt->stop), 1, __ATOMIC_RELEASE);
+    if (write(pt->in.wfd, "", 1) < 0) {
+        // The pipe is full so the thread is already awake
+    }
+    return(0);
+}
+
+
+/***************************************************************************
+ * thr_route(): - Pass a call made by a plug-in thread to the daemon's
+ * loop.  Returns 0 if the call was passed, or -1 if the caller is the
+ * daemon's loop and should do the call itself.
+ ***************************************************************************/
+int thr_route(
+    int      type,        // THR_REPLY, THR_BCST, ...
+    int      id,          // cn, subscription ID, or slot/rsc of ed_set()
+    void    *ptr,         // the RSC or bkey pointer
+    char    *buf,         // data of the call, if any
+    int      len)         // bytes in buf
+{
+    if (Self == 0)
+        return(-1);
+    (void) thr_msg(type, id, ptr, buf, len);
+    q_add(&(Self->out));
+    return(0);
+}
+
+
+/***************************************************************************
+ * thr_msg(): - Fill in the next message from the calling plug-in thread
+ * to the daemon, sleeping until there is room if the queue is full.
+ * The caller gives it to the daemon with q_add().
+ ***************************************************************************/
+static ED_TMSG *thr_msg(
+    int      type,        // THR_REPLY, THR_BCST, ...
+    int      id,          // cn, subscription ID, or slot/rsc of ed_set()
+    void    *ptr,         // the RSC or bkey pointer
+    char    *buf,         // data of the call, if any
+    int      len)         // bytes in buf
+{
+    ED_TMSG *pm;          // the message to the daemon
+
+    pm = q_next(&(Self->out));
+    if (pm == 0)
+        pm = q_wait(&(Self->out));
+    pm->type = type;
+    pm->cmd = 0;
+    pm->plain = 0;
+    pm->cn = id;
+    pm->bkey = id;
+    pm->ptr = ptr;
+    len = ((buf == 0) || (len < 0)) ? 0 : len;
+    pm->len = (len < MXCMD) ? len : MXCMD - 1;
+    if (pm->len > 0)
+        memcpy(pm->data, buf, pm->len);
+    pm->data[pm->len] = (char) 0;
+    return(pm);
+}
+
+
+/***************************************************************************
+ * thr_publish(): - Pass an ed_publish() from a plug-in thread to the
+ * daemon's loop.  Returns -1 if the caller is the daemon's loop.
+ ***************************************************************************/
+int thr_publish(
+    RSC     *prsc,        // the broadcast resource
+    const ED_VALUE *vals, // the values of the sample
+    int      n)           // number of values
+{
+    ED_TMSG *pm;          // the message to the daemon
+
+    if (Self == 0)
+        return(-1);
+    if ((prsc == 0) || (prsc->bkey == 0) || (vals == 0) || (n <= 0))
+        return(0);        // no one is listening
+    pm = thr_msg(THR_PUBLISH, 0, (void *) prsc, (char *) 0, 0);
+    thr_vals(pm, vals, n);
+    q_add(&(Self->out));
+    return(0);
+}
+
+
+/***************************************************************************
+ * thr_sub(): - Pass a broadcast to the ed_subscribe() callback of a
+ * plug-in thread.  The sample is dropped if the thread is too far
+ * behind.  The drops are counted and logged once the thread catches
+ * up.  Returns -1 if the subscriber is not on a thread.
+ ***************************************************************************/
+int thr_sub(
+    ED_SUB  *psub,        // the subscription
+    int      bkey,        // slot/rsc of the broadcast
+    const ED_VALUE *vals, // the values of the sample
+    int      n)           // number of values
+{
+    ED_THR  *pt;          // the subscriber's thread
+    ED_TMSG *pm;          // the message to the thread
+    char     cdrop[20];   // number of drops as a string for the log
+
+    pt = ((psub->owner > 0) && (psub->owner < MX_PLUGIN)) ? Thrs[psub->owner] : 0;
+    if (pt == 0)
+        return(-1);
+    if (pt->nback != 0)
+        thr_flush(pt);
+    pm = (pt->nback == 0) ? q_next(&(pt->in)) : (ED_TMSG *) 0;
+    if (pm == 0) {
+        pt->ndrop++;
+        return(0);
+    }
+    if (pt->ndrop != 0) {
+        (void) snprintf(cdrop, sizeof(cdrop), "%u", pt->ndrop);
+        edlog(M_THRDROP, pt->pslot->soname, cdrop);
+        pt->ndrop = 0;
+    }
+    pm->type = THR_SUB;
+    pm->bkey = bkey;
+    pm->ptr = (void *) psub->cb;
+    pm->arg = psub->arg;
+    thr_vals(pm, vals, n);
+    q_add(&(pt->in));
+    return(0);
+}
+
+
+/***************************************************************************
+ * thr_pgscb(): - The get/set routine of each resource of a threaded
+ * plug-in.  The call is passed to the thread and the get or set is left
+ * pending.  The thread answers with a THR_REPLY when the plug-in's own
+ * routine returns, or the plug-in calls ed_complete() itself later.
+ * A get or set is refused if the thread is far behind.  A cat,
+ * subscribe, or unsubscribe waits in the backlog instead, since the
+ * plug-in would not learn of it otherwise.
+ ***************************************************************************/
+static void thr_pgscb(
+    int      cmd,         // EDGET, EDSET, EDCAT, EDSUB, or EDUNSUB
+    int      rscid,       // resource index
+    char    *val,         // value of a set, if any
+    SLOT    *pslot,       // the plug-in's slot
+    int      cn,          // UI of the request
+    int     *plen,        // size of buf and length of any reply
+    char    *buf)         // where to put an error message
+{
+    ED_THR  *pt;          // the plug-in's thread
+    ED_TMSG *pm;          // the message to the thread
+    int      len;         // length of val
+
+    pt = Thrs[pslot->slot_id];
+    if ((pt == 0) || (rscid < 0) || (rscid >= pt->npgscb)) {
+        *plen = 0;
+        return;
+    }
+    // Calls already waiting go first
+    if (pt->nback != 0)
+        thr_flush(pt);
+    pm = (pt->nback == 0) ? q_next(&(pt->in)) : (ED_TMSG *) 0;
+    if ((pm == 0) && ((cmd == EDGET) || (cmd == EDSET))) {
+        // The thread is far behind.  Refuse the request.
+        *plen = snprintf(buf, *plen, E_BUSY, RSCPTR(pslot, rscid)->name);
+        return;
+    }
+    if ((pm == 0) && ((pm = thr_back(pt)) == 0)) {
+        *plen = 0;
+        return;
+    }
+    pm->type = THR_CALL;
+    pm->cmd = cmd;
+    pm->rsc = rscid;
+    pm->cn = cn;
+    pm->ptr = (void *) RSCPTR(pslot, rscid);
+    len = (val) ? strlen(val) : -1;
+    pm->len = (len < MXCMD) ? len : MXCMD - 1;
+    if (pm->len >= 0) {
+        memcpy(pm->data, val, pm->len);
+        pm->data[pm->len] = (char) 0;
+    }
+    if (pt->nback == 0)
+        q_add(&(pt->in));
+    else
+        thr_flush(pt);
+    *plen = ((cmd != EDGET) && (cmd != EDSET)) ? 0 : ED_PENDING;
+    return;
+}
+
+
+/***************************************************************************
+ * thr_back(): - Return a new entry at the end of a thread's backlog of
+ * calls, or 0 if there is no memory for it.  The backlog doubles as it
+ * fills.  thr_flush() gives the calls to the thread.
+ ***************************************************************************/
+static ED_TMSG *thr_back(
+    ED_THR  *pt)          // the thread
+{
+    ED_TMSG *pback;       // the grown backlog
+    int      mx;          // its size
+
+    if (pt->nback == pt->mxback) {
+        mx = (pt->mxback == 0) ? THR_NBACK0 : 2 * pt->mxback;
+        pback = realloc(pt->back, mx * sizeof(ED_TMSG));
+        if (pback == 0) {
+            edlog(M_NOMEM, "thr_back");
+            return((ED_TMSG *) 0);
+        }
+        pt->back = pback;
+        pt->mxback = mx;
+    }
+    return(&(pt->back[pt->nback++]));
+}
+
+
+/***************************************************************************
+ * thr_flush(): - Give a thread as many of the calls in its backlog as
+ * its queue has room for.  The fence pairs with the one in q_take() so
+ * either the daemon sees the room or the thread sees backed and wakes
+ * the daemon's loop once it has made room.
+ ***************************************************************************/
+static void thr_flush(
+    ED_THR  *pt)          // the thread
+{
+    ED_TMSG *pm;          // entry in the queue
+    int      i;
+
+    __atomic_store_n(&(pt->backed), 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    for (i = 0; i < pt->nback; i++) {
+        if ((pm = q_next(&(pt->in))) == 0)
+            break;
+        *pm = pt->back[i];
+        q_add(&(pt->in));
+    }
+    pt->nback -= i;
+    if (pt->nback != 0)
+        memmove(pt->back, &(pt->back[i]), pt->nback * sizeof(ED_TMSG));
+    else
+        __atomic_store_n(&(pt->backed), 0, __ATOMIC_RELAXED);
+    return;
+}
+
+
+/***************************************************************************
+ * thr_main(): - The plug-in thread.  Run the loop of the plug-in's FDs
+ * and timers until told to stop, then call its Finalize().
+ ***************************************************************************/
+static void *thr_main(
+    void    *arg)         // the ED_THR of the thread
+{
+    ED_THR  *pt;          // this thread
+    struct timeval *ptv;  // time to the next timer
+    void   (*Finalize) (SLOT *);
+
+    pt = (ED_THR *) arg;
+    Self = pt;
+    while (__atomic_load_n(&(pt->stop), __ATOMIC_ACQUIRE) == 0) {
+        ptv = doTimer(&(pt->loop));
+        (void) loop_select(&(pt->loop), ptv);
+    }
+
+    // Finalize runs here so its del_fd() and del_timer() find this loop
+    *(void **) (&Finalize) = dlsym(pt->pslot->handle, "Finalize");
+    if (Finalize != 0)
+        Finalize(pt->pslot);
+    (void) thr_msg(THR_DONE, 0, (void *) 0, (char *) 0, 0);
+    q_add(&(pt->out));
+    return((void *) 0);
+}
+
+
+/***************************************************************************
+ * thr_tothr(): - Do the calls the daemon has given a plug-in thread.
+ * This is the callback of the wakeup FD in the thread's loop.
+ ***************************************************************************/
+static void thr_tothr(
+    int      fd,          // read end of the wakeup pipe
+    void    *arg,         // the ED_THR of the thread
+    int      activity)    // ED_READ
+{
+    ED_THR  *pt;          // this thread
+    ED_TMSG *pm;          // a call from the daemon
+    ED_TMSG *prpl;        // its reply
+    RSC     *prsc;        // resource of a call
+    char     rply[MXCMD]; // reply of a get or set
+    char     drain[64];   // wakeup bytes
+    int      len;
+
+    pt = (ED_THR *) arg;
+    while (read(fd, drain, sizeof(drain)) > 0)
+        ;
+    while ((pm = q_peek(&(pt->in))) != 0) {
+        if (pm->type == THR_SUB) {
+            ((void (*) ()) pm->ptr)(HANDLE2SLOT(pm->bkey), HANDLE2RSC(pm->bkey),
+                pm->vals, pm->nval, pm->arg);
+        }
+        else if ((pm->type == THR_CALL) && (pt->pgscb[pm->rsc] != 0)) {
+            prsc = (RSC *) pm->ptr;
+            len = MXCMD;
+            (pt->pgscb[pm->rsc])(pm->cmd, pm->rsc, ((pm->len >= 0) ? pm->data : (char *) 0),
+                pt->pslot, pm->cn, &len, rply);
+            // Answered now.  As in do_get(), a get with no reply is one
+            // the plug-in answers itself with send_ui() and prompt(), and
+            // has if it let go of the resource.  A set with no reply
+            // still needs its prompt.
+            if (((pm->cmd == EDGET) && (len > 0)) ||
+                ((pm->cmd == EDSET) && (len != ED_PENDING))) {
+                prpl = thr_msg(THR_REPLY, pm->cn, (void *) prsc, rply,
+                    ((len > 0) && (len < MXCMD)) ? len : 0);
+                prpl->cmd = pm->cmd;
+                prpl->plain = (pm->len < 0);
+                q_add(&(pt->out));
+            }
+            else if ((pm->cmd == EDGET) && (len == 0)) {
+                prpl = thr_msg(THR_DEFER, pm->cn, (void *) prsc, (char *) 0, 0);
+                prpl->cmd = (__atomic_load_n(&(prsc->uilock), __ATOMIC_RELAXED) >= 0) ?
+                    EDGET : 0;
+                q_add(&(pt->out));
+            }
+        }
+        q_take(&(pt->in));
+    }
+    // Wake the daemon if it has calls waiting for the room made.  The
+    // fence in q_take() pairs with the one in thr_flush().
+    if (__atomic_load_n(&(pt->backed), __ATOMIC_RELAXED)) {
+        if (write(pt->out.wfd, "", 1) < 0) {
+            // The pipe is full so the daemon is already awake
+        }
+    }
+    return;
+}
+
+
+/***************************************************************************
+ * thr_fromthr(): - Do the calls a plug-in thread has passed to the
+ * daemon.  This is the callback of the wakeup FD in the daemon's loop.
+ ***************************************************************************/
+static void thr_fromthr(
+    int      fd,          // read end of the wakeup pipe
+    void    *arg,         // the ED_THR of the thread
+    int      activity)    // ED_READ
+{
+    ED_THR  *pt;          // the thread
+    ED_TMSG *pm;          // a call from the thread
+    RSC     *prsc;        // resource of the call, if any
+    char     drain[64];   // wakeup bytes
+    int      slot;        // slot of a thread that is done
+
+    pt = (ED_THR *) arg;
+    while (read(fd, drain, sizeof(drain)) > 0)
+        ;
+    if (pt->nback != 0)
+        thr_flush(pt);
+    while ((pm = q_peek(&(pt->out))) != 0) {
+        prsc = (RSC *) pm->ptr;
+        switch (pm->type) {
+            case THR_REPLY:
+                // A get answered at once is cached as it would be
+                // without the thread
+                if ((pm->cmd == EDGET) && (pm->plain) && (pm->len > 0) && (prsc->dpriv != 0) &&
+                    (strncmp(pm->data, "ERROR", 5) != 0))
+                    ed_cache(prsc, pm->data, pm->len);
+                ed_complete(pm->cn, prsc, pm->data, pm->len);
+                break;
+            case THR_FAIL:
+                ed_fail(pm->cn, prsc);
+                break;
+            case THR_BCST:
+                bcst_ui(pm->data, pm->len, (int *) pm->ptr);
+                break;
+            case THR_PUBLISH:
+                ed_publish(prsc, pm->vals, pm->nval);
+                break;
+            case THR_SENDUI:
+                send_ui(pm->data, pm->len, pm->cn);
+                break;
+            case THR_PROMPT:
+                prompt(pm->cn);
+                break;
+            case THR_CACHE:
+                ed_cache(prsc, ((pm->len > 0) ? pm->data : (char *) 0), pm->len);
+                break;
+            case THR_SET:
+                (void) ed_set(HANDLE2SLOT(pm->bkey), HANDLE2RSC(pm->bkey), pm->data);
+                break;
+            case THR_UNSUB:
+                ed_unsubscribe(pm->cn);
+                break;
+            case THR_DEFER:
+                defer_wait(pm->cn, prsc, (pm->cmd == EDGET));
+                break;
+            case THR_DONE:
+                // The last message.  Finish the unload.
+                slot = pt->pslot->slot_id;
+                thr_end(pt);
+                unload_slot(slot);
+                return;
+        }
+        q_take(&(pt->out));
+    }
+    return;
+}
+
+
+/***************************************************************************
+ * thr_vals(): - Copy the values of a sample into a message.  The text
+ * of ED_VT_TEXT values is copied into the message's data.
+ ***************************************************************************/
+static void thr_vals(
+    ED_TMSG *pm,          // the message
+    const ED_VALUE *vals, // the values
+    int      n)           // number of values
+{
+    const char *s;        // text of a value
+    int      slen;        // chars of s that fit
+    int      i;
+
+    pm->nval = (n < MX_SMPVAL) ? n : MX_SMPVAL;
+    pm->len = 0;
+    for (i = 0; i < pm->nval; i++) {
+        pm->vals[i] = vals[i];
+        if (vals[i].type != ED_VT_TEXT)
+            continue;
+        s = (vals[i].v.s) ? vals[i].v.s : "";
+        slen = strnlen(s, MXCMD - pm->len - 1);
+        memcpy(&(pm->data[pm->len]), s, slen);
+        pm->data[pm->len + slen] = (char) 0;
+        pm->vals[i].v.s = &(pm->data[pm->len]);
+        pm->len += (pm->len + slen + 1 < MXCMD) ? slen + 1 : slen;
+    }
+    return;
+}
+
+
+/***************************************************************************
+ * thr_end(): - Free the thread of a plug-in once it has sent THR_DONE.
+ * The thread is past its last message so the join does not wait.
+ ***************************************************************************/
+static void thr_end(
+    ED_THR  *pt)          // the thread
+{
+    int      i;
+
+    (void) pthread_join(pt->tid, (void **) 0);
+    del_fd(pt->out.rfd);
+
+    // Close the FDs the plug-in left in its loop
+    for (i = 0; i < THR_NFD; i++) {
+        if ((pt->fds[i].fd != -1) && (pt->fds[i].fd != pt->in.rfd))
+            (void) close(pt->fds[i].fd);
+    }
+    Thrs[pt->pslot->slot_id] = (ED_THR *) 0;
+    thr_free(pt);
+    return;
+}
+
+
+/***************************************************************************
+ * thr_free(): - Free a thread that is not running
+ ***************************************************************************/
+static void thr_free(
+    ED_THR  *pt)          // the thread
+{
+    if (pt->in.rfd >= 0)
+        (void) close(pt->in.rfd);
+    if (pt->in.wfd >= 0)
+        (void) close(pt->in.wfd);
+    if (pt->out.rfd >= 0)
+        (void) close(pt->out.rfd);
+    if (pt->out.wfd >= 0)
+        (void) close(pt->out.wfd);
+    if (Initing == pt)
+        Initing = (ED_THR *) 0;
+    (void) pthread_mutex_destroy(&(pt->in.lock));
+    (void) pthread_cond_destroy(&(pt->in.room));
+    (void) pthread_mutex_destroy(&(pt->out.lock));
+    (void) pthread_cond_destroy(&(pt->out.room));
+    free(pt->pgscb);
+    free(pt->back);
+    free(pt);
+    return;
+}
+
+
+/***************************************************************************
+ * q_open(): - Open the wakeup pipe of a queue.  Both ends do not block
+ * so a full pipe is not an error.  Returns 0 on success or -1 on error.
+ ***************************************************************************/
+static int q_open(
+    ED_TQUEUE *pq)        // the queue
+{
+    int      fds[2];      // read and write ends of the pipe
+
+    (void) pthread_mutex_init(&(pq->lock), (pthread_mutexattr_t *) 0);
+    (void) pthread_cond_init(&(pq->room), (pthread_condattr_t *) 0);
+    pq->waiting = 0;
+    if (pipe(fds) < 0)
+        return(-1);
+    pq->rfd = fds[0];
+    pq->wfd = fds[1];
+    (void) fcntl(pq->rfd, F_SETFL, O_NONBLOCK);
+    (void) fcntl(pq->wfd, F_SETFL, O_NONBLOCK);
+    pq->head = 0;
+    pq->tail = 0;
+    return(0);
+}
+
+
+/***************************************************************************
+ * q_next(): - Return the entry the producer fills next, or 0 if the
+ * queue is full.  The message is not seen until q_add().
+ ***************************************************************************/
+static ED_TMSG *q_next(
+    ED_TQUEUE *pq)        // the queue
+{
+    if (pq->head - __atomic_load_n(&(pq->tail), __ATOMIC_ACQUIRE) >= THR_NMSG)
+        return((ED_TMSG *) 0);
+    return(&(pq->ent[pq->head % THR_NMSG]));
+}
+
+
+/***************************************************************************
+ * q_wait(): - Sleep until the queue has room and return the entry the
+ * producer fills next.  The fences pair with the one in q_take() so
+ * either the producer sees the room or the consumer sees it waiting.
+ ***************************************************************************/
+static ED_TMSG *q_wait(
+    ED_TQUEUE *pq)        // the queue
+{
+    ED_TMSG *pm;          // the entry to fill
+
+    (void) pthread_mutex_lock(&(pq->lock));
+    __atomic_store_n(&(pq->waiting), 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    while ((pm = q_next(pq)) == 0)
+        (void) pthread_cond_wait(&(pq->room), &(pq->lock));
+    __atomic_store_n(&(pq->waiting), 0, __ATOMIC_RELAXED);
+    (void) pthread_mutex_unlock(&(pq->lock));
+    return(pm);
+}
+
+
+/***************************************************************************
+ * q_add(): - Give the entry from q_next() to the consumer and wake it.
+ ***************************************************************************/
+static void q_add(
+    ED_TQUEUE *pq)        // the queue
+{
+    __atomic_store_n(&(pq->head), pq->head + 1, __ATOMIC_RELEASE);
+    if (write(pq->wfd, "", 1) < 0) {
+        // The pipe is full so the consumer is already awake
+    }
+    return;
+}
+
+
+/***************************************************************************
+ * q_peek(): - Return the oldest message in a queue, or 0 if it is empty.
+ * The message stays in place until q_take().
+ ***************************************************************************/
+static ED_TMSG *q_peek(
+    ED_TQUEUE *pq)        // the queue
+{
+    if (__atomic_load_n(&(pq->head), __ATOMIC_ACQUIRE) == pq->tail)
+        return((ED_TMSG *) 0);
+    return(&(pq->ent[pq->tail % THR_NMSG]));
+}
+
+
+/***************************************************************************
+ * q_take(): - Give the oldest message back to the producer and wake
+ * the producer if it is waiting for room.
+ ***************************************************************************/
+static void q_take(
+    ED_TQUEUE *pq)        // the queue
+{
+    __atomic_store_n(&(pq->tail), pq->tail + 1, __ATOMIC_RELEASE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&(pq->waiting), __ATOMIC_RELAXED)) {
+        (void) pthread_mutex_lock(&(pq->lock));
+        (void) pthread_cond_signal(&(pq->room));
+        (void) pthread_mutex_unlock(&(pq->lock));
+    }
+    return;
+}
+
+// end of thread.c
@@ -20,11 +20,14 @@
  */
 
 
+#define _GNU_SOURCE    /* for struct ucred */
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/socket.h>
+#include <sys/un.h>    /* for Unix socket addresses */
 #include <syslog.h>    /* for log levels */
 #include <netinet/in.h>
+#include <netinet/tcp.h> /* for TCP_NODELAY */
 #include <errno.h>
 #include <string.h>
 #include <ctype.h>
@@ -42,6 +45,16 @@
  ***************************************************************************/
 int      nui = 0;              // number of open UI connections
 int      srvfd;                // FD to the listening socket
+int      unixfd = -1;          // FD to the listening Unix socket
+unsigned int waitorder = 0;    // order of the most recently queued read
+int      parsecn = -1;         // UI whose command is being executed
+static ED_WAIT *outwait = 0;   // deferred request whose reply is being sent
+static unsigned int reqseq = 0; // ID of the most recent get or set
+static void *rltimer = 0;      // timer to resume throttled UIs
+static void *sobase[MX_PLUGIN]; // load address of the .so in each slot
+static __thread SLOT *initing = 0; // slot whose Initialize() is running
+static int Telling = 0;        // set if a resource may be due EDSUB or EDUNSUB
+static ED_UNLOAD Unloads[MX_PLUGIN]; // unloads waiting for a plug-in thread to stop
 char     prmpchar[] = { PROMPT, 0 };
 
 
@@ -51,27 +64,117 @@ char     prmpchar[] = { PROMPT, 0 };
 void            open_ui_port();
 int             add_so(char *);
 void            initslot(SLOT *);  // Load and init this slot
-static void     open_ui_conn(int srvfd, int cb_data);
+static void     do_unload(UI *, char *, int);
+void            unload_slot(int);
+static void     fail_waits(int);
+int             so_owner(void (*)());
+void            open_ui_conn(int srvfd, int cb_data);
 static void     close_ui_conn(int cn);
-static void     receive_ui(int, int);
+static void     receive_ui(int, int, int);
+static void     parse_lines(int);
+static int      ui_throttle(UI *);
+static void     hold_ui(UI *, int);
+static int      is_bulk(char *);
+static void     resume_ui(void *, void *);
+static void     check_idle(void *, void *);
+void            mkframe(unsigned char *, int, int, int, int, int, unsigned int, long long, int);
+void            send_iov(int, unsigned char *, int, char *, int, int);
+void            bcst_sample(ED_SAMPLE *, int *);
+static void     send_bcst(int, int, unsigned int, long long, char *, int, int, int);
+void            do_replay(UI *, int, unsigned int);
+void            do_cat(UI *, int, int, char *);
+void            watch_rsc(RSC *, int);
+void            unwatch_rsc(int);
+static void     note_subs(int);
+static void     tell_subs();
+static void     send_gap(UI *, int, unsigned int, unsigned int);
+static int      grow_obuf(UI *, int);
+static void     flush_ui(int);
+void            do_get(UI *, int, int, char *);
+static void     do_set(UI *, int, int, char *);
+void            ed_complete(int, RSC *, char *, int);
+void            ed_fail(int, RSC *);
+static void     check_rsp(void *, void *);
+int             add_wait(int, int, int, int, int, int, char *);
+int             mkreq(int);
+static int      curtag(UI *, ED_WAIT **);
+static ED_WAIT *find_wait(int, RSC *);
+void            defer_wait(int, RSC *, int);
+static void     do_mget(UI *, int, char *);
+static int      mget_one(UI *, int, int, char *, int);
+static int      find_handle(char *, int *);
+int             find_slot(char *);
+static void     open_ui_unix();
+int             find_name(int, char *);
+void            index_names();
+int             service_ui();
+extern long long now_us();
+extern void     mod_fd(int, int);
+extern int      core_bcst(int, ED_SAMPLE *, int);
+extern int      bus_bcst(int, ED_SAMPLE *);
+extern int      bus_listens(int);
+extern int      core_listens(int);
+extern int      cache_get(RSC *, char **);
+extern void     do_hist(UI *, int, int, char *);
+extern void     rscfree(ED_RSC *);
+extern ED_RSC  *rscpriv(RSC *);
+extern void     del_owned(int);
+extern void     unsub_slot(int, int);
+extern void     ed_cache(RSC *, char *, int);
+extern void     smp_init(ED_SAMPLE *, const ED_VALUE *, int, char *, int);
+extern char    *smp_text(ED_SAMPLE *, int *);
+extern char    *smp_bin(ED_SAMPLE *, int *);
+extern char    *smp_json(ED_SAMPLE *, int *);
+extern int      smp_ptype(ED_SAMPLE *);
+extern unsigned int core_seq(int);
+extern ED_RSC  *replay_on(RSC *);
+extern void     open_http_port();
+extern void     http_line(UI *, char *, int);
+extern void     http_reply(UI *, char *, int);
+extern int      http_event(char *, int, unsigned int, char *, int);
+extern int      thr_parse(int, char *);
+extern int      thr_init(SLOT *);
+extern void     thr_start(SLOT *, int);
+extern int      thr_stop(int);
+extern int      thr_route(int, int, void *, char *, int);
+extern void     start_lock();
+extern void     start_unlock();
+extern void     start_deps(SLOT *, void *);
+extern void     start_time(SLOT *, long long);
+extern void     start_done(SLOT *);
+extern int      start_ready(int);
 extern SLOT     Slots[];       // table of plug-in info
 extern UI       UiCons[MX_UI]; // table of UI connections
+extern ED_WAIT  Waits[MX_WAIT]; // reads waiting on busy resources
+extern ED_NAME *Names;           // index of plug-in and resource names
+extern int      NNames;          // entries in Names (2^n)
+extern char    *UiPath;         // path of Unix socket for UI, if any
+extern int      UiReusePort;    // set SO_REUSEPORT on the TCP port
 extern int      Verbosity;     // verbosity level
 extern int      UiaddrAny;     // Use any IP address if set
 extern int      UiPort;        // TCP port for ui connections
+extern int      HttpPort;      // TCP port for HTTP clients, if any
+extern int      UiRate;        // commands per second per UI, 0 for no limit
+extern int      UiBurst;       // commands a UI may send at once
+extern int      UiIdle;        // seconds before an idle UI is closed
+extern int      RspTimeout;    // ms to finish a pending get or set
+extern int      Overload;      // overload level, 0 if the loop is keeping up
+extern unsigned int OvlRefused; // UI connections refused while overloaded
+extern int      httpfd;        // FD to the listening HTTP socket
 
 
 /***************************************************************************
  * parse_and_execute(): - This routine parses the null terminated
- * command line found in cmd[] character array in the passed UI pointer.
+ * command line from the passed UI.  The line is parsed in place in the
+ * UI's cmd[] buffer.
  * Result are passed to UI fd.  A write error can cause the closure
  * of the UI fd and the freeing of the UI structure.
  *
- * Input:        Pointer to UI structure with new command.
+ * Input:        Pointer to UI structure and its new command.
  * Output:       void
  * Effects:      the internal state of the plug-in specified
  ***************************************************************************/
-void parse_and_execute(UI *pui)
+void parse_and_execute(UI *pui, char *line)
 {
     char    *ccmd;       // command to be executed as a string
     int      icmd;       // command to be executed as an int
@@ -81,32 +184,47 @@ void parse_and_execute(UI *pui)
     int      irsc;       // target resource as an integer
     char    *val;        // value to be written if a write cmd
     char    *saveptr;    // lets us use a thread-safe strtok
-    int      err;        // return code
     int      len;        // a string length
     int      bkey;       // broadcast key = slot/rsc
+    int      tag;        // request ID from an optional #<id> prefix
+    unsigned int since;  // last broadcast seen, for edcat --since
     RSC     *prsc;       // a plug-in's resource table or a single rsc
-    char     rply[MXRPLY]; // reply back to the UI on error
-    int      i;          // generic loop counter
+    char     rply[MXCMD + MXRPLY]; // reply to the UI, room to echo any token
 
 
-    if ((pui->cmd == 0) || (pui->cmd[0] == 0) || (pui->cmdindx >= MXCMD) ||
-        (pui->cmd[0] == '\n') || (pui->cmd[0] == '\r')) {
+    // No slot or resource is associated with the command yet
+    pui->cslot = ED_NOID;
+    pui->crsc  = ED_NOID;
+
+    if ((line == 0) || (line[0] == 0) || (line[0] == '\r')) {
         return;   // nothing to do or an error
     }
 
     // Show/log commands if really verbose
     if (Verbosity >= ED_VERB_WARN) {
-        for (i = 0; i < pui->cmdindx; i++) {   // replace \n\r with null
-            if ((pui->cmd[i] == '\n') || (pui->cmd[i] == '\r')) {
-                pui->cmd[i] = (char) 0;
-                break;
-            }
-        }
-        edlog("COMMAND : %s", pui->cmd);
+        line[strcspn(line, "\r")] = (char) 0;   // a \r ends the command
+        edlog("COMMAND : %s", line);
     }
 
     /* Tokenize the input line */
-    ccmd  = strtok_r(pui->cmd, " \t\n\r", &saveptr);
+    ccmd  = strtok_r(line, " \t\n\r", &saveptr);
+
+    // An optional request ID, #<id>, may come before the command.  The
+    // reply to the command starts with the same #<id>.
+    if ((ccmd != 0) && (ccmd[0] == '#')) {
+        if ((sscanf(&ccmd[1], "%d", &tag) != 1) || (tag <= 0) || (tag > MX_TAG)) {
+            len = snprintf(rply, sizeof(rply), E_BDTAG, ccmd);
+            send_ui(rply, len, pui->cn);
+            prompt(pui->cn);
+            return;
+        }
+        pui->tag = tag;
+        ccmd = strtok_r(NULL, " \t\n\r", &saveptr);
+    }
+    if (ccmd == 0) {
+        prompt(pui->cn);   // blank line after request ID
+        return;
+    }
 
     // Get the command. 
     if (!strcmp(ccmd, CPREFIX "set"))
@@ -119,12 +237,29 @@ void parse_and_execute(UI *pui)
         icmd = EDLIST;
     else if (!strcmp(ccmd, CPREFIX "loadso"))
         icmd = EDLOAD;
+    else if (!strcmp(ccmd, CPREFIX "proto"))
+        icmd = EDPROTO;
+    else if (!strcmp(ccmd, CPREFIX "resolve"))
+        icmd = EDRESOLVE;
+    else if (!strcmp(ccmd, CPREFIX "mget"))
+        icmd = EDMGET;
+    else if (!strcmp(ccmd, CPREFIX "dump"))
+        icmd = EDDUMP;
+    else if (!strcmp(ccmd, CPREFIX "hist"))
+        icmd = EDHIST;
+    else if (!strcmp(ccmd, CPREFIX "unloadso"))
+        icmd = EDUNLOAD;
+    else if (!strcmp(ccmd, CPREFIX "reloadso"))
+        icmd = EDRELOAD;
     else {
         // Report bogus command
-        len = snprintf(rply, MXRPLY, E_BDCMD, ccmd);
+        pui->stats.ncmd[0]++;
+        len = snprintf(rply, sizeof(rply), E_BDCMD, ccmd);
         send_ui(rply, len, pui->cn); 
+        prompt(pui->cn);
         return;
     }
+    pui->stats.ncmd[(icmd < UI_NCMD) ? icmd : 0]++;
 
     /* Do list command */
     if (icmd == EDLIST) {
@@ -133,19 +268,19 @@ void parse_and_execute(UI *pui)
         // Give description of plug-in if one was specified
         if (cslot == 0) {
             // edlist without argument -- list all plug-in
-            len = snprintf(rply, MXRPLY, "  Slot/Name         Description\n");
+            len = snprintf(rply, sizeof(rply), "  Slot/Name         Description\n");
             send_ui(rply, len, pui->cn);
             for (islot = 0; islot < MX_PLUGIN; islot++) {
                 if ((Slots[islot].name != 0) &&
                     (Slots[islot].desc != 0)) {
-                    len = snprintf(rply, MXRPLY, LISTFORMAT, islot,
+                    len = snprintf(rply, sizeof(rply), LISTFORMAT, islot,
                         Slots[islot].name, Slots[islot].desc);
                     send_ui(rply, len, pui->cn);
                     // sent the board and description. Now send the resources
-                    for (irsc = 0; irsc < MX_RSC; irsc++) {
-                       prsc = &(Slots[islot].rsc[irsc]);
+                    for (irsc = 0; irsc < Slots[islot].nrsc; irsc++) {
+                       prsc = RSCPTR(&(Slots[islot]), irsc);
                        if (prsc->name != 0) {
-                           len = snprintf(rply, MXRPLY, LISTRSCFMT, prsc->name,
+                           len = snprintf(rply, sizeof(rply), LISTRSCFMT, prsc->name,
                                ((prsc->flags & IS_READABLE) ? CPREFIX "get " : ""),
                                ((prsc->flags & IS_WRITABLE) ? CPREFIX "set " : ""),
                                ((prsc->flags & CAN_BROADCAST) ? CPREFIX "cat " : ""));
@@ -158,18 +293,14 @@ void parse_and_execute(UI *pui)
             return;
         }
         // Second argument to edlist is a plug-in name.  Find it.
-        for (islot = 0; islot < MX_PLUGIN; islot++) {
-            if ((Slots[islot].name != 0) &&
-                (!strcmp(Slots[islot].name, cslot)))
-                break;  //got it
-        }
-        if ((islot != MX_PLUGIN) && (Slots[islot].help != 0)) {
+        islot = find_name(-1, cslot);
+        if ((islot >= 0) && (Slots[islot].help != 0)) {
             len = strlen(Slots[islot].help);
             send_ui(Slots[islot].help, len, pui->cn); 
             prompt(pui->cn);
             return;
         }
-        len = snprintf(rply, MXRPLY, "Plug-in '%s' is not the the system\n", cslot);
+        len = snprintf(rply, sizeof(rply), "Plug-in '%s' is not the the system\n", cslot);
         send_ui(rply, len, pui->cn); 
         prompt(pui->cn);
         return;
@@ -180,7 +311,7 @@ void parse_and_execute(UI *pui)
         cslot  = strtok_r(NULL, " \t\r\n", &saveptr);  // get plug-in file name
         if (cslot == 0) {
             // edloadso without argument -- this is an error
-            len = snprintf(rply, MXRPLY, M_BADSLOT, "(null)");
+            len = snprintf(rply, sizeof(rply), M_BADSLOT, "(null)");
             send_ui(rply, len, pui->cn); 
             prompt(pui->cn);
             return;
@@ -194,104 +325,151 @@ void parse_and_execute(UI *pui)
         return;
     }
 
-    // Parse rest of line.
-    cslot = strtok_r(NULL, " \t\r\n", &saveptr);
-    crsc  = strtok_r(NULL, " \t\r\n", &saveptr);
-    val   = strtok_r(NULL, "\r\n", &saveptr);
+    /* Do unloadso and reloadso commands */
+    if ((icmd == EDUNLOAD) || (icmd == EDRELOAD)) {
+        cslot  = strtok_r(NULL, " \t\r\n", &saveptr);  // slot or plug-in name
+        do_unload(pui, cslot, (icmd == EDRELOAD));
+        return;
+    }
 
-    /* get and validate slot or plug-in name */
-    if ((cslot == NULL) || (strlen(cslot) == 0)) {
-        // Report bogus board ID
-        len = snprintf(rply, MXRPLY, E_NOPERI, "(null)");
-        send_ui(rply, len, pui->cn); 
+    /* Do proto command */
+    if (icmd == EDPROTO) {
+        cslot  = strtok_r(NULL, " \t\r\n", &saveptr);  // get encoding name
+        if (cslot == 0) {
+            // edproto without argument -- report the current encoding
+            len = snprintf(rply, sizeof(rply), "%s\n",
+                  (pui->proto == ED_PROTO_BINARY) ? "binary" : "ascii");
+            send_ui(rply, len, pui->cn);
+        }
+        else if (!strcmp(cslot, "ascii")) {
+            pui->proto = ED_PROTO_ASCII;
+        }
+        else if (!strcmp(cslot, "binary")) {
+            pui->proto = ED_PROTO_BINARY;
+            pui->txseq = 0;
+        }
+        else {
+            len = snprintf(rply, sizeof(rply), E_BDPROTO, cslot);
+            send_ui(rply, len, pui->cn);
+        }
+        // The prompt goes out in the newly selected encoding
         prompt(pui->cn);
         return;
     }
-    /* if the first character of slot is numeric, get slot ID */
-    if (isdigit(cslot[0])) {
-        err = sscanf(cslot, "%d", &islot);
-        if ((err != 1) || (islot < 0) || (islot >= MX_PLUGIN)) {
-            // Report bogus slotid ID
-            len = snprintf(rply, MXRPLY, E_BDSLOT, cslot);
-            send_ui(rply, len, pui->cn); 
+
+    /* Do resolve command */
+    if (icmd == EDRESOLVE) {
+        cslot = strtok_r(NULL, " \t\r\n", &saveptr);
+        crsc  = strtok_r(NULL, " \t\r\n", &saveptr);
+        islot = (cslot == 0) ? -1 : find_slot(cslot);
+        if (islot < 0) {
+            len = snprintf(rply, sizeof(rply), E_NOPERI, (cslot == 0) ? "(null)" : cslot);
+            send_ui(rply, len, pui->cn);
+        }
+        else if (crsc == 0) {
+            // No resource given.  Give the handle of every resource in the slot
+            for (irsc = 0; irsc < Slots[islot].nrsc; irsc++) {
+                if (RSCPTR(&(Slots[islot]), irsc)->name == 0)
+                    continue;
+                len = snprintf(rply, sizeof(rply), "%s %d\n", RSCPTR(&(Slots[islot]), irsc)->name,
+                               MKHANDLE(islot, irsc));
+                send_ui(rply, len, pui->cn);
+            }
+        }
+        else if ((irsc = find_name(islot, crsc)) < 0) {
+            len = snprintf(rply, sizeof(rply), E_NORSC, crsc, Slots[islot].name);
+            send_ui(rply, len, pui->cn);
+        }
+        else {
+            len = snprintf(rply, sizeof(rply), "%d\n", MKHANDLE(islot, irsc));
+            send_ui(rply, len, pui->cn);
+        }
+        prompt(pui->cn);
+        return;
+    }
+
+    /* Do multi-get and dump commands */
+    if ((icmd == EDMGET) || (icmd == EDDUMP)) {
+        do_mget(pui, icmd, saveptr);
+        return;
+    }
+
+    // Parse rest of line.  A handle from edresolve, @<handle>, takes the
+    // place of both the slot and the resource name.
+    cslot = strtok_r(NULL, " \t\r\n", &saveptr);
+    if ((cslot != NULL) && (cslot[0] == '@')) {
+        val = strtok_r(NULL, "\r\n", &saveptr);
+        islot = find_handle(cslot, &irsc);
+        if (islot < 0) {
+            // Report bogus handle
+            len = snprintf(rply, sizeof(rply), E_BDHNDL, cslot);
+            send_ui(rply, len, pui->cn);
             prompt(pui->cn);
             return;
         }
+        crsc  = RSCPTR(&(Slots[islot]), irsc)->name;
     }
-    else {     /* not a digit, search for peri by name */
-        len = strlen(cslot);
-        for (islot = 0; islot < MX_PLUGIN; islot++) {
-            if (Slots[islot].name == NULL)   // skip over empty slots
-                continue;
-            if (!strncmp(Slots[islot].name, cslot, len))
-                break;  //got it
+    else {
+        crsc  = strtok_r(NULL, " \t\r\n", &saveptr);
+        val   = strtok_r(NULL, "\r\n", &saveptr);
+
+        /* get and validate slot or plug-in name */
+        if ((cslot == NULL) || (strlen(cslot) == 0)) {
+            // Report bogus board ID
+            len = snprintf(rply, sizeof(rply), E_NOPERI, "(null)");
+            send_ui(rply, len, pui->cn); 
+            prompt(pui->cn);
+            return;
         }
-        if (islot == MX_PLUGIN) {
-            // Report no slot called cslot in board
-            len = snprintf(rply, MXRPLY, E_NOPERI, cslot);
+        islot = find_slot(cslot);
+        if (islot < 0) {
+            // Report bogus slot ID or no plug-in called cslot
+            len = snprintf(rply, sizeof(rply), (isdigit(cslot[0]) ? E_BDSLOT : E_NOPERI), cslot);
             send_ui(rply, len, pui->cn); 
             prompt(pui->cn);
             return;
         }
-    }
 
-    /* Got the slot ID.  Now validate and get the resource index */
-    if ((crsc == NULL) || (strlen(crsc) == 0)) {
-        // report an empty/invalid resource was specified
-        len = snprintf(rply, MXRPLY, E_NORSC, "(null)", Slots[islot].name);
-        send_ui(rply, len, pui->cn); 
-        prompt(pui->cn);
-        return;
-    }
-    prsc = Slots[islot].rsc;
-    for (irsc = 0; irsc < MX_RSC; irsc++) {
-        if ((prsc[irsc].name != 0) && (!strcmp(crsc, prsc[irsc].name)))
-            break;  //got it
-    }
-    if (irsc == MX_RSC) {
-        // report no resource rsc in board/slot
-        len = snprintf(rply, MXRPLY, E_NORSC, crsc, Slots[islot].name);
-        send_ui(rply, len, pui->cn); 
-        prompt(pui->cn);
-        return;
+        /* Got the slot ID.  Now validate and get the resource index */
+        if ((crsc == NULL) || (strlen(crsc) == 0)) {
+            // report an empty/invalid resource was specified
+            len = snprintf(rply, sizeof(rply), E_NORSC, "(null)", Slots[islot].name);
+            send_ui(rply, len, pui->cn); 
+            prompt(pui->cn);
+            return;
+        }
+        irsc = find_name(islot, crsc);
+        if (irsc < 0) {
+            // report no resource rsc in board/slot
+            len = snprintf(rply, sizeof(rply), E_NORSC, crsc, Slots[islot].name);
+            send_ui(rply, len, pui->cn); 
+            prompt(pui->cn);
+            return;
+        }
     }
     /* get pointer to resource */
-    prsc = &(prsc[irsc]);   // get pointer to a single resource
+    prsc = RSCPTR(&(Slots[islot]), irsc);   // get pointer to a single resource
+    pui->cslot = islot;     // binary replies are tagged with slot/rsc
+    pui->crsc  = irsc;
 
     /* Got valid command, board, slot, and resource */
     /* Do per command error checking and processing */
     if (icmd == EDGET) {
         if ((prsc->flags & IS_READABLE) == 0) {
             // report that rsc is not readable
-            len = snprintf(rply, MXRPLY, E_NREAD, crsc);
+            len = snprintf(rply, sizeof(rply), E_NREAD, crsc);
             send_ui(rply, len, pui->cn); 
             prompt(pui->cn);
             return;
         }
-        if (prsc->uilock >= 0) {
-            // report that another ui is already reading the rsc
-            len = snprintf(rply, MXRPLY, E_BUSY, cslot);
-            send_ui(rply, len, pui->cn); 
-            prompt(pui->cn);
-            return;
-        }
-        // All set.  Call the read routine.
-        if (prsc->pgscb) {
-            len = MXRPLY;
-            (prsc->pgscb)(icmd, irsc, val, &(Slots[islot]), pui->cn, &len, rply);
-            // Send response or error messages back to the user
-            if ((len > 0) && (len < MXRPLY)) {
-                send_ui(rply, len, pui->cn);
-                prompt(pui->cn);
-            }
-        }
-        // Done.  The plug-in will send the response back to the UI */
+        // All set.  Call the read routine or wait for the resource.
+        do_get(pui, islot, irsc, val);
         return;
     }
     else if (icmd == EDSET) {
         if ((prsc->flags & IS_WRITABLE) == 0) {
             // report that rsc is not writable
-            len = snprintf(rply, MXRPLY, E_NWRITE, crsc);
+            len = snprintf(rply, sizeof(rply), E_NWRITE, crsc);
             send_ui(rply, len, pui->cn); 
             prompt(pui->cn);
             return;
@@ -299,21 +477,13 @@ void parse_and_execute(UI *pui)
         /* Got board, slot, resource name or slot.  It's a set so now validate 'val' */
         if ((val == NULL) || (strlen(val) == 0)) {
             // report an empty/invalid value was specified
-            len = snprintf(rply, MXRPLY, E_BDVAL, Slots[islot].rsc[irsc].name);
+            len = snprintf(rply, sizeof(rply), E_BDVAL, RSCPTR(&(Slots[islot]), irsc)->name);
             send_ui(rply, len, pui->cn); 
             prompt(pui->cn);
             return;
         }
         // All set.  Call the write routine.
-        if (prsc->pgscb) {
-            len = MXRPLY;
-            (prsc->pgscb)(icmd, irsc, val, &(Slots[islot]), pui->cn, &len, rply);
-            // Send any error messages back to user
-            if ((len > 0) && (len < MXRPLY)) {
-                send_ui(rply, len, pui->cn);
-            }
-            prompt(pui->cn);
-        }
+        do_set(pui, islot, irsc, val);
         return;
     }
     else if (icmd == EDCAT) {
@@ -325,21 +495,170 @@ void parse_and_execute(UI *pui)
         // First a sanity check
         if ((prsc->flags & CAN_BROADCAST) == 0) {
             // report that rsc is not a broadcast sensor
-            len = snprintf(rply, MXRPLY, E_NREAD, crsc);
+            len = snprintf(rply, sizeof(rply), E_NREAD, crsc);
             send_ui(rply, len, pui->cn);
             prompt(pui->cn);
             return;
         }
-        // Record that this UI is monitoring and tell the resource
-        bkey  = (islot & 0xff) << 16;   // bkey is slot/rsc
-        bkey += (irsc  & 0xff);         // bkey is slot/rsc
-        pui->bkey = bkey;       // mark UI in monitor mode
-        prsc->bkey = bkey;      // tell resource that at least one UI is monitoring
-        // Tell the resource that someone is listening.  This allows the resource
-        // to configure itself or enable auto-updates from the plug-in.
-        if (prsc->pgscb) {
+        // edcat --since <seq> first replays what the UI missed
+        bkey  = MKHANDLE(islot, irsc);  // bkey is slot/rsc
+        if ((val != 0) && (strncmp(val, "--since", 7) == 0)) {
+            if (sscanf(val, "--since %u", &since) != 1) {
+                len = snprintf(rply, sizeof(rply), E_BDVAL, crsc);
+                send_ui(rply, len, pui->cn);
+                prompt(pui->cn);
+                return;
+            }
+            pui->catseq = 1;
+            do_replay(pui, bkey, since);
+        }
+        do_cat(pui, islot, irsc, val);
+    }
+    else if (icmd == EDHIST) {
+        // The history is kept by the daemon.  The plug-in is not asked.
+        do_hist(pui, islot, irsc, val);
+    }
+    return;
+}
+
+
+/***************************************************************************
+ * do_cat(): - Start sending the broadcasts of a resource to a UI.
+ ***************************************************************************/
+void do_cat(
+    UI      *pui,         // UI that subscribed
+    int      islot,       // slot of the resource
+    int      irsc,        // resource index in the slot
+    char    *val)         // the rest of the edcat command, if any
+{
+    RSC     *prsc;        // the resource
+    char     rply[MXRPLY]; // replies from the plug-in are ignored
+    int      obkey;       // resource the UI watched before, if any
+    int      len;
+
+    // Record that this UI is monitoring and tell the resource
+    prsc = RSCPTR(&(Slots[islot]), irsc);
+    obkey = pui->bkey;
+    pui->bkey = MKHANDLE(islot, irsc);  // mark UI in monitor mode
+    watch_rsc(prsc, pui->bkey); // tell resource that at least one UI is monitoring
+    // Tell the resource that someone is listening.  This allows the resource
+    // to configure itself or enable auto-updates from the plug-in.
+    if (prsc->pgscb) {
+        len = MXRPLY;
+        (prsc->pgscb)(EDCAT, irsc, val, &(Slots[islot]), pui->cn, &len, rply);
+    }
+    // The resource the UI watched before may have no listeners now
+    if ((obkey != 0) && (obkey != pui->bkey))
+        unwatch_rsc(obkey);
+    return;
+}
+
+
+/***************************************************************************
+ * watch_rsc(): - Give a broadcast resource a listener.  A UI running
+ * edcat, a subscribed plug-in, and a ring, multicast group, history, or
+ * replay buffer of the daemon are all listeners.
+ ***************************************************************************/
+void watch_rsc(
+    RSC     *prsc,        // the resource
+    int      bkey)        // its slot/rsc
+{
+    if (prsc->bkey == 0)
+        note_subs(bkey);
+    prsc->bkey = bkey;
+    return;
+}
+
+
+/***************************************************************************
+ * unwatch_rsc(): - A listener of a broadcast resource went away.  Clear
+ * the resource's bkey now if it has no other listeners, rather than at
+ * its next broadcast, so a plug-in with WANT_SUBS hears of it while it
+ * is still sampling.
+ ***************************************************************************/
+void unwatch_rsc(
+    int      bkey)        // slot/rsc of the resource
+{
+    RSC     *prsc;        // the resource
+    int      cn;
+
+    if ((HANDLE2SLOT(bkey) >= MX_PLUGIN) ||
+        (HANDLE2RSC(bkey) >= Slots[HANDLE2SLOT(bkey)].nrsc))
+        return;
+    prsc = RSCPTR(&(Slots[HANDLE2SLOT(bkey)]), HANDLE2RSC(bkey));
+    if (prsc->bkey != bkey)
+        return;
+    for (cn = 0; cn < MX_UI; cn++) {
+        if ((UiCons[cn].fd >= 0) && (UiCons[cn].bkey == bkey))
+            return;
+    }
+    if (bus_listens(bkey) || core_listens(bkey))
+        return;
+    prsc->bkey = 0;
+    note_subs(bkey);
+    return;
+}
+
+
+/***************************************************************************
+ * note_subs(): - Note that a resource with WANT_SUBS may have gained its
+ * first listener or lost its last.  The plug-in is told at the top of
+ * the next pass of the loop, never from inside a call it made into the
+ * daemon such as the ed_publish() that found no one listening.
+ ***************************************************************************/
+static void note_subs(
+    int      bkey)        // slot/rsc of the resource
+{
+    RSC     *prsc;        // the resource
+    ED_RSC  *ped;         // daemon state of the resource
+
+    if ((HANDLE2SLOT(bkey) >= MX_PLUGIN) ||
+        (HANDLE2RSC(bkey) >= Slots[HANDLE2SLOT(bkey)].nrsc))
+        return;
+    prsc = RSCPTR(&(Slots[HANDLE2SLOT(bkey)]), HANDLE2RSC(bkey));
+    if (((prsc->flags & WANT_SUBS) == 0) || (prsc->pgscb == 0))
+        return;
+    ped = rscpriv(prsc);
+    if (ped == 0)
+        return;
+    ped->tell = 1;
+    Telling = 1;
+    return;
+}
+
+
+/***************************************************************************
+ * tell_subs(): - Give EDSUB to each resource noted by note_subs() that
+ * has listeners and was not told so, and EDUNSUB to each that has none
+ * and was.  A resource that gained and lost a listener in one pass of
+ * the loop is not told at all.
+ ***************************************************************************/
+static void tell_subs()
+{
+    SLOT    *pslot;       // a plug-in
+    RSC     *prsc;        // one of its resources
+    ED_RSC  *ped;         // daemon state of the resource
+    char     rply[MXRPLY]; // replies from the plug-in are ignored
+    int      listen;      // set if the resource has listeners
+    int      len;
+    int      i, j;
+
+    Telling = 0;
+    for (i = 0, pslot = Slots; i < MX_PLUGIN; i++, pslot++) {
+        for (j = 0; j < pslot->nrsc; j++) {
+            prsc = RSCPTR(pslot, j);
+            ped = (ED_RSC *) prsc->dpriv;
+            if ((ped == 0) || (ped->tell == 0))
+                continue;
+            ped->tell = 0;
+            listen = (prsc->bkey != 0);
+            if ((listen == ped->told) || ((prsc->flags & WANT_SUBS) == 0) ||
+                (prsc->pgscb == 0))
+                continue;
+            ped->told = listen;
             len = MXRPLY;
-            (prsc->pgscb)(icmd, irsc, val, &(Slots[islot]), pui->cn, &len, rply);
+            (prsc->pgscb)((listen ? EDSUB : EDUNSUB), j, (char *) 0, pslot,
+                    UI_BATCH, &len, rply);
         }
     }
     return;
@@ -349,55 +668,222 @@ void parse_and_execute(UI *pui)
 /***************************************************************************
  * bcst_ui(): - Broadcast the buffer down all UI connections that
  * have a matching monitor key.  Clear the key if there are no UIs
- * monitoring this resource any more.  Close UI sessions that fail
- * the write.
+ * monitoring this resource any more.  The data is queued and sent at
+ * the end of the pass of the select loop.  A UI that is not keeping
+ * up loses the broadcast instead of slowing down the daemon.
  ***************************************************************************/
 void bcst_ui(
     char    *buf,         // buffer of chars to send
     int      len,         // number of chars to send
     int     *bkey)        // slot/rsc as an int
 {
-    UI      *pui;         // pointer to UI connection
-    int      cn;          // indes to above
-    int      nwr;         // number of bytes written
-    int      ret;         // write() return value
-    int      newbkey;     // to clear bkey if no listeners
+    ED_SAMPLE smp;        // the broadcast as a sample of text
 
     /* Sanity checks */
     if ((len <= 0) || (*bkey == 0)) {
         // Nothing to do
         return;
     }
+    // A plug-in thread has the daemon's loop send it
+    if (thr_route(THR_BCST, 0, (void *) bkey, buf, len) == 0)
+        return;
+    start_lock();
+    smp_init(&smp, (ED_VALUE *) 0, 0, buf, len);
+    bcst_sample(&smp, bkey);
+    start_unlock();
+    return;
+}
+
+
+/***************************************************************************
+ * bcst_sample(): - Send a sample from bcst_ui() or ed_publish() to the
+ * UIs watching the resource.  Each UI gets the sample in the encoding
+ * of its protocol and an encoding is only made if some UI wants it.
+ ***************************************************************************/
+void bcst_sample(
+    ED_SAMPLE *ps,        // the sample to send
+    int     *bkey)        // slot/rsc as an int
+{
+    UI      *pui;         // pointer to UI connection
+    int      cn;          // indes to above
+    int      key;         // slot/rsc, which a subscriber may clear in *bkey
+    int      newbkey;     // to clear bkey if no listeners
+    unsigned int seq;     // sequence number of this broadcast
+    long long ts = 0;     // time of broadcast, set on first binary UI
+    char    *buf;         // the sample in the UI's encoding
+    int      len;         // bytes in buf
+    int      ptype;       // binary payload type of buf
 
     // Walk all UI conns looking for matching bkey
+    key = *bkey;
     newbkey = 0;
+    seq = core_seq(key);
     for (cn = 0, pui = UiCons; cn < MX_UI; cn++, pui++) {
-        if ((pui->fd < 0) || (pui->bkey != *bkey))  {
+        if ((pui->fd < 0) || (pui->bkey != key))  {
             continue;
         }
 
         // Got an open ui conn that is catting this resource
-        newbkey = *bkey;
-        nwr = 0;
-        while (nwr != len) {
-            ret = write(pui->fd, buf, len);
-            if (ret <= 0) {
-                if (errno != EAGAIN)
-                    continue;
-                close_ui_conn(cn);
-                break;
-            }
-            nwr += ret;
+        newbkey = key;
+
+        // Low priority UIs get only some broadcasts when overloaded
+        if ((Overload >= OVL_DECIMATE) && (pui->prio == ED_PRIO_LOW) &&
+            ((seq % OVL_KEEP) != 0)) {
+            pui->stats.bdrops++;
+            continue;
+        }
+        ptype = ED_PT_TEXT;
+        if (pui->proto == ED_PROTO_BINARY) {
+            if (ts == 0)
+                ts = now_us();
+            buf = smp_bin(ps, &len);
+            ptype = smp_ptype(ps);
+        }
+        else if (pui->proto == ED_PROTO_HTTP) {
+            buf = smp_json(ps, &len);
+        }
+        else {
+            buf = smp_text(ps, &len);
         }
+        send_bcst(cn, key, seq, ts, buf, len, ptype, 1);
+    }
+
+    // Plug-ins may be listening by way of ed_subscribe()
+    if (bus_bcst(key, ps)) {
+        newbkey = key;
+    }
+
+    // The daemon may be a listener too, for example with a shared
+    // memory ring or a replay buffer for the resource
+    if (core_bcst(key, ps, (newbkey != 0))) {
+        newbkey = key;
     }
 
     // Reset the resources bkey (ie clear it or re-set it)
+    if ((key != 0) && (newbkey == 0))
+        note_subs(key);
     *bkey = newbkey;
 
     return;
 }
 
 
+/***************************************************************************
+ * send_bcst(): - Queue one broadcast for a UI.  Binary UIs get a frame
+ * with the resource's sequence number.  ASCII UIs that subscribed with
+ * edcat --since get the sequence number and a space before the data.
+ * HTTP UIs get a server-sent event with the sequence number as its id.
+ ***************************************************************************/
+static void send_bcst(
+    int      cn,          // index to UI conn table
+    int      bkey,        // slot/rsc of the broadcast
+    unsigned int seq,     // sequence number of the broadcast
+    long long ts,         // time of the broadcast
+    char    *buf,         // the broadcast data
+    int      len,         // number of bytes in buf
+    int      ptype,       // ED_PT_TEXT or ED_PT_VALUES
+    int      isbcst)      // set if the data can be dropped
+{
+    unsigned char hdr[ED_FRHDRSZ]; // frame header or seq number
+    int      hlen = 0;    // bytes in hdr
+    char     sse[HTTP_MXEVENT]; // the broadcast as a server-sent event
+
+    if (UiCons[cn].proto == ED_PROTO_HTTP) {
+        len = http_event(sse, HTTP_MXEVENT, seq, buf, len);
+        send_iov(cn, (unsigned char *) 0, 0, sse, len, isbcst);
+        return;
+    }
+    if (UiCons[cn].proto == ED_PROTO_BINARY) {
+        mkframe(hdr, ED_FR_BCST, ptype, HANDLE2SLOT(bkey),
+                HANDLE2RSC(bkey), 0, seq, ts, len);
+        hlen = ED_FRHDRSZ;
+    }
+    else if (UiCons[cn].catseq) {
+        hlen = snprintf((char *) hdr, ED_FRHDRSZ, "%u ", seq);
+    }
+    send_iov(cn, hdr, hlen, buf, len, isbcst);
+    return;
+}
+
+
+/***************************************************************************
+ * do_replay(): - Send a UI the broadcasts it missed, those after
+ * sequence number 'since', before it joins the live stream.  Missed
+ * broadcasts that are no longer in the replay buffer are reported as
+ * a gap.  The first edcat --since of a resource turns on its replay
+ * buffer.  Broadcasts from before then were never kept and were not
+ * seen with a sequence number, so they are neither sent nor reported.
+ ***************************************************************************/
+void do_replay(
+    UI      *pui,         // UI that subscribed
+    int      bkey,        // slot/rsc of the resource
+    unsigned int since)   // last sequence number the UI has seen
+{
+    ED_RSC  *ped;         // daemon state of the resource
+    ED_RPLENT *pe;        // a kept broadcast
+    unsigned int first;   // oldest broadcast that may still be kept
+    unsigned int gap;     // first missed broadcast not yet sent or reported
+    unsigned int s;       // loop over sequence numbers
+
+    ped = replay_on(RSCPTR(&(Slots[HANDLE2SLOT(bkey)]), HANDLE2RSC(bkey)));
+    if ((ped != 0) && (since < ped->rplseq))
+        since = ped->rplseq;
+    if ((ped == 0) || (since >= ped->bseq)) {
+        return;           // nothing was missed
+    }
+
+    first = (ped->bseq > RPL_NENT) ? ped->bseq - RPL_NENT + 1 : 1;
+    first = (since + 1 > first) ? since + 1 : first;
+    gap = since + 1;
+    for (s = first; s <= ped->bseq; s++) {
+        pe = &(ped->replay[s % RPL_NENT]);
+        if (pe->seq != s)
+            continue;
+        if (gap < s)
+            send_gap(pui, bkey, gap, s - 1);
+        send_bcst(pui->cn, bkey, s, pe->ts, pe->data, pe->len, ED_PT_TEXT, 0);
+        gap = s + 1;
+    }
+    if (gap <= ped->bseq)
+        send_gap(pui, bkey, gap, ped->bseq);
+    return;
+}
+
+
+/***************************************************************************
+ * send_gap(): - Tell a UI that broadcasts first to last were lost.
+ * ASCII UIs get the line 'GAP <first> <last>'.  Binary UIs get an
+ * ED_FR_GAP frame with the text '<first> <last>'.  HTTP UIs get a
+ * 'gap' event.
+ ***************************************************************************/
+static void send_gap(
+    UI      *pui,         // UI to tell
+    int      bkey,        // slot/rsc of the resource
+    unsigned int first,   // first lost broadcast
+    unsigned int last)    // last lost broadcast
+{
+    unsigned char hdr[ED_FRHDRSZ]; // frame header
+    char     txt[MXRPLY]; // the gap as text
+    int      len;         // bytes in txt
+
+    if (pui->proto == ED_PROTO_BINARY) {
+        len = snprintf(txt, MXRPLY, "%u %u\n", first, last);
+        mkframe(hdr, ED_FR_GAP, ED_PT_TEXT, HANDLE2SLOT(bkey),
+                HANDLE2RSC(bkey), 0, first, now_us(), len);
+        send_iov(pui->cn, hdr, ED_FRHDRSZ, txt, len, 0);
+    }
+    else if (pui->proto == ED_PROTO_HTTP) {
+        len = snprintf(txt, MXRPLY, "event: gap\ndata: %u %u\n\n", first, last);
+        send_iov(pui->cn, (unsigned char *) 0, 0, txt, len, 0);
+    }
+    else {
+        len = snprintf(txt, MXRPLY, "GAP %u %u\n", first, last);
+        send_iov(pui->cn, (unsigned char *) 0, 0, txt, len, 0);
+    }
+    return;
+}
+
+
 /***************************************************************************
  * send_ui(): - This routine is called to send data to the other
  * end of a UI connection.  Close the connection on error.
@@ -408,12 +894,19 @@ void send_ui(
     int      len,         // number of chars to send
     int      cn)          // index to UI conn table
 {
-    int      nwr;         /* number of bytes written */
+    UI      *pui;         /* pointer to UI at cn */
+    unsigned char hdr[ED_FRHDRSZ]; /* frame header or request ID */
+    int      hlen = 0;    /* bytes in hdr */
+    int      tag;         /* request ID of the reply */
+    ED_WAIT *pw;          /* deferred request of the reply, if any */
 
     /* Sanity checks */
+    cn = (cn < 0) ? cn : ED_CN(cn);
     if ((len < 0) || (cn < 0) || (cn >= MX_UI) || (UiCons[cn].fd < 0)) {
         return;   // nothing to do or bogus request
     }
+    if (thr_route(THR_SENDUI, cn, (void *) 0, buf, len) == 0)
+        return;   // sent from the daemon's loop
     buf[len] = (char) 0;  // make it a null terminated string
 
     // Show/log commands if really verbose
@@ -421,16 +914,26 @@ void send_ui(
         edlog("RESPONSE: %s\n", buf);
     }
 
-    while (len) {
-        nwr = write(UiCons[cn].fd, buf, len);
-        if (nwr <= 0) {
-            if (errno != EAGAIN)
-                continue;
-            close_ui_conn(cn);
-            return;
-        }
-        len -= nwr;
+    // Binary UIs get the reply as the payload of a single frame
+    pui = &(UiCons[cn]);
+    if (pui->proto == ED_PROTO_HTTP) {
+        http_reply(pui, buf, len);
+        return;
     }
+    tag = curtag(pui, &pw);
+    if (pui->proto == ED_PROTO_BINARY) {
+        mkframe(hdr, ED_FR_REPLY, ED_PT_TEXT, ((pw) ? pw->slot : pui->cslot),
+                ((pw) ? pw->rsc : pui->crsc), tag, pui->txseq++, now_us(), len);
+        send_iov(cn, hdr, ED_FRHDRSZ, buf, len, 0);
+        return;
+    }
+
+    // The first output of a tagged command starts with its request ID
+    if ((tag != 0) && (pui->otag != tag)) {
+        hlen = snprintf((char *) hdr, ED_FRHDRSZ, "#%d ", tag);
+        pui->otag = tag;
+    }
+    send_iov(cn, hdr, hlen, buf, len, 0);
     return;
 }
 
@@ -444,87 +947,1094 @@ void send_ui(
 void prompt(
     int      cn)          // index to UI conn table
 {
-    int      nwr=0;       // number of bytes written
+    UI      *pui;         // pointer to UI at cn
+    unsigned char hdr[ED_FRHDRSZ]; // frame header or request ID
+    int      hlen = 0;    // bytes in hdr
+    int      tag;         // request ID of the completed command
+    ED_WAIT *pw;          // deferred request completed, if any
 
     /* Sanity checks */
+    cn = (cn < 0) ? cn : ED_CN(cn);
     if ((cn < 0) || (cn >= MX_UI) || (UiCons[cn].fd < 0)) {
         return;   // nothing to do or bogus request
     }
+    if (thr_route(THR_PROMPT, cn, (void *) 0, (char *) 0, 0) == 0)
+        return;   // sent from the daemon's loop
 
-    while (nwr != 1) {
-        nwr = write(UiCons[cn].fd, prmpchar, 1);
-        if (nwr <= 0) {
-            if (errno != EAGAIN)
-                continue;
-            close_ui_conn(cn);
-            return;
+    // Binary UIs get a prompt frame with no payload.  HTTP UIs are
+    // closed once the reply is written.
+    pui = &(UiCons[cn]);
+    tag = curtag(pui, &pw);
+    if (pui->proto == ED_PROTO_HTTP) {
+        pui->http.close = 1;
+    }
+    else if (pui->proto == ED_PROTO_BINARY) {
+        mkframe(hdr, ED_FR_PROMPT, ED_PT_NONE, ((pw) ? pw->slot : pui->cslot),
+                ((pw) ? pw->rsc : pui->crsc), tag, pui->txseq++, now_us(), 0);
+        send_iov(cn, hdr, ED_FRHDRSZ, (char *) 0, 0, 0);
+    }
+    else {
+        if ((tag != 0) && (pui->otag != tag)) {
+            hlen = snprintf((char *) hdr, ED_FRHDRSZ, "#%d ", tag);
         }
+        hdr[hlen++] = PROMPT;
+        send_iov(cn, hdr, hlen, (char *) 0, 0, 0);
+    }
+    pui->otag = 0;
+
+    // A prompt outside of the parser completes a deferred request of
+    // this UI.  Its request ID is no longer needed.  A read answered
+    // from a plug-in thread is done.
+    if (pw != 0) {
+        pw->tag = 0;
+        if (pw->active == WT_ROUTED)
+            pw->cn = -1;
     }
     return;
 }
 
 
 /***************************************************************************
- * receive_ui(): - This routine is called to read data
- * from a TCP connection.  We look for an end-of-line and pass
- * full lines to the CLI parser.  
- *
- * Input:        FD of socket with data to read
- * Output:       void
- * Effects:      the Baseboard vie the CLI parser
+ * do_get(): - Call the read routine of a resource for a UI.  If the
+ * plug-in is still answering an earlier read of the resource, the UI
+ * is queued and the read is issued again when the resource is free.
+ *   The daemon sets uilock to the UI while the read routine runs.  A
+ * plug-in that cannot answer at once sets *plen to ED_PENDING and
+ * later calls ed_complete() or ed_fail().  Older plug-ins leave *plen
+ * at zero and uilock set, send the reply with send_ui() and prompt()
+ * to the UI in uilock, and then set uilock to -1.
+ *   A resource with a cache is answered from it while the value is
+ * fresh, even if the plug-in is busy.  --fresh skips the cache.  A
+ * get with arguments may not read the value the cache holds, so it
+ * neither uses nor fills the cache.
  ***************************************************************************/
-void receive_ui(int fd_in, int cb_data)
+void do_get(
+    UI      *pui,         // UI requesting the value
+    int      islot,       // slot of the resource
+    int      irsc,        // resource index in the slot
+    char    *val)         // any text after the resource name
 {
-    int      nrd;            /* number of bytes read */
-    int      i;              /* a temp int */
-    int      gotline;        /* set true if we get a full line */
-    int      cn;             /* index into UiCons */
-    UI      *pui;            /* pointer to UI at cn */
-
-    /* Locate the UI struct with fd equal to fd_in */
-    for (cn = 0 ; cn < MX_UI; cn++) {
-        if (fd_in == UiCons[cn].fd) {
-            break;
-        }
+    RSC     *prsc;        // the resource to read
+    char     rply[MX_GETRPLY]; // reply back to the UI
+    char    *cval;        // the cached value
+    char    *oval;        // val as given, to queue the read with
+    int      req;         // cn and request ID for the plug-in
+    int      len;         // length of reply
+
+    prsc = RSCPTR(&(Slots[islot]), irsc);
+    oval = val;
+    while ((val != 0) && isspace((unsigned char) *val))
+        val++;
+    if ((val != 0) && (*val == (char) 0))
+        val = (char *) 0;
+    if ((val != 0) && (strncmp(val, "--fresh", 7) == 0) &&
+        ((val[7] == (char) 0) || isspace((unsigned char) val[7]))) {
+        val += 7;
+        while (isspace((unsigned char) *val))
+            val++;
+        if (*val == (char) 0)
+            val = (char *) 0;
     }
-    /* Error if we could not find the fd */
-    if (MX_UI == cn) {
-        /* Take this bogus fd out of the select loop */
-        del_fd(fd_in);
-        close(fd_in);
+    else if ((val == 0) && (prsc->dpriv != 0) && ((len = cache_get(prsc, &cval)) > 0)) {
+        send_ui(cval, len, pui->cn);
+        prompt(pui->cn);
         return;
     }
-    pui = &(UiCons[cn]);
-
-    /* We read data from the connection into the buffer in the ui struct. Once
-     * we've read all of the data we can, we scan for a newline character and
-     * pass any full lines to the parser. */
-    nrd = read(pui->fd, &(pui->cmd[pui->cmdindx]), (MXCMD - pui->cmdindx));
-
-    /* shutdown manager conn on error or on zero bytes read */
-    if ((nrd <= 0) && (errno != EAGAIN)) {
-        close_ui_conn(cn);
+    if (prsc->uilock >= 0) {
+        // Another read is in progress.  Wait for it to finish.
+        if (add_wait(pui->cn, islot, irsc, pui->tag, WT_QUEUED, 0, oval) < 0) {
+            len = snprintf(rply, MX_GETRPLY, E_BUSY, prsc->name);
+            send_ui(rply, len, pui->cn);
+            prompt(pui->cn);
+        }
+        return;
+    }
+    if (prsc->pgscb == 0) {
         return;
     }
 
-    pui->cmdindx += nrd;
-
-    /* The commands are in the buffer. Call the parser to execute them */
-    do {
-        gotline = 0;
-        // Scan for a newline.    If found, replace it with a null
-        for (i = 0; i < pui->cmdindx; i++) {
-            if (pui->cmd[i] == '\n') {
-                pui->cmd[i] = (char) 0;
-                gotline = 1;
-                parse_and_execute(pui);
-                (void) memmove(pui->cmd, &(pui->cmd[i+1]), (pui->cmdindx - (i+1)));
-                pui->cmdindx -= i+1;
-                break;
-            }
-        }
-    } while ((gotline == 1) && (pui->cmdindx > 0));
+    prsc->uilock = pui->cn;
+    req = mkreq(pui->cn);
+    len = MX_GETRPLY;
+    (prsc->pgscb)(EDGET, irsc, val, &(Slots[islot]), req, &len, rply);
+    if (len > 0) {
+        // Send response or error messages back to the user
+        if (len < MX_GETRPLY) {
+            send_ui(rply, len, pui->cn);
+            prompt(pui->cn);
+            if ((val == 0) && (prsc->dpriv != 0) && (strncmp(rply, "ERROR", 5) != 0))
+                ed_cache(prsc, rply, len);
+        }
+        prsc->uilock = -1;
+    }
+    else if ((len == ED_PENDING) || (prsc->uilock == pui->cn)) {
+        // The plug-in will send the response later.  Remember the
+        // request ID so the reply can carry it.  uilock is left as the
+        // plug-in has it since a plug-in thread may have answered.
+        (void) add_wait(pui->cn, islot, irsc, pui->tag,
+                ((len == ED_PENDING) ? WT_PENDING : WT_DEFER), req, (char *) 0);
+    }
+    return;
+}
+
+
+/***************************************************************************
+ * do_set(): - Call the write routine of a resource for a UI.  A write
+ * can not start while a get or set of the resource is pending.  The
+ * plug-in may leave the write pending just as it can a read.
+ ***************************************************************************/
+static void do_set(
+    UI      *pui,         // UI giving the value
+    int      islot,       // slot of the resource
+    int      irsc,        // resource index in the slot
+    char    *val)         // the new value
+{
+    RSC     *prsc;        // the resource to write
+    char     rply[MXRPLY]; // error message from the plug-in
+    int      req;         // cn and request ID for the plug-in
+    int      len;         // length of reply
+
+    prsc = RSCPTR(&(Slots[islot]), irsc);
+    if (prsc->pgscb == 0) {
+        return;
+    }
+    if (prsc->uilock >= 0) {
+        len = snprintf(rply, sizeof(rply), E_BUSY, prsc->name);
+        send_ui(rply, len, pui->cn);
+        prompt(pui->cn);
+        return;
+    }
+
+    // The value is changing so any cached one is stale
+    if (prsc->dpriv != 0) {
+        ed_cache(prsc, (char *) 0, 0);
+    }
+    prsc->uilock = pui->cn;
+    req = mkreq(pui->cn);
+    len = MXRPLY;
+    (prsc->pgscb)(EDSET, irsc, val, &(Slots[islot]), req, &len, rply);
+    if (len == ED_PENDING) {
+        prsc->uilock = pui->cn;
+        (void) add_wait(pui->cn, islot, irsc, pui->tag, WT_PENDING, req, (char *) 0);
+        return;
+    }
+    prsc->uilock = -1;
+    // Send any error messages back to user
+    if ((len > 0) && (len < MXRPLY)) {
+        send_ui(rply, len, pui->cn);
+    }
+    prompt(pui->cn);
+    return;
+}
+
+
+/***************************************************************************
+ * ed_complete(): - A plug-in finishes a pending get or set.  The cn has
+ * the ID of the request, and the reply is sent only if that request is
+ * still waiting.  A reply that comes after the timeout is dropped, even
+ * if the UI has made another request of the resource since.  The reply
+ * to a batch read or to ed_set() goes to no UI.
+ ***************************************************************************/
+void ed_complete(
+    int      cn,          // cn given to pgscb
+    RSC     *prsc,        // the resource
+    char    *buf,         // the reply, if any
+    int      len)         // number of chars in buf
+{
+    ED_WAIT *pw;          // the request
+
+    if (thr_route(THR_REPLY, cn, (void *) prsc, buf, len) == 0)
+        return;           // a plug-in thread, done in the daemon's loop
+    if ((prsc == 0) || (cn < 0) || ((pw = find_wait(cn, prsc)) == 0)) {
+        return;           // timed out or already complete
+    }
+    cn = pw->cn;
+    outwait = pw;
+    if ((buf != 0) && (len > 0)) {
+        send_ui(buf, len, cn);
+    }
+    prompt(cn);
+    outwait = 0;
+    pw->cn = -1;
+    prsc->uilock = -1;
+    return;
+}
+
+
+/***************************************************************************
+ * ed_fail(): - A plug-in gives up on a pending get or set.  The UI
+ * gets a no response error.
+ ***************************************************************************/
+void ed_fail(
+    int      cn,          // cn given to pgscb
+    RSC     *prsc)        // the resource
+{
+    char     rply[MXRPLY]; // the error message
+    int      len;
+
+    if (thr_route(THR_FAIL, cn, (void *) prsc, (char *) 0, 0) == 0)
+        return;           // a plug-in thread, done in the daemon's loop
+    if ((prsc == 0) || (cn < 0)) {
+        return;
+    }
+    len = snprintf(rply, sizeof(rply), E_NORSP, prsc->name);
+    ed_complete(cn, prsc, rply, len);
+    return;
+}
+
+
+/***************************************************************************
+ * check_rsp(): - Fail the pending gets and sets that the plug-ins have
+ * not finished in RspTimeout milliseconds.  Only ED_PENDING requests
+ * time out.  A plug-in that sends its reply itself with send_ui() and
+ * prompt() would still send it after the timeout.
+ ***************************************************************************/
+static void check_rsp(
+    void    *timer,       // handle of the timer that expired
+    void    *data)        // unused
+{
+    ED_WAIT *pw;          // a pending request
+    RSC     *prsc;        // its resource
+    long long now;        // current time in microseconds
+    int      i;
+
+    if (RspTimeout <= 0)
+        return;
+    now = now_us();
+    for (i = 0, pw = Waits; i < MX_WAIT; i++, pw++) {
+        if ((pw->cn == -1) || (pw->active != WT_PENDING) ||
+            ((now - pw->t_start) < (RspTimeout * 1000LL)))
+            continue;
+        prsc = RSCPTR(&(Slots[pw->slot]), pw->rsc);
+        edlog(M_NORSP, prsc->name);
+        ed_fail(pw->req, prsc);
+        pw->cn = -1;
+    }
+    return;
+}
+
+
+/***************************************************************************
+ * do_mget(): - Read many resources and send all of the values back as
+ * one reply.  edmget takes a plug-in name to read all of its readable
+ * resources, or a list of slot/resource pairs and handles.  eddump
+ * reads every readable resource in the system.  All of the reads are
+ * done in this pass of the select loop so the values form a snapshot.
+ *   Each value is on a line that starts with the plug-in and resource
+ * names.  An error for one resource does not stop the others.
+ ***************************************************************************/
+static void do_mget(
+    UI      *pui,         // UI requesting the values
+    int      icmd,        // EDMGET or EDDUMP
+    char    *args)        // rest of the command line
+{
+    static char out[MX_MGET]; // the reply
+    int      olen = 0;    // length of reply so far
+    char    *targ[MX_MARG]; // the arguments
+    int      narg = 0;    // number of arguments
+    char    *saveptr;     // for strtok_r
+    int      islot;       // slot ID of a resource
+    int      irsc;        // index of a resource
+    int      i;
+
+    if (icmd == EDDUMP) {
+        for (islot = 0; islot < MX_PLUGIN; islot++) {
+            for (irsc = 0; (Slots[islot].name != 0) && (irsc < Slots[islot].nrsc); irsc++) {
+                if ((RSCPTR(&(Slots[islot]), irsc)->name != 0) &&
+                    (RSCPTR(&(Slots[islot]), irsc)->flags & IS_READABLE))
+                    olen = mget_one(pui, islot, irsc, out, olen);
+            }
+        }
+        send_ui(out, olen, pui->cn);
+        prompt(pui->cn);
+        return;
+    }
+
+    targ[narg] = strtok_r(args, " \t\r\n", &saveptr);
+    while ((targ[narg] != 0) && (narg < MX_MARG - 1)) {
+        narg++;
+        targ[narg] = strtok_r(NULL, " \t\r\n", &saveptr);
+    }
+
+    if ((narg == 1) && (targ[0][0] != '@')) {
+        // A plug-in by itself.  Read all of its readable resources
+        islot = find_slot(targ[0]);
+        if ((islot < 0) || (Slots[islot].name == 0)) {
+            olen = snprintf(out, MX_MGET, E_NOPERI, targ[0]);
+        }
+        for (irsc = 0; (islot >= 0) && (irsc < Slots[islot].nrsc); irsc++) {
+            if ((RSCPTR(&(Slots[islot]), irsc)->name != 0) &&
+                (RSCPTR(&(Slots[islot]), irsc)->flags & IS_READABLE))
+                olen = mget_one(pui, islot, irsc, out, olen);
+        }
+        send_ui(out, olen, pui->cn);
+        prompt(pui->cn);
+        return;
+    }
+
+    for (i = 0; i < narg; i++) {
+        // Leave room to echo a bad argument of any length in an error
+        if (olen > MX_MGET - (MXCMD + MXRPLY)) {
+            send_ui(out, olen, pui->cn);
+            olen = 0;
+        }
+        if (targ[i][0] == '@') {
+            islot = find_handle(targ[i], &irsc);
+            if (islot < 0) {
+                olen += snprintf(&(out[olen]), (MX_MGET - olen), E_BDHNDL, targ[i]);
+                continue;
+            }
+        }
+        else {
+            islot = find_slot(targ[i]);
+            if ((islot < 0) || (Slots[islot].name == 0)) {
+                olen += snprintf(&(out[olen]), (MX_MGET - olen), E_NOPERI, targ[i]);
+                i++;    // skip the resource name too
+                continue;
+            }
+            i++;
+            irsc = (i < narg) ? find_name(islot, targ[i]) : -1;
+            if (irsc < 0) {
+                olen += snprintf(&(out[olen]), (MX_MGET - olen), E_NORSC,
+                                 ((i < narg) ? targ[i] : "(null)"), Slots[islot].name);
+                continue;
+            }
+        }
+        olen = mget_one(pui, islot, irsc, out, olen);
+    }
+    send_ui(out, olen, pui->cn);
+    prompt(pui->cn);
+    return;
+}
+
+
+/***************************************************************************
+ * mget_one(): - Read one resource for do_mget() and add a line with
+ * the plug-in name, resource name, and value to the reply.  A resource
+ * that is busy is not waited for.  A plug-in that defers the read has
+ * its late reply discarded.  The reads have no arguments so they use
+ * and fill the cache as a plain get does.  Returns the new length of
+ * the reply.
+ ***************************************************************************/
+static int mget_one(
+    UI      *pui,         // UI requesting the value
+    int      islot,       // slot of the resource
+    int      irsc,        // resource index in the slot
+    char    *out,         // reply, MX_MGET bytes
+    int      olen)        // length of the reply so far
+{
+    RSC     *prsc;        // the resource to read
+    char     rply[MXRPLY]; // value from the plug-in
+    char    *cval;        // the cached value
+    int      req;         // cn and request ID for the plug-in
+    int      len;         // length of value
+
+    // Send what we have if the next value might not fit
+    if (olen > MX_MGET - (2 * MXRPLY)) {
+        send_ui(out, olen, pui->cn);
+        olen = 0;
+    }
+
+    prsc = RSCPTR(&(Slots[islot]), irsc);
+    olen += snprintf(&(out[olen]), MXRPLY, "%s %s ", Slots[islot].name, prsc->name);
+    if (((prsc->flags & IS_READABLE) == 0) || (prsc->pgscb == 0)) {
+        olen += snprintf(&(out[olen]), MXRPLY, E_NREAD, prsc->name);
+        return(olen);
+    }
+    if ((prsc->dpriv != 0) && ((len = cache_get(prsc, &cval)) > 0)) {
+        len = (len < MXRPLY) ? len : MXRPLY - 1;
+        memcpy(&(out[olen]), cval, len);
+        olen += len;
+        if (out[olen - 1] != '\n')
+            out[olen++] = '\n';
+        return(olen);
+    }
+    if (prsc->uilock >= 0) {
+        olen += snprintf(&(out[olen]), MXRPLY, E_BUSY, prsc->name);
+        return(olen);
+    }
+
+    prsc->uilock = pui->cn;
+    req = mkreq(pui->cn);
+    len = MXRPLY;
+    (prsc->pgscb)(EDGET, irsc, (char *) 0, &(Slots[islot]), req, &len, rply);
+    if (len > 0) {
+        len = (len < MXRPLY) ? len : MXRPLY - 1;
+        if ((prsc->dpriv != 0) && (strncmp(rply, "ERROR", 5) != 0))
+            ed_cache(prsc, rply, len);
+        memcpy(&(out[olen]), rply, len);
+        olen += len;
+        if (out[olen - 1] != '\n')
+            out[olen++] = '\n';
+        prsc->uilock = -1;
+    }
+    else if ((len == ED_PENDING) || (prsc->uilock == pui->cn)) {
+        // The plug-in will answer later.  Point its reply at no UI.  A
+        // plug-in thread may be reading uilock.
+        __atomic_store_n(&(prsc->uilock), UI_BATCH, __ATOMIC_RELAXED);
+        (void) add_wait(UI_BATCH, islot, irsc, 0,
+                ((len == ED_PENDING) ? WT_PENDING : WT_DEFER), req, (char *) 0);
+        olen += snprintf(&(out[olen]), MXRPLY, E_NOBATCH, prsc->name);
+    }
+    else {
+        out[olen++] = '\n';
+    }
+    return(olen);
+}
+
+
+/***************************************************************************
+ * add_wait(): - Record a UI waiting on the read of a resource, or on a
+ * request the plug-in is doing if active is not WT_QUEUED.  The
+ * arguments of a queued read are kept so it is reissued as it was
+ * given.  Returns -1 if there is no room in the table, else 0.
+ ***************************************************************************/
+int add_wait(
+    int      cn,          // UI waiting for the value
+    int      islot,       // slot of the resource
+    int      irsc,        // resource index in the slot
+    int      tag,         // request ID of the get, or 0
+    int      active,      // WT_xxx, what the request is doing
+    int      req,         // cn and request ID given to pgscb, if active
+    char    *val)         // arguments of a queued get, if any
+{
+    int      i;
+
+    for (i = 0; i < MX_WAIT; i++) {
+        if (Waits[i].cn == -1)
+            break;
+    }
+    if (i == MX_WAIT) {
+        return(-1);
+    }
+    Waits[i].cn = cn;
+    Waits[i].slot = islot;
+    Waits[i].rsc = irsc;
+    Waits[i].tag = tag;
+    Waits[i].active = active;
+    Waits[i].order = waitorder++;
+    Waits[i].t_start = (active) ? now_us() : 0;
+    Waits[i].req = req;
+    Waits[i].val[0] = (char) 0;
+    if (val != 0) {
+        (void) strncpy(Waits[i].val, val, MXCMD - 1);
+        Waits[i].val[MXCMD - 1] = (char) 0;
+    }
+    return(0);
+}
+
+
+/***************************************************************************
+ * curtag(): - Return the request ID for output to a UI.  While a
+ * command is being parsed this is the ID of that command.  Output at
+ * other times is from a plug-in finishing a deferred request and takes
+ * the ID of that request, which is put in *ppw.  ed_complete() names
+ * the request.  A plug-in that sends its reply itself does not, so its
+ * output goes with the oldest such read of the UI whose resource is
+ * still locked to it.  A plug-in thread may let go of the resource
+ * before its output is sent so its reads need not be locked.  *ppw is
+ * null if the output is of no request.
+ ***************************************************************************/
+static int curtag(
+    UI      *pui,         // UI getting the output
+    ED_WAIT **ppw)        // where to put the request
+{
+    ED_WAIT *pw = 0;      // the deferred request
+    int      i;
+
+    *ppw = (ED_WAIT *) 0;
+    if (pui->cn == parsecn) {
+        return(pui->tag);
+    }
+    if ((outwait != 0) && (outwait->cn == pui->cn)) {
+        pw = outwait;
+    }
+    else {
+        for (i = 0; i < MX_WAIT; i++) {
+            if ((Waits[i].cn != pui->cn) || ((Waits[i].active != WT_ROUTED) &&
+                ((Waits[i].active != WT_DEFER) ||
+                 (RSCPTR(&(Slots[Waits[i].slot]), Waits[i].rsc)->uilock != pui->cn))))
+                continue;
+            if ((pw == 0) || ((int) (Waits[i].order - pw->order) < 0))
+                pw = &(Waits[i]);
+        }
+    }
+    *ppw = pw;
+    return((pw) ? pw->tag : 0);
+}
+
+
+/***************************************************************************
+ * find_wait(): - Return the pending request of a resource with the
+ * given cn and request ID, or a null pointer if it is not waiting.
+ ***************************************************************************/
+static ED_WAIT *find_wait(
+    int      req,         // cn and request ID given to pgscb
+    RSC     *prsc)        // the resource
+{
+    int      i;
+
+    for (i = 0; i < MX_WAIT; i++) {
+        if ((Waits[i].cn != -1) && (Waits[i].active == WT_PENDING) &&
+            (Waits[i].req == req) &&
+            (RSCPTR(&(Slots[Waits[i].slot]), Waits[i].rsc) == prsc))
+            return(&(Waits[i]));
+    }
+    return((ED_WAIT *) 0);
+}
+
+
+/***************************************************************************
+ * defer_wait(): - The get routine of a plug-in thread returned with no
+ * reply.  As in do_get(), the plug-in answers the read itself with
+ * send_ui() and prompt(), or already has if it let go of the resource.
+ * The pending read is then not timed out.  The routed prompt completes
+ * it, or for a batch read, which gets no prompt, clearing uilock does.
+ ***************************************************************************/
+void defer_wait(
+    int      req,         // cn and request ID given to pgscb
+    RSC     *prsc,        // the resource
+    int      held)        // set if the plug-in had not answered yet
+{
+    ED_WAIT *pw;          // the pending read
+
+    if ((prsc == 0) || ((pw = find_wait(req, prsc)) == 0))
+        return;
+    if (held == 0) {
+        // do_mget() locked the resource after the plug-in let go of it
+        if ((pw->cn >= MX_UI) && (prsc->uilock == pw->cn))
+            prsc->uilock = -1;
+        pw->cn = -1;
+    }
+    else
+        pw->active = (pw->cn < MX_UI) ? WT_ROUTED : WT_DEFER;
+    return;
+}
+
+
+/***************************************************************************
+ * mkreq(): - Return the cn to give pgscb for a get or set.  It is the
+ * UI's cn with a new request ID above ED_REQSHIFT.  IDs wrap before
+ * the cn would go negative.
+ ***************************************************************************/
+int mkreq(
+    int      cn)          // UI of the request, or UI_BATCH
+{
+    reqseq = (reqseq % (INT_MAX >> ED_REQSHIFT)) + 1;
+    return(cn | (int) (reqseq << ED_REQSHIFT));
+}
+
+
+/***************************************************************************
+ * service_ui(): - Called once per pass of the select loop.  Retire the
+ * deferred reads that the plug-ins have completed and reissue the
+ * oldest queued read of each resource that is no longer busy.  Then
+ * send the output queued for each UI during the pass with one write
+ * per UI.  Returns the number of reads reissued.
+ ***************************************************************************/
+int service_ui()
+{
+    ED_WAIT *pw;          // a waiting read
+    ED_WAIT *pfirst;      // oldest queued read of a resource
+    ED_WAIT  next;        // copy of the read to reissue
+    RSC     *prsc;        // resource of the waiting read
+    UI      *pui;         // UI of the waiting read
+    int      nissued = 0; // number of reads reissued
+    int      i, j;
+
+    // Tell plug-ins of the resources that gained or lost all listeners
+    if (Telling)
+        tell_subs();
+
+    // A deferred read is done when the plug-in clears uilock.  A
+    // pending one waits for ed_complete() or the timeout.
+    for (i = 0, pw = Waits; i < MX_WAIT; i++, pw++) {
+        if ((pw->cn != -1) && (pw->active == WT_DEFER) &&
+            (RSCPTR(&(Slots[pw->slot]), pw->rsc)->uilock != pw->cn))
+            pw->cn = -1;
+    }
+
+    for (i = 0, pw = Waits; i < MX_WAIT; i++, pw++) {
+        if ((pw->cn == -1) || (pw->active))
+            continue;
+        prsc = RSCPTR(&(Slots[pw->slot]), pw->rsc);
+        if (prsc->uilock >= 0)
+            continue;       // still busy
+
+        // Find the oldest read queued on this resource and reissue it
+        pfirst = pw;
+        for (j = 0; j < MX_WAIT; j++) {
+            if ((Waits[j].cn != -1) && (Waits[j].active == 0) &&
+                (Waits[j].slot == pw->slot) && (Waits[j].rsc == pw->rsc) &&
+                ((int) (Waits[j].order - pfirst->order) < 0))
+                pfirst = &(Waits[j]);
+        }
+        next = *pfirst;
+        pfirst->cn = -1;
+        pui = &(UiCons[next.cn]);
+        if (pui->fd < 0)
+            continue;
+        pui->tag = next.tag;
+        pui->cslot = next.slot;
+        pui->crsc = next.rsc;
+        parsecn = next.cn;
+        do_get(pui, next.slot, next.rsc, ((next.val[0]) ? next.val : (char *) 0));
+        parsecn = -1;
+        pui->tag = 0;
+        nissued++;
+    }
+
+    // Send what the pass queued.  UIs waiting to be writable are
+    // flushed from receive_ui() instead.
+    for (i = 0, pui = UiCons; i < MX_UI; i++, pui++) {
+        if ((pui->fd >= 0) && (pui->olen > 0) && (pui->wpend == 0))
+            flush_ui(i);
+    }
+    return(nissued);
+}
+
+
+/***************************************************************************
+ * mkframe(): - Fill in the header of a binary protocol frame.  All
+ * multi-byte fields are written in network byte order.  See eedd.h
+ * for the layout of the header.
+ ***************************************************************************/
+void mkframe(
+    unsigned char *hdr,   // ED_FRHDRSZ bytes of header to fill in
+    int      type,        // ED_FR_REPLY, ED_FR_PROMPT, or ED_FR_BCST
+    int      ptype,       // type of the payload, ED_PT_xxx
+    int      slot,        // slot ID or ED_NOID
+    int      rsc,         // resource ID or ED_NOID
+    int      tag,         // request ID of the command, or 0
+    unsigned int seq,     // sequence number of this frame
+    long long ts,         // timestamp in microseconds since the Epoch
+    int      len)         // number of payload bytes after the header
+{
+    int      i;           // loop counter for the timestamp
+
+    hdr[0]  = (len >> 24) & 0xff;
+    hdr[1]  = (len >> 16) & 0xff;
+    hdr[2]  = (len >> 8) & 0xff;
+    hdr[3]  = len & 0xff;
+    hdr[4]  = type & 0xff;
+    hdr[5]  = ptype & 0xff;
+    hdr[6]  = (slot >> 8) & 0xff;
+    hdr[7]  = slot & 0xff;
+    hdr[8]  = (rsc >> 8) & 0xff;
+    hdr[9]  = rsc & 0xff;
+    hdr[10] = (tag >> 8) & 0xff;
+    hdr[11] = tag & 0xff;
+    hdr[12] = (seq >> 24) & 0xff;
+    hdr[13] = (seq >> 16) & 0xff;
+    hdr[14] = (seq >> 8) & 0xff;
+    hdr[15] = seq & 0xff;
+    for (i = 0; i < 8; i++) {
+        hdr[16 + i] = (ts >> (56 - (8 * i))) & 0xff;
+    }
+    return;
+}
+
+
+/***************************************************************************
+ * send_iov(): - Queue a header, such as a frame header or request ID,
+ * and a payload on the output buffer of a UI.  The buffer is written
+ * with one system call per pass of the select loop by flush_ui().  A
+ * broadcast that would put more than MX_OBUF bytes in the buffer is
+ * dropped and counted.  The buffer grows for a reply, and a UI that
+ * lets more than MX_OBUFMAX bytes of replies pile up is closed.
+ ***************************************************************************/
+void send_iov(
+    int      cn,          // index to UI conn table
+    unsigned char *hdr,   // frame header or request ID
+    int      hlen,        // number of bytes in the header
+    char    *buf,         // payload
+    int      len,         // number of bytes of payload
+    int      isbcst)      // set if broadcast data that can be dropped
+{
+    UI      *pui;         // UI getting the output
+    char     ccn[20];     // cn as a string for the log
+
+    pui = &(UiCons[cn]);
+    if ((hlen + len <= 0) || (pui->fd < 0)) {
+        return;           // nothing to send
+    }
+    if ((isbcst) && (pui->olen + hlen + len > MX_OBUF)) {
+        pui->stats.bdrops++;
+        return;
+    }
+    if ((pui->olen + hlen + len > pui->osize) &&
+        (grow_obuf(pui, pui->olen + hlen + len) != 0)) {
+        (void) snprintf(ccn, sizeof(ccn), "%d", cn);
+        edlog(M_SLOWUI, ccn);
+        close_ui_conn(cn);
+        return;
+    }
+    if (hlen > 0) {
+        memcpy(&(pui->obuf[pui->olen]), hdr, hlen);
+        pui->olen += hlen;
+    }
+    if (len > 0) {
+        memcpy(&(pui->obuf[pui->olen]), buf, len);
+        pui->olen += len;
+    }
+    pui->stats.nbcst += isbcst;
+    if (pui->olen > pui->stats.omax) {
+        pui->stats.omax = pui->olen;
+    }
+    return;
+}
+
+
+/***************************************************************************
+ * grow_obuf(): - Make the output buffer of a UI big enough for need
+ * bytes.  It starts at MX_OBUF and doubles.  Return 0 on success, or
+ * -1 if more than MX_OBUFMAX bytes are needed or there is no memory.
+ ***************************************************************************/
+static int grow_obuf(
+    UI      *pui,         // UI whose buffer is too small
+    int      need)        // bytes the buffer must hold
+{
+    char    *nbuf;        // the larger buffer
+    int      nsize;       // its size
+
+    if (need > MX_OBUFMAX) {
+        return(-1);
+    }
+    nsize = (pui->osize > 0) ? pui->osize : MX_OBUF;
+    while (nsize < need) {
+        nsize *= 2;
+    }
+    nbuf = realloc(pui->obuf, nsize);
+    if (nbuf == (char *) 0) {
+        edlog(M_NOMEM, "grow_obuf");
+        return(-1);
+    }
+    pui->obuf = nbuf;
+    pui->osize = nsize;
+    return(0);
+}
+
+
+/***************************************************************************
+ * flush_ui(): - Write the output buffer of a UI.  Whatever can not be
+ * written now is kept and the select loop watches for the FD to
+ * become writable.  Close the connection on error.
+ ***************************************************************************/
+static void flush_ui(
+    int      cn)          // index to UI conn table
+{
+    UI      *pui;         // UI to flush
+    int      nwr;         // number of bytes written
+    int      wpend;       // set if output remains
+
+    pui = &(UiCons[cn]);
+    if (pui->fd < 0) {
+        return;
+    }
+    nwr = 0;
+    if (pui->olen > 0) {
+        nwr = write(pui->fd, pui->obuf, pui->olen);
+        if ((nwr < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR))) {
+            nwr = 0;
+        }
+        else if (nwr <= 0) {
+            close_ui_conn(cn);
+            return;
+        }
+        pui->stats.nbout += nwr;
+    }
+    if ((nwr > 0) && (nwr < pui->olen)) {
+        (void) memmove(pui->obuf, &(pui->obuf[nwr]), (pui->olen - nwr));
+    }
+    pui->olen -= nwr;
+
+    // Give back a buffer that grew for a big reply once it is sent
+    if ((pui->olen == 0) && (pui->osize > MX_OBUF)) {
+        free(pui->obuf);
+        pui->obuf = (char *) 0;
+        pui->osize = 0;
+    }
+
+    // An HTTP reply ends when the connection closes
+    if ((pui->olen == 0) && (pui->http.close)) {
+        close_ui_conn(cn);
+        return;
+    }
+
+    // Watch for writable only while there is output waiting
+    wpend = (pui->olen > 0);
+    if (wpend != pui->wpend) {
+        mod_fd(pui->fd, (((pui->throttled) ? 0 : ED_READ) | (wpend ? ED_WRITE : 0)));
+        pui->wpend = wpend;
+    }
+    return;
+}
+
+
+/***************************************************************************
+ * receive_ui(): - This routine is called to read data
+ * from a TCP connection.  The line framer finds each end-of-line
+ * and full lines are passed to the CLI parser without copying.  A
+ * line too long for the buffer gets an error and is discarded.  It also sends queued output
+ * once a UI that was not keeping up becomes writable.
+ *
+ * Input:        FD of socket with data to read, callback data, activity
+ * Output:       void
+ * Effects:      the Baseboard vie the CLI parser
+ ***************************************************************************/
+void receive_ui(int fd_in, int cb_data, int activity)
+{
+    int      nrd;            /* number of bytes read */
+    int      room;           /* number of bytes that fit in the buffer */
+    char    *line;           /* where to read into the buffer */
+    int      cn;             /* index into UiCons */
+    UI      *pui;            /* pointer to UI at cn */
+
+    /* Locate the UI struct with fd equal to fd_in */
+    for (cn = 0 ; cn < MX_UI; cn++) {
+        if (fd_in == UiCons[cn].fd) {
+            break;
+        }
+    }
+    /* Error if we could not find the fd */
+    if (MX_UI == cn) {
+        /* Take this bogus fd out of the select loop */
+        del_fd(fd_in);
+        close(fd_in);
+        return;
+    }
+    pui = &(UiCons[cn]);
+
+    /* Send queued output if the socket has room for it now */
+    if (activity & ED_WRITE) {
+        flush_ui(cn);
+        if (pui->fd < 0)
+            return;
+    }
+    if ((activity & ED_READ) == 0) {
+        return;
+    }
+
+    /* We read data from the connection into the buffer in the ui struct. Once
+     * we've read all of the data we can, we scan for a newline character and
+     * pass any full lines to the parser. */
+    line = ed_line_room(&(pui->cmdbuf), &room);
+    nrd = read(pui->fd, line, room);
+
+    /* shutdown manager conn on error or on zero bytes read.  errno is
+     * only looked at on error since it may be left from another call. */
+    if ((nrd == 0) || ((nrd < 0) && (errno != EAGAIN))) {
+        close_ui_conn(cn);
+        return;
+    }
+    if (nrd < 0) {
+        return;           /* nothing to read after all */
+    }
+
+    ed_line_added(&(pui->cmdbuf), nrd);
+    pui->stats.nbin += nrd;
+    pui->stats.t_last = now_us();
+
+    /* The commands are in the buffer. Call the parser to execute them */
+    parse_lines(cn);
+    return;
+}
+
+
+/***************************************************************************
+ * parse_lines(): - Pass the complete lines in a UI's buffer to the
+ * parser.  A UI that is over its rate limit stops here.  The rest of
+ * its lines wait in the buffer until resume_ui() finds it has credit
+ * again.  Bulk commands wait the same way while the daemon is
+ * overloaded, but for no more than OVL_MAXWAIT ms.
+ ***************************************************************************/
+static void parse_lines(
+    int      cn)          // index to UI conn table
+{
+    UI      *pui;         // pointer to UI at cn
+    char    *line;        // a command line in the buffer
+    int      len;         // length of line or ED_LINE_xxx
+    char     rply[MXRPLY]; // error for an overlong line
+    char     cmax[20];    // longest command as a string
+
+    pui = &(UiCons[cn]);
+    while ((pui->fd >= 0) && (ui_throttle(pui) == 0) &&
+           ((len = ed_line_next(&(pui->cmdbuf), &line)) != ED_LINE_NONE)) {
+        if (pui->proto == ED_PROTO_HTTP) {
+            parsecn = cn;
+            http_line(pui, line, len);
+            parsecn = -1;
+            continue;
+        }
+        if (UiRate > 0) {
+            pui->credit -= 1000000LL / UiRate;
+        }
+        if (len == ED_LINE_LONG) {
+            (void) snprintf(cmax, sizeof(cmax), "%d", MXCMD - 1);
+            len = snprintf(rply, MXRPLY, E_TOOLONG, cmax);
+            send_ui(rply, len, cn);
+            prompt(cn);
+            continue;
+        }
+        if ((Overload >= OVL_DEFER) && (is_bulk(line))) {
+            if (pui->t_defer == 0)
+                pui->t_defer = now_us();
+            if ((now_us() - pui->t_defer) < (OVL_MAXWAIT * 1000LL)) {
+                ed_line_unget(&(pui->cmdbuf), line, len);
+                hold_ui(pui, OVL_PERIOD);
+                break;
+            }
+        }
+        pui->t_defer = 0;
+        parsecn = cn;
+        parse_and_execute(pui, line);
+        parsecn = -1;
+        pui->tag = 0;     // done with any request ID
+    }
+    return;
+}
+
+
+/***************************************************************************
+ * ui_throttle(): - Apply the rate limit to a UI with input waiting.
+ * Each UI has a token bucket kept as credit in microseconds.  Credit
+ * grows with time up to UiBurst commands and each command costs
+ * 1/UiRate seconds.  A UI without credit for its next command is
+ * taken out of the read set so it can not use the loop's time, and
+ * the resume timer is started.  Returns 1 if the UI must wait.
+ ***************************************************************************/
+static int ui_throttle(
+    UI      *pui)         // UI with commands to parse
+{
+    long long cost;       // microseconds of credit per command
+    long long cap;        // most credit a UI may save up
+    long long now;        // current time in microseconds
+
+    if ((UiRate <= 0) || (pui->proto == ED_PROTO_HTTP) ||
+        (pui->cmdbuf.start == pui->cmdbuf.end)) {
+        return(0);
+    }
+    cost = 1000000LL / UiRate;
+    cap = cost * ((UiBurst > 0) ? UiBurst : 1);
+    now = now_us();
+    pui->credit += now - pui->t_fill;
+    pui->t_fill = now;
+    pui->credit = (pui->credit > cap) ? cap : pui->credit;
+    if (pui->credit >= cost) {
+        return(0);
+    }
+
+    // Out of credit.  Stop reading until there is enough for a command.
+    hold_ui(pui, (int) ((cost - pui->credit + 999) / 1000));
+    return(1);
+}
+
+
+/***************************************************************************
+ * hold_ui(): - Stop reading and parsing a UI's commands.  The resume
+ * timer is started if it is not already running.
+ ***************************************************************************/
+static void hold_ui(
+    UI      *pui,         // UI to hold
+    int      ms)          // when to look at the UI again
+{
+    pui->stats.nthrottle++;
+    pui->throttled = 1;
+    mod_fd(pui->fd, ((pui->wpend) ? ED_WRITE : 0));
+    if (rltimer == 0) {
+        rltimer = add_timer(ED_ONESHOT, ms, resume_ui, (void *) 0);
+    }
+    return;
+}
+
+
+/***************************************************************************
+ * is_bulk(): - Return 1 if a command line is one that can wait while
+ * the daemon is overloaded: edlist, eddump, edloadso, or edreloadso.
+ ***************************************************************************/
+static int is_bulk(
+    char    *line)        // the command line, not yet tokenized
+{
+    size_t   n;           // length of the command word
+
+    line += strspn(line, " \t");
+    if (line[0] == '#') {  // skip a request ID
+        line += strcspn(line, " \t");
+        line += strspn(line, " \t");
+    }
+    n = strcspn(line, " \t\r");
+    return(((n == strlen(CPREFIX "list")) && (!strncmp(line, CPREFIX "list", n))) ||
+           ((n == strlen(CPREFIX "dump")) && (!strncmp(line, CPREFIX "dump", n))) ||
+           ((n == strlen(CPREFIX "loadso")) && (!strncmp(line, CPREFIX "loadso", n))) ||
+           ((n == strlen(CPREFIX "reloadso")) && (!strncmp(line, CPREFIX "reloadso", n))));
+}
+
+
+/***************************************************************************
+ * resume_ui(): - Let the throttled UIs read and parse again.  All UIs
+ * have the same rate so the first UI throttled is the first with
+ * credit again.  A UI still without credit, or with a bulk command
+ * while overloaded, is held again and restarts the timer.
+ ***************************************************************************/
+static void resume_ui(
+    void    *timer,       // handle of the timer that expired
+    void    *data)        // unused
+{
+    UI      *pui;         // a UI connection
+    int      cn;          // index to above
+
+    rltimer = (void *) 0;
+    for (cn = 0, pui = UiCons; cn < MX_UI; cn++, pui++) {
+        if ((pui->fd < 0) || (pui->throttled == 0))
+            continue;
+        pui->throttled = 0;
+        mod_fd(pui->fd, (ED_READ | ((pui->wpend) ? ED_WRITE : 0)));
+        parse_lines(cn);
+    }
+    return;
+}
 
+
+/***************************************************************************
+ * check_idle(): - Close UI connections that have been idle for more
+ * than UiIdle seconds.  A UI that watches a resource, has a read in
+ * progress, is held back, or has output waiting is not idle.  Idle
+ * time is counted from the last byte read, so a UI that stops in the
+ * middle of a line is closed too.  Also restarts any throttled UIs if
+ * the resume timer could not be added.
+ ***************************************************************************/
+static void check_idle(
+    void    *timer,       // handle of the timer that expired
+    void    *data)        // unused
+{
+    UI      *pui;         // a UI connection
+    int      cn;          // index to above
+    int      i;
+    long long now;        // current time in microseconds
+    char     ccn[20];     // cn as a string for the log
+    int      nthrottled = 0; // number of throttled UIs
+
+    now = now_us();
+    for (cn = 0, pui = UiCons; cn < MX_UI; cn++, pui++) {
+        if (pui->fd < 0)
+            continue;
+        nthrottled += pui->throttled;
+        if ((UiIdle <= 0) || (pui->bkey != 0) || (pui->throttled) ||
+            (pui->olen != 0) || ((now - pui->stats.t_last) < (UiIdle * 1000000LL)))
+            continue;
+        for (i = 0; i < MX_WAIT; i++) {
+            if (Waits[i].cn == cn)
+                break;
+        }
+        if (i < MX_WAIT)
+            continue;
+        (void) snprintf(ccn, sizeof(ccn), "%d", cn);
+        edlog(M_IDLEUI, ccn);
+        close_ui_conn(cn);
+    }
+    if ((nthrottled) && (rltimer == 0)) {
+        resume_ui((void *) 0, (void *) 0);
+    }
     return;
 }
 
@@ -546,45 +2056,103 @@ void open_ui_conn(int srvfd, int cb_data)
     int      newuifd;    /* New UI FD */
     socklen_t adrlen;    /* length of an inet socket address */
     struct sockaddr_in cliskt; /* socket to the UI/DB client */
-    int      flags;      /* helps set non-blocking IO */
+    struct ucred cred;   /* user of a Unix socket client */
+    char     cuid[20];   /* uid as a string for the log */
+    int      on = 1;     /* to turn on TCP_NODELAY */
     int      i;
 
-    /* Accept the connection */
-    adrlen = (socklen_t) sizeof(struct sockaddr_in);
-    newuifd = accept(srvfd, (struct sockaddr *) &cliskt, &adrlen);
-    if (newuifd < 0) {
-        return;
-    }
+    /* Accept all of the waiting connections.  This keeps a burst of
+     * reconnects from taking one pass of the select loop each. */
+    while (1) {
+        adrlen = (socklen_t) sizeof(struct sockaddr_in);
+        (void) memset((void *) &cliskt, 0, sizeof(struct sockaddr_in));
+        newuifd = accept4(srvfd, (struct sockaddr *) &cliskt, &adrlen,
+                          SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (newuifd < 0) {
+            if (errno == EINTR)
+                continue;
+            if ((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != ECONNABORTED))
+                edlog(M_BADCONN, strerror(errno));
+            return;
+        }
 
-    /* We've accepted the connection.    Now get a UI structure. */
-    for (i = 0; i < MX_UI; i++) {
-        if (UiCons[i].fd == -1) {
-            break;
+        /* Only root and our own user may connect over the Unix socket */
+        cred.uid = (uid_t) -1;
+        if (srvfd == unixfd) {
+            adrlen = (socklen_t) sizeof(struct ucred);
+            if ((getsockopt(newuifd, SOL_SOCKET, SO_PEERCRED, &cred, &adrlen) < 0) ||
+                ((cred.uid != 0) && (cred.uid != geteuid()))) {
+                (void) snprintf(cuid, sizeof(cuid), "%d", (int) cred.uid);
+                edlog(M_BADPEER, cuid);
+                close(newuifd);
+                continue;
+            }
+        }
+
+        /* Shed new connections when the loop is far behind */
+        if (Overload >= OVL_REFUSE) {
+            OvlRefused++;
+            close(newuifd);
+            continue;
         }
-    }
-    if ((i == MX_UI) && (nui >= MX_UI)) {
-        /* Oops, out of UI conns.  Log it and close the new conn */
-        edlog(M_NOUI);
-        close(newuifd);
-        return;
-    }
-    nui++;       /* increment number of UI structs alloc'ed */
-    listen(srvfd, MX_UI - nui);  //  lower the number of avail conns
 
-    /* OK, we've got the UI struct.  Fill it in.    */
-    UiCons[i].fd = newuifd;
-    flags = fcntl(UiCons[i].fd, F_GETFL, 0);
-    flags |= O_NONBLOCK;
-    (void) fcntl(UiCons[i].fd, F_SETFL, flags);
-    UiCons[i].o_ip = (int) cliskt.sin_addr.s_addr;
-    UiCons[i].o_port = (int) ntohs(cliskt.sin_port);
-    UiCons[i].cmdindx = 0;
-    UiCons[i].bkey = 0;    // not watching inputs/sensors
+        /* We've accepted the connection.    Now get a UI structure. */
+        for (i = 0; i < MX_UI; i++) {
+            if (UiCons[i].fd == -1) {
+                break;
+            }
+        }
+        if (i == MX_UI) {
+            /* Oops, out of UI conns.  Log it and close the new conn */
+            edlog(M_NOUI);
+            close(newuifd);
+            continue;
+        }
+        nui++;       /* increment number of UI structs alloc'ed */
+
+        /* OK, we've got the UI struct.  Fill it in.    */
+        UiCons[i].fd = newuifd;
+        if (srvfd == unixfd) {
+            UiCons[i].o_ip = 0;
+            UiCons[i].o_port = 0;
+            UiCons[i].o_uid = (int) cred.uid;
+        }
+        else {
+            UiCons[i].o_ip = (int) cliskt.sin_addr.s_addr;
+            UiCons[i].o_port = (int) ntohs(cliskt.sin_port);
+            UiCons[i].o_uid = -1;
+        }
+        ed_line_init(&(UiCons[i].cmdbuf), UiCons[i].cmd, MXCMD, 0);
+        UiCons[i].bkey = 0;    // not watching inputs/sensors
+        UiCons[i].proto = ED_PROTO_ASCII;  // ASCII until an edproto command
+        UiCons[i].txseq = 0;
+        UiCons[i].tag = 0;
+        UiCons[i].otag = 0;
+        UiCons[i].catseq = 0;
+        UiCons[i].olen = 0;
+        UiCons[i].wpend = 0;
+        memset(&(UiCons[i].stats), 0, sizeof(ED_UISTAT));
+        UiCons[i].stats.t_open = now_us();
+        UiCons[i].stats.t_last = UiCons[i].stats.t_open;
+        UiCons[i].credit = 0;  // full burst at the first command
+        UiCons[i].t_fill = 0;
+        UiCons[i].throttled = 0;
+        UiCons[i].prio = ED_PRIO_NORMAL;
+        UiCons[i].t_defer = 0;
+        memset(&(UiCons[i].http), 0, sizeof(ED_HTTP));
+        if (srvfd == httpfd) {
+            UiCons[i].proto = ED_PROTO_HTTP;
+        }
 
-    /* add the new UI conn to the read fd_set in the select loop */
-    add_fd(newuifd, ED_READ, receive_ui, (void *) 0);
+        /* Replies are coalesced into one write per pass of the select
+         * loop so there is no reason to let Nagle hold them back. */
+        if (srvfd != unixfd) {
+            (void) setsockopt(newuifd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        }
 
-    return;
+        /* add the new UI conn to the read fd_set in the select loop */
+        add_fd(newuifd, ED_READ, receive_ui, (void *) 0);
+    }
 }
 
 
@@ -598,11 +2166,36 @@ void open_ui_conn(int srvfd, int cb_data)
  ***************************************************************************/
 void close_ui_conn(int cn)
 {
+    int      bkey;        // resource the UI was watching
+    int      i;
+
+    // Forget any reads the UI was waiting on.  A late reply to a read
+    // in progress goes nowhere instead of to a new UI with the same cn.
+    for (i = 0; i < MX_WAIT; i++) {
+        if (Waits[i].cn != cn)
+            continue;
+        if ((Waits[i].active) &&
+            (RSCPTR(&(Slots[Waits[i].slot]), Waits[i].rsc)->uilock == cn))
+            RSCPTR(&(Slots[Waits[i].slot]), Waits[i].rsc)->uilock = -1;
+        Waits[i].cn = -1;
+    }
     close(UiCons[cn].fd);
     del_fd(UiCons[cn].fd);
     UiCons[cn].fd = -1;
+    // The resource the UI was watching may have no listeners now
+    if (UiCons[cn].bkey != 0) {
+        bkey = UiCons[cn].bkey;
+        UiCons[cn].bkey = 0;
+        unwatch_rsc(bkey);
+    }
+    UiCons[cn].olen = 0;
+    UiCons[cn].wpend = 0;
+    free(UiCons[cn].obuf);
+    UiCons[cn].obuf = (char *) 0;
+    UiCons[cn].osize = 0;
+    UiCons[cn].http.close = 0;
+    UiCons[cn].throttled = 0;
     nui--;
-    listen(srvfd, MX_UI - nui);  //  lower the number of avail conns
     return;
 }
 
@@ -620,32 +2213,93 @@ void open_ui_port()
 {
     struct sockaddr_in srvskt;
     int      adrlen;
-    int      flags;
+    int      on = 1;
 
     adrlen = sizeof(struct sockaddr_in);
     (void) memset((void *) &srvskt, 0, (size_t) adrlen);
     srvskt.sin_family = AF_INET;
     srvskt.sin_addr.s_addr = (UiaddrAny) ? htonl(INADDR_ANY) : htonl(INADDR_LOOPBACK);
     srvskt.sin_port = htons(UiPort);
-    if ((srvfd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0) {
-        edlog(M_BADCONN, errno);
+    if ((srvfd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0)) < 0) {
+        edlog(M_BADCONN, strerror(errno));
         return;
     }
-    flags = fcntl(srvfd, F_GETFL, 0);
-    flags |= O_NONBLOCK;
-    (void) fcntl(srvfd, F_SETFL, flags);
+    // Let several daemons or loops share the port if asked
+    if ((UiReusePort) &&
+        (setsockopt(srvfd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) < 0)) {
+        edlog(M_BADCONN, strerror(errno));
+    }
     if (bind(srvfd, (struct sockaddr *) &srvskt, adrlen) < 0) {
-        edlog(M_BADCONN, errno);
+        edlog(M_BADCONN, strerror(errno));
         return;
     }
-    if (listen(srvfd, MX_UI - nui) < 0) {
-        edlog(M_BADCONN, errno);
+    // The backlog is fixed.  open_ui_conn() turns away extra UIs.
+    if (listen(srvfd, UI_BACKLOG) < 0) {
+        edlog(M_BADCONN, strerror(errno));
         return;
     }
 
     /* If we get to here, then we were able to open the UI socket. Tell the
      * select loop about it. */
     add_fd(srvfd, ED_READ, open_ui_conn, (void *) 0);
+
+    /* Local clients can avoid TCP by using a Unix socket */
+    if (UiPath != 0) {
+        open_ui_unix();
+    }
+
+    /* Browsers and dashboards use HTTP on their own port */
+    if (HttpPort != 0) {
+        open_http_port();
+    }
+
+    /* Idle UIs are closed if the user sets a limit with 'edset 0 limits' */
+    (void) add_timer(ED_PERIODIC, UI_IDLECHK, check_idle, (void *) 0);
+    (void) add_timer(ED_PERIODIC, UI_RSPCHK, check_rsp, (void *) 0);
+}
+
+
+/***************************************************************************
+ * open_ui_unix(): - Open the Unix domain socket for UI connections.
+ * A path that starts with '@' is a name in the abstract namespace and
+ * does not appear in the file system.  Connections are handled by
+ * open_ui_conn() and receive_ui() just as for TCP.
+ ***************************************************************************/
+static void open_ui_unix()
+{
+    struct sockaddr_un srvskt;
+    int      adrlen;
+    int      len;
+
+    len = strlen(UiPath);
+    if (len >= (int) sizeof(srvskt.sun_path)) {
+        edlog(M_BADPORT, UiPath, "path too long");
+        return;
+    }
+    (void) memset((void *) &srvskt, 0, sizeof(struct sockaddr_un));
+    srvskt.sun_family = AF_UNIX;
+    if (UiPath[0] == '@') {
+        // Abstract name.  The sun_path starts with a null.
+        memcpy(&(srvskt.sun_path[1]), &(UiPath[1]), len - 1);
+    }
+    else {
+        memcpy(srvskt.sun_path, UiPath, len);
+        (void) unlink(UiPath);    // remove a socket left from an earlier run
+    }
+    adrlen = offsetof(struct sockaddr_un, sun_path) + len;
+
+    if ((unixfd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0)) < 0) {
+        edlog(M_BADCONN, strerror(errno));
+        return;
+    }
+    if ((bind(unixfd, (struct sockaddr *) &srvskt, adrlen) < 0) ||
+        (listen(unixfd, UI_BACKLOG) < 0)) {
+        edlog(M_BADCONN, strerror(errno));
+        close(unixfd);
+        unixfd = -1;
+        return;
+    }
+    add_fd(unixfd, ED_READ, open_ui_conn, (void *) 0);
 }
 
 /***************************************************************************
@@ -667,6 +2321,7 @@ int add_so(
     for (i = 0; i < MX_PLUGIN; i++) {
         if (strnlen(Slots[i].soname, MX_SONAME) == 0) {
             strncpy(Slots[i].soname, so_name, MX_SONAME);
+            (void) thr_parse(i, Slots[i].soname);  // strips any @thread
             return(i);
         }
     }
@@ -684,10 +2339,12 @@ void initslot(                          // Load and init this slot
 {
     void          *handle;
     int          (*Initialize) (SLOT *);
+    Dl_info        info;  // where the .so is loaded
     char           pluginpath[PATH_MAX]; // Has full name of the .so file
     int            i;
     int            k;  // used to build slot paths
     const char    *errmsg;
+    long long      t0; // when the load started
 
     // Ignore uninitialized slots
     if (pslot->soname[0] == (char) 0)
@@ -704,13 +2361,17 @@ void initslot(                          // Load and init this slot
             pslot->slot_id);
     }
 
-    // Try to open the .so file.
+    // Try to open the .so file.  Plug-ins starting at the same time
+    // are loaded at once and take the start lock for the rest.
+    t0 = now_us();
     dlerror();                  /* Clear any existing error */
     handle = dlopen(pluginpath, RTLD_NOW | RTLD_GLOBAL);
+    start_lock();
     pslot->handle = handle;
     if (handle == NULL) {
         edlog(M_BADSO, pluginpath);
         pslot->soname[0] = (char) 0;  // void this bogus plug-in entry
+        start_unlock();
         return;
     }
 
@@ -721,14 +2382,559 @@ void initslot(                          // Load and init this slot
     if (errmsg != NULL) {
         edlog(M_BADSYMB, "'Initialize'", pslot->soname);
         pslot->soname[0] = (char) 0;  // void this bogus plug-in entry
+        start_unlock();
         return;
     }
 
-    if (Initialize(pslot) < 0) {
+    // FDs, timers, and subscriptions with callbacks in the .so belong
+    // to this slot.  See so_owner().
+    if (dladdr(*(void **) (&Initialize), &info) != 0)
+        sobase[pslot->slot_id] = info.dli_fbase;
+
+    // Wait for the plug-ins named in its Depends string, if any
+    start_deps(pslot, handle);
+
+    // A plug-in loaded with @thread adds its FDs and timers to the loop
+    // of its thread, which starts once Initialize() returns
+    if (thr_init(pslot) < 0) {
+        pslot->soname[0] = (char) 0;  // void this bogus plug-in entry
+        start_unlock();
+        return;
+    }
+    initing = pslot;
+    start_unlock();
+    i = Initialize(pslot);
+    start_lock();
+    initing = (SLOT *) NULL;
+    thr_start(pslot, (i >= 0));
+    start_time(pslot, now_us() - t0);
+    if (i < 0) {
         edlog(M_BADDRIVER, pslot->soname);
         pslot->soname[0] = (char) 0;  // void this bogus plug-in entry
+        start_unlock();
+        return;
+    }
+
+    // Add the plug-in name and its resources to the name index
+    start_done(pslot);
+    index_names();
+    start_unlock();
+}
+
+
+/***************************************************************************
+ * so_owner(): - Return the slot of the plug-in whose .so holds the
+ * given function, or 0 if the function is in the daemon.  The daemon
+ * uses this to know which plug-in added each FD, timer, and
+ * subscription so it can remove them when the plug-in is unloaded.
+ ***************************************************************************/
+int so_owner(
+    void   (*fn) ())      // a callback
+{
+    Dl_info  info;        // the object holding fn
+    int      i;
+
+    if ((fn == 0) || (dladdr(*(void **) (&fn), &info) == 0))
+        return(0);
+    for (i = 1; i < MX_PLUGIN; i++) {
+        if ((Slots[i].handle != 0) && (sobase[i] == info.dli_fbase))
+            return(i);
+    }
+    return(0);
+}
+
+
+/***************************************************************************
+ * ed_add_rsc(): - Add a resource to a slot.  Free entries in rsc[] are
+ * used first.  After that the resource goes in xrsc, which starts at
+ * MX_XRSC0 entries and doubles when full.  Growing xrsc moves the
+ * resources in it, so resources may only be added while the plug-in's
+ * Initialize() runs and before the daemon or a UI holds pointers to
+ * them.  Returns the index of the resource or -1 if the name is in use,
+ * there is no memory for it, or Initialize() has returned.
+ ***************************************************************************/
+int ed_add_rsc(
+    SLOT    *pslot,       // the plug-in's slot
+    char    *name,        // name of the resource
+    int      flags,       // IS_READABLE, IS_WRITABLE, CAN_BROADCAST
+    void   (*pgscb) ())   // get/set/cat callback
+{
+    RSC     *prsc;        // the new resource
+    RSC     *pnew;        // xrsc after it grows
+    int      irsc;        // index of the new resource
+    int      nx;          // number of resources in xrsc
+    int      i;
+
+    // Resources are added from Initialize(), on the thread running it
+    if ((pslot == 0) || (name == 0) || (pslot != initing))
+        return(-1);
+    start_lock();
+    irsc = -1;
+    for (i = 0; i < pslot->nrsc; i++) {
+        prsc = RSCPTR(pslot, i);
+        if ((prsc->name != 0) && (!strcmp(prsc->name, name))) {
+            start_unlock();
+            return(-1);
+        }
+        if ((prsc->name == 0) && (irsc < 0) && (i < MX_RSC))
+            irsc = i;
+    }
+    if (irsc < 0) {
+        if (pslot->nrsc >= MX_NRSC) {
+            edlog(M_NOMEM, "ed_add_rsc");
+            start_unlock();
+            return(-1);
+        }
+        // xrsc is full when it holds MX_XRSC0 times a power of two
+        nx = pslot->nrsc - MX_RSC;
+        if ((nx == 0) || ((nx >= MX_XRSC0) && ((nx & (nx - 1)) == 0))) {
+            pnew = realloc(pslot->xrsc, ((nx == 0) ? MX_XRSC0 : (2 * nx)) * sizeof(RSC));
+            if (pnew == 0) {
+                edlog(M_NOMEM, "ed_add_rsc");
+                start_unlock();
+                return(-1);
+            }
+            pslot->xrsc = pnew;
+        }
+        irsc = pslot->nrsc++;
+    }
+
+    prsc = RSCPTR(pslot, irsc);
+    prsc->name   = name;
+    prsc->pgscb  = pgscb;
+    prsc->slot   = (void *) pslot;
+    prsc->bkey   = 0;
+    prsc->uilock = -1;
+    prsc->flags  = flags;
+    prsc->dpriv  = (void *) NULL;
+
+    // initslot() indexes the names after Initialize() returns
+    start_unlock();
+    return(irsc);
+}
+
+
+/***************************************************************************
+ * do_unload(): - Unload the plug-in in a slot, or unload it and load
+ * its .so file again.  The plug-in's Finalize() is called if it has
+ * one.  A plug-in loaded with @thread calls Finalize() on its thread
+ * as the thread stops, and the unload is finished by unload_slot()
+ * when the thread is done.  The UI gets its prompt then.
+ ***************************************************************************/
+static void do_unload(
+    UI      *pui,         // UI giving the command
+    char    *cslot,       // slot number or plug-in name
+    int      reload)      // set to load the .so again
+{
+    SLOT    *pslot;       // the slot to unload
+    ED_UNLOAD *pu;        // the unload in progress
+    void   (*Finalize) (SLOT *);
+    char     rply[MXRPLY]; // error messages
+    int      islot;       // slot to unload
+    int      len;
+
+    islot = (cslot) ? find_slot(cslot) : -1;
+    if ((islot <= 0) || (Slots[islot].handle == 0)) {
+        // Slot 0 is the daemon and can not be unloaded
+        cslot = (cslot) ? cslot : "(null)";
+        len = snprintf(rply, sizeof(rply), (isdigit(cslot[0]) ? E_BDSLOT : E_NOPERI), cslot);
+        send_ui(rply, len, pui->cn);
+        prompt(pui->cn);
+        return;
+    }
+    pslot = &(Slots[islot]);
+    pu = &(Unloads[islot]);
+    if (pu->active) {
+        // Its thread is still stopping from an earlier unload
+        len = snprintf(rply, sizeof(rply), E_BUSY, pslot->name);
+        send_ui(rply, len, pui->cn);
+        prompt(pui->cn);
+        return;
+    }
+    pu->active = 1;
+    pu->reload = reload;
+    pu->cn = pui->cn;
+    pu->tag = pui->tag;
+    pu->t_open = pui->stats.t_open;
+
+    // Let the plug-in clean up.  The thread of a plug-in loaded with
+    // @thread calls Finalize as it stops and then calls unload_slot().
+    if (thr_stop(islot) == 0)
         return;
+    dlerror();
+    *(void **) (&Finalize) = dlsym(pslot->handle, "Finalize");
+    if ((dlerror() == NULL) && (Finalize != 0))
+        Finalize(pslot);
+    unload_slot(islot);
+    return;
+}
+
+
+/***************************************************************************
+ * unload_slot(): - Finish unloading a plug-in after its Finalize() has
+ * run.  Requests it has not finished fail, the FDs, timers, and
+ * subscriptions it added are removed, and the .so is closed.
+ *   A reload keeps each resource that has the same name in the same
+ * place after the reload.  UIs watching it, plug-ins subscribed to
+ * it, and its rings, history, and multicast group stay attached.
+ * A resource that is gone takes these with it, as do all of the
+ * resources of an unloaded plug-in.  The UI that gave the command gets
+ * its prompt if it is still connected.
+ ***************************************************************************/
+void unload_slot(
+    int      islot)       // slot to unload
+{
+    SLOT    *pslot;       // the slot to unload
+    ED_UNLOAD *pu;        // the unload in progress
+    UI      *pui;         // UI that gave the command
+    RSC     *prsc;        // a resource of the slot
+    ED_RSC  *ped;         // daemon state given to it by the new .so
+    char   (*oname)[MX_SONAME]; // names of the resources before
+    int     *obkey;       // broadcast keys before
+    ED_RSC **opriv;       // daemon state before
+    int      onrsc;       // number of resources before
+    int      reload;      // set to load the .so again
+    char     rply[MXRPLY]; // EDCAT replies
+    int      ocn;         // UI being parsed when called
+    int      otag;        // its request ID
+    int      cn;          // a UI watching a resource that is gone
+    int      len;
+    int      i;
+
+    pslot = &(Slots[islot]);
+    pu = &(Unloads[islot]);
+    reload = pu->reload;
+    onrsc = pslot->nrsc;
+    oname = malloc(onrsc * sizeof(*oname));
+    obkey = malloc(onrsc * sizeof(int));
+    opriv = malloc(onrsc * sizeof(ED_RSC *));
+    if ((oname == 0) || (obkey == 0) || (opriv == 0)) {
+        // Unload without keeping any resource across a reload
+        edlog(M_NOMEM, "unload_slot");
+        free(oname);
+        free(obkey);
+        free(opriv);
+        oname = (char (*)[MX_SONAME]) 0;
+        obkey = (int *) 0;
+        opriv = (ED_RSC **) 0;
+        reload = 0;
+    }
+
+    // Drop what the plug-in left behind
+    fail_waits(islot);
+    del_owned(islot);
+    unsub_slot(islot, 0);
+    for (i = 0; i < onrsc; i++) {
+        prsc = RSCPTR(pslot, i);
+        if (oname != 0) {
+            oname[i][0] = (char) 0;
+            if (prsc->name)
+                (void) strncpy(oname[i], prsc->name, MX_SONAME - 1);
+            oname[i][MX_SONAME - 1] = (char) 0;
+            obkey[i] = prsc->bkey;
+            opriv[i] = (ED_RSC *) prsc->dpriv;
+        }
+        else {
+            // The resource is gone
+            rscfree((ED_RSC *) prsc->dpriv);
+            unsub_slot(0, MKHANDLE(islot, i));
+            for (cn = 0; cn < MX_UI; cn++) {
+                if (UiCons[cn].bkey == MKHANDLE(islot, i))
+                    UiCons[cn].bkey = 0;
+            }
+        }
+        prsc->name   = (char *) NULL;
+        prsc->pgscb  = NULL;
+        prsc->slot   = (void *) NULL;
+        prsc->bkey   = 0;
+        prsc->uilock = -1;
+        prsc->flags  = 0;
+        prsc->dpriv  = (void *) NULL;
+    }
+    free(pslot->xrsc);
+    pslot->xrsc = (RSC *) NULL;
+    pslot->nrsc = MX_RSC;
+    (void) dlclose(pslot->handle);
+    sobase[islot] = (void *) 0;
+    pslot->handle = (void *) NULL;
+    pslot->name   = (char *) NULL;
+    pslot->desc   = (char *) NULL;
+    pslot->help   = (char *) NULL;
+    pslot->priv   = (void *) NULL;
+    if (reload)
+        initslot(pslot);   // clears soname if the load fails
+    else
+        pslot->soname[0] = (char) 0;
+
+    for (i = 0; (oname != 0) && (i < onrsc); i++) {
+        prsc = (i < pslot->nrsc) ? RSCPTR(pslot, i) : (RSC *) NULL;
+        if ((pslot->soname[0] != (char) 0) && (prsc != 0) && (prsc->name != 0) &&
+            (oname[i][0] != (char) 0) && (!strcmp(prsc->name, oname[i]))) {
+            // Same resource.  Keep its state but not a value cached
+            // from the old code.
+            if (opriv[i]) {
+                ped = (ED_RSC *) prsc->dpriv;
+                if (ped) {
+                    opriv[i]->maxage = ped->maxage;
+                    rscfree(ped);
+                }
+                opriv[i]->ctime = 0;
+                opriv[i]->told = 0;
+                prsc->dpriv = opriv[i];
+            }
+            if ((obkey[i] != 0) && (prsc->flags & CAN_BROADCAST)) {
+                watch_rsc(prsc, obkey[i]);
+                if (prsc->pgscb) {
+                    len = sizeof(rply);
+                    (prsc->pgscb)(EDCAT, i, (char *) 0, pslot, UI_BATCH, &len, rply);
+                }
+            }
+            continue;
+        }
+        // The resource is gone
+        rscfree(opriv[i]);
+        unsub_slot(0, MKHANDLE(islot, i));
+        for (cn = 0; cn < MX_UI; cn++) {
+            if (UiCons[cn].bkey == MKHANDLE(islot, i))
+                UiCons[cn].bkey = 0;
+        }
+    }
+    free(oname);
+    free(obkey);
+    free(opriv);
+    index_names();
+
+    // Prompt the UI that asked if it is still connected
+    pu->active = 0;
+    pui = ((pu->cn >= 0) && (pu->cn < MX_UI)) ? &(UiCons[pu->cn]) : (UI *) 0;
+    if ((pui != 0) && (pui->fd >= 0) && (pui->stats.t_open == pu->t_open)) {
+        ocn = parsecn;
+        otag = pui->tag;
+        parsecn = pu->cn;
+        pui->tag = pu->tag;
+        prompt(pu->cn);
+        pui->tag = otag;
+        parsecn = ocn;
+    }
+    return;
+}
+
+
+/***************************************************************************
+ * fail_waits(): - Give a no response error to each get and set waiting
+ * on a plug-in that is being unloaded.  This includes the requests still
+ * in the queue of a plug-in thread when it stopped.
+ ***************************************************************************/
+static void fail_waits(
+    int      islot)       // slot of the plug-in
+{
+    ED_WAIT *pw;          // a waiting request
+    RSC     *prsc;        // its resource
+    char     rply[MXRPLY]; // the error
+    int      savecn;      // UI whose command is being executed
+    int      savetag;     // request ID of the waiting UI's command
+    int      cn;          // the waiting UI
+    int      len;
+    int      i;
+
+    savecn = parsecn;
+    for (i = 0, pw = Waits; i < MX_WAIT; i++, pw++) {
+        if ((pw->cn == -1) || (pw->slot != islot))
+            continue;
+        prsc = RSCPTR(&(Slots[islot]), pw->rsc);
+        if (pw->cn >= MX_UI) {
+            // A batch read goes to no UI
+            prsc->uilock = (prsc->uilock == pw->cn) ? -1 : prsc->uilock;
+            pw->cn = -1;
+            continue;
+        }
+        // Reply as if this request were being parsed to get its tag.
+        // ed_fail() clears the wait so keep its cn.
+        cn = pw->cn;
+        parsecn = cn;
+        savetag = UiCons[cn].tag;
+        UiCons[cn].tag = pw->tag;
+        if (pw->active == WT_PENDING) {
+            ed_fail(pw->req, prsc);
+        }
+        else {
+            // A queued read, or one the plug-in would answer itself
+            len = snprintf(rply, sizeof(rply), E_NORSP, prsc->name);
+            send_ui(rply, len, cn);
+            prompt(cn);
+        }
+        UiCons[cn].tag = savetag;
+        pw->cn = -1;
+    }
+    parsecn = savecn;
+    return;
+}
+
+
+/***************************************************************************
+ * hashname(): - FNV-1a hash of a name.  Resource names are mixed with
+ * their slot ID so the same name in different slots hash differently.
+ ***************************************************************************/
+static unsigned int hashname(
+    int      islot,       // slot of a resource name or -1 for plug-in names
+    char    *name)        // name to hash
+{
+    unsigned int hash = 2166136261u;
+
+    while (*name) {
+        hash = (hash ^ (unsigned char) *name++) * 16777619u;
+    }
+    return(hash ^ ((unsigned int) (islot + 1) * 2654435761u));
+}
+
+
+/***************************************************************************
+ * index_names(): - Rebuild the hash index of plug-in and resource
+ * names.  This is done when a plug-in is loaded.  Plug-in names are
+ * added in slot order so a name used by two plug-ins finds the first.
+ * While the plug-ins start, slots still in Initialize() are skipped
+ * since their resources may be changing.  Each is added when it is
+ * done.
+ ***************************************************************************/
+void index_names()
+{
+    ED_NAME *pn;          // entry in the index
+    char    *name;        // name to add
+    int      islot;       // slot being indexed
+    int      irsc;        // resource being indexed, -1 for the plug-in
+    unsigned int hash;    // hash of name
+    ED_NAME *pnew;        // larger index
+    int      count = 0;   // names to index
+    int      nused = 0;   // entries filled in the index
+    int      size;        // entries needed in the index
+    int      i;
+
+    // Keep the index at most half full so probes stay short
+    for (islot = 0; islot < MX_PLUGIN; islot++) {
+        if ((start_ready(islot)) && (Slots[islot].name != 0))
+            count += 1 + Slots[islot].nrsc;
+    }
+    for (size = NNames; size < 2 * count; size *= 2)
+        ;
+    if (size != NNames) {
+        pnew = realloc(Names, size * sizeof(ED_NAME));
+        if (pnew == 0) {
+            edlog(M_NOMEM, "index_names");
+        }
+        else {
+            Names = pnew;
+            NNames = size;
+        }
+    }
+    for (i = 0; i < NNames; i++) {
+        Names[i].slot = -1;
+    }
+
+    for (islot = 0; islot < MX_PLUGIN; islot++) {
+        if ((!start_ready(islot)) || (Slots[islot].name == 0))
+            continue;
+        for (irsc = -1; irsc < Slots[islot].nrsc; irsc++) {
+            name = (irsc < 0) ? Slots[islot].name : RSCPTR(&(Slots[islot]), irsc)->name;
+            if ((name == 0) || (find_name(((irsc < 0) ? -1 : islot), name) >= 0))
+                continue;       // no name or name is already in the index
+            if (++nused >= NNames)
+                return;         // could not grow, leave a free entry for lookups
+            hash = hashname(((irsc < 0) ? -1 : islot), name);
+            // Linear probe for a free entry.  The table is never full.
+            for (i = hash & (NNames - 1); Names[i].slot != -1; i = (i + 1) & (NNames - 1))
+                ;
+            pn = &(Names[i]);
+            pn->slot = islot;
+            pn->rsc  = irsc;
+            pn->hash = hash;
+        }
+    }
+    return;
+}
+
+
+/***************************************************************************
+ * find_name(): - Look up a name in the name index.  Give a slot ID of
+ * -1 to find the slot of a plug-in name, or give a slot ID to find the
+ * index of a resource in that slot.  Returns -1 if the name is not found.
+ ***************************************************************************/
+int find_name(
+    int      islot,       // slot of the resource or -1 for a plug-in name
+    char    *name)        // name to find
+{
+    ED_NAME *pn;          // entry in the index
+    char    *nm;          // name at the entry
+    unsigned int hash;    // hash of name
+    int      i;
+
+    hash = hashname(islot, name);
+    for (i = hash & (NNames - 1); Names[i].slot != -1; i = (i + 1) & (NNames - 1)) {
+        pn = &(Names[i]);
+        if ((pn->hash != hash) || ((islot < 0) != (pn->rsc < 0)))
+            continue;
+        if ((islot >= 0) && (pn->slot != islot))
+            continue;
+        nm = (pn->rsc < 0) ? Slots[pn->slot].name : RSCPTR(&(Slots[pn->slot]), pn->rsc)->name;
+        if ((nm != 0) && (!strcmp(nm, name)))
+            return((islot < 0) ? pn->slot : pn->rsc);
+    }
+    return(-1);
+}
+
+
+/***************************************************************************
+ * find_handle(): - Return the slot ID of a handle from edresolve, given
+ * as @<handle>, and put the resource index in *pirsc.  Returns -1 if
+ * the handle does not name a resource.
+ ***************************************************************************/
+static int find_handle(
+    char    *chndl,       // the handle as @<handle>
+    int     *pirsc)       // where to put the resource index
+{
+    int      handle;      // the handle as an int
+
+    if ((sscanf(&chndl[1], "%d", &handle) != 1) || (handle < 0) ||
+        (HANDLE2SLOT(handle) >= MX_PLUGIN) || (HANDLE2RSC(handle) >= Slots[HANDLE2SLOT(handle)].nrsc) ||
+        (RSCPTR(&(Slots[HANDLE2SLOT(handle)]), HANDLE2RSC(handle))->name == 0))
+        return(-1);
+    *pirsc = HANDLE2RSC(handle);
+    return(HANDLE2SLOT(handle));
+}
+
+
+/***************************************************************************
+ * find_slot(): - Return the slot ID given a slot number or plug-in name.
+ * A name not in the name index is taken as an abbreviation if it is
+ * the start of exactly one plug-in name.  Returns -1 if there is no
+ * such slot.
+ ***************************************************************************/
+int find_slot(
+    char    *cslot)       // slot number or plug-in name
+{
+    int      islot;       // slot ID to return
+    int      len;         // length of cslot
+    int      i;
+
+    if (isdigit(cslot[0])) {
+        if ((sscanf(cslot, "%d", &islot) != 1) || (islot < 0) || (islot >= MX_PLUGIN))
+            return(-1);
+        return(islot);
+    }
+
+    islot = find_name(-1, cslot);
+    if (islot >= 0) {
+        return(islot);
+    }
+
+    len = strlen(cslot);
+    for (i = 0; i < MX_PLUGIN; i++) {
+        if ((Slots[i].name == 0) || (strncmp(Slots[i].name, cslot, len)))
+            continue;
+        if (islot >= 0)
+            return(-1);     // ambiguous abbreviation
+        islot = i;
     }
+    return(islot);
 }
 
 
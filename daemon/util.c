@@ -24,6 +24,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <unistd.h>
 #include <syslog.h>
 #include <stdarg.h>      // for va_arg
 #include <sys/time.h>    // for gettimeofday
@@ -37,24 +38,30 @@
 /***************************************************************************
  *  - Statically allocated variables and arrays
  ***************************************************************************/
-int      fdcount;      // Number open file descriptors
-int      mxfd;         // Highest numbered FD
-fd_set   gRfds;        // read FDs
-fd_set   gWfds;        // write FDs
-fd_set   gXfds;        // exception FDs
-int      ntimers = 0;  // number of timers in use
+extern ED_FD     Ed_Fd[];   // Array of open FDs and callbacks
+extern ED_TIMER  Timers[];  // Array of timers and callbacks
+ED_LOOP  MainLoop = { Ed_Fd, MX_FD, Timers, MX_TIMER, 0, 0, -1 };
+long long LoopLag = 0; // most lateness of a timer since the last load check
+int      LoopReady = 0; // most FDs ready in one select since the last check
 
 
 /***************************************************************************
  *  - Forward references
  ***************************************************************************/
-static void      update_fdsets(); // set fd_set before use by select()
-struct timeval  *doTimer();
+static void      update_fdsets(ED_LOOP *); // set fd_set before use by select()
+struct timeval  *doTimer(ED_LOOP *);
+int              loop_select(ED_LOOP *, struct timeval *);
+static ED_LOOP  *cur_loop();
 static long long tv2us(struct timeval *);
+long long        now_us();
+void             del_owned(int);
 
 extern SLOT      Slots[];   // table of plug-in info
-extern ED_FD     Ed_Fd[];   // Array of open FDs and callbacks
-extern ED_TIMER  Timers[];  // Array of timers and callbacks
+extern int       service_ui(); // per loop UI work
+extern int       so_owner(void (*)());
+extern ED_LOOP  *thr_loop();
+extern void      start_lock();
+extern void      start_unlock();
 extern char     *CmdName;
 extern int       UseStderr;
 
@@ -66,57 +73,109 @@ extern int       UseStderr;
 void muxmain()
 {
     struct timeval *ptv;
-    fd_set   readset;
-    fd_set   writeset;
-    fd_set   exceptset;
-    ED_FD   *pin;
+    struct timeval  polltv; // zero timeout to poll the FDs
     int      sret;     // return value from select();
-    int      activity; // type of select activity (read,write,except)
+    long long now;     // time the loop starts
     int      i;
 
-    update_fdsets();
+    update_fdsets(&MainLoop);
 
-    while (1) {
-        // init the local fd sets from the global ones
-        memcpy(&readset, &gRfds, sizeof(fd_set));
-        memcpy(&writeset, &gWfds, sizeof(fd_set));
-        memcpy(&exceptset, &gXfds, sizeof(fd_set));
+    // Timers that came due while the plug-ins started are due now.  The
+    // time spent starting is not lag of the loop.
+    now = now_us();
+    for (i = 0; i < MX_TIMER; i++) {
+        if ((Timers[i].type != ED_UNUSED) && (Timers[i].to < now))
+            Timers[i].to = now;
+    }
 
+    while (1) {
         // Process timers
-        ptv = doTimer();
+        ptv = doTimer(&MainLoop);
+
+        // Let the UI reissue reads that were waiting on busy resources.
+        // Poll instead of blocking since the reads may have added timers.
+        // This is done before select() copies the fd sets since sending
+        // queued output may change which UIs are waiting to be writable.
+        if (service_ui()) {
+            polltv.tv_sec = 0;
+            polltv.tv_usec = 0;
+            ptv = &polltv;
+        }
 
         // wait for FD activity
-        sret = select(mxfd + 1, &readset, &writeset, &exceptset, ptv);
+        sret = loop_select(&MainLoop, ptv);
+        LoopReady = (sret > LoopReady) ? sret : LoopReady;
+    }
+}
 
-        if (sret < 0) {
-            // select error -- bail out on all but EINTR
-            if (errno != EINTR) {
-                edlog(strerror(errno));
-                exit(-1);
-            }
+
+/***************************************************************************
+ * loop_select(): - Wait up to *ptv for activity on the FDs of a loop,
+ * or forever if ptv is null, and do the callbacks of the FDs that are
+ * ready.  Returns the return value of select().
+ ***************************************************************************/
+int loop_select(
+    ED_LOOP *pl,        // the loop
+    struct timeval *ptv) // most time to wait
+{
+    fd_set   readset;
+    fd_set   writeset;
+    fd_set   exceptset;
+    ED_FD   *pin;
+    int      sret;     // return value from select();
+    int      activity; // type of select activity (read,write,except)
+    int      i;
+
+    // init the local fd sets from the loop's
+    memcpy(&readset, &(pl->rfds), sizeof(fd_set));
+    memcpy(&writeset, &(pl->wfds), sizeof(fd_set));
+    memcpy(&exceptset, &(pl->xfds), sizeof(fd_set));
+
+    sret = select(pl->mxfd + 1, &readset, &writeset, &exceptset, ptv);
+    if (sret < 0) {
+        // select error -- bail out on all but EINTR
+        if (errno != EINTR) {
+            edlog(strerror(errno));
+            exit(-1);
         }
+        return(sret);
+    }
 
-        // Walk the table of FDs looking for read,write,except activity
-        for (i = 0; i < MX_FD; i++) {
-            pin = &Ed_Fd[i];
-            if (pin < 0) {
-                continue;
-            }
-            activity = 0;
-            if (FD_ISSET(pin->fd, &readset)) {
-                activity = ED_READ;
-            }
-            if (FD_ISSET(pin->fd, &writeset)) {
-                activity |= ED_WRITE;
-            }
-            if (FD_ISSET(pin->fd, &exceptset)) {
-                activity |= ED_EXCEPT;
-            }
-            if ((activity != 0) && (pin->scb != NULL)) {
-                pin->scb(pin->fd, pin->pcb_data, activity);
-            }
+    // Walk the table of FDs looking for read,write,except activity
+    for (i = 0; i < pl->nfd; i++) {
+        pin = &(pl->fds[i]);
+        if (pin->fd < 0) {
+            continue;
+        }
+        activity = 0;
+        if (FD_ISSET(pin->fd, &readset)) {
+            activity = ED_READ;
+        }
+        if (FD_ISSET(pin->fd, &writeset)) {
+            activity |= ED_WRITE;
+        }
+        if (FD_ISSET(pin->fd, &exceptset)) {
+            activity |= ED_EXCEPT;
+        }
+        if ((activity != 0) && (pin->scb != NULL)) {
+            pin->scb(pin->fd, pin->pcb_data, activity);
         }
     }
+    return(sret);
+}
+
+
+/***************************************************************************
+ * cur_loop(): - Return the loop that FDs and timers added now belong
+ * to.  This is the daemon's loop except in a plug-in loaded with
+ * @thread, both while it runs and while it is initialized.
+ ***************************************************************************/
+static ED_LOOP *cur_loop()
+{
+    ED_LOOP *pl;        // loop of a plug-in thread
+
+    pl = thr_loop();
+    return((pl) ? pl : &MainLoop);
 }
 
 
@@ -129,6 +188,7 @@ void add_fd(
     void     (*scb) (), // activity callback
     void    *pcb_data)  // callback data 
 {
+    ED_LOOP *pl;        // loop to add the FD to
     ED_FD   *pinfo = 0;
     int      i;         // loop counter
 
@@ -138,14 +198,16 @@ void add_fd(
         return;
     }
 
-    // Find the first free entry in Ed_Fd
-    for (i = 0; i < MX_FD; i++) {
-        if (Ed_Fd[i].fd == -1) {
-            pinfo = &Ed_Fd[i];
+    // Find the first free entry in the loop's FDs
+    start_lock();
+    pl = cur_loop();
+    for (i = 0; i < pl->nfd; i++) {
+        if (pl->fds[i].fd == -1) {
+            pinfo = &(pl->fds[i]);
             break;
         }
     }
-    if (i == MX_FD) {
+    if (i == pl->nfd) {
         edlog(M_NOMOREFD);
         exit(-1);
     }
@@ -156,8 +218,36 @@ void add_fd(
     pinfo->stype = stype;
     pinfo->scb = scb;
     pinfo->pcb_data = pcb_data;
+    pinfo->owner = so_owner(scb);
 
-    update_fdsets();
+    update_fdsets(pl);
+    start_unlock();
+}
+
+
+/***************************************************************************
+ * mod_fd(): - change the type of activity to watch for on a file
+ * descriptor.  The FD keeps its place in the table.
+ ***************************************************************************/
+void mod_fd(
+    int      fd,        // FD to change
+    int      stype)     // OR of ED_READ, ED_WRITE, ED_EXCEPT
+{
+    ED_LOOP *pl;        // loop with the FD
+    int      i;         // loop counter
+
+    start_lock();
+    pl = cur_loop();
+    for (i = 0; i < pl->nfd; i++) {
+        if (pl->fds[i].fd == fd) {
+            pl->fds[i].stype = stype;
+            break;
+        }
+    }
+    update_fdsets(pl);
+    start_unlock();
+
+    return;
 }
 
 
@@ -167,16 +257,20 @@ void add_fd(
 void del_fd(
     int      fd)        // FD to delete
 {
+    ED_LOOP *pl;        // loop with the FD
     int      i;         // loop counter
 
     // Find the FD and mark the entry as unused.
-    for (i = 0; i < MX_FD; i++) {
-        if (Ed_Fd[i].fd == fd) {
-            Ed_Fd[i].fd = -1;
+    start_lock();
+    pl = cur_loop();
+    for (i = 0; i < pl->nfd; i++) {
+        if (pl->fds[i].fd == fd) {
+            pl->fds[i].fd = -1;
             break;
         }
     }
-    update_fdsets();
+    update_fdsets(pl);
+    start_unlock();
 
     return;
 }
@@ -185,29 +279,157 @@ void del_fd(
 /***************************************************************************
  * update_fdsets(): - refresh the list of read and write FDs
  ***************************************************************************/
-void update_fdsets()
+static void update_fdsets(
+    ED_LOOP *pl)        // loop to update
 {
+    ED_FD   *pfd;       // an FD of the loop
     int      i;         // loop counter
 
-    FD_ZERO(&gRfds);
-    FD_ZERO(&gWfds);
-    FD_ZERO(&gXfds);
-    fdcount = 0;
-    mxfd = -1;
+    FD_ZERO(&(pl->rfds));
+    FD_ZERO(&(pl->wfds));
+    FD_ZERO(&(pl->xfds));
+    pl->fdcount = 0;
+    pl->mxfd = -1;
 
-    for (i = 0; i < MX_FD; i++) {
-        if (Ed_Fd[i].fd == -1)
+    for (i = 0, pfd = pl->fds; i < pl->nfd; i++, pfd++) {
+        if (pfd->fd == -1)
             continue;
 
-        fdcount++;
-        mxfd = (Ed_Fd[i].fd > mxfd) ? Ed_Fd[i].fd : mxfd;
-        if ((Ed_Fd[i].stype & ED_READ) != 0)
-            FD_SET(Ed_Fd[i].fd, &gRfds);
-        if ((Ed_Fd[i].stype & ED_WRITE) != 0)
-            FD_SET(Ed_Fd[i].fd, &gWfds);
-        if ((Ed_Fd[i].stype & ED_EXCEPT) != 0)
-            FD_SET(Ed_Fd[i].fd, &gXfds);
+        pl->fdcount++;
+        pl->mxfd = (pfd->fd > pl->mxfd) ? pfd->fd : pl->mxfd;
+        if ((pfd->stype & ED_READ) != 0)
+            FD_SET(pfd->fd, &(pl->rfds));
+        if ((pfd->stype & ED_WRITE) != 0)
+            FD_SET(pfd->fd, &(pl->wfds));
+        if ((pfd->stype & ED_EXCEPT) != 0)
+            FD_SET(pfd->fd, &(pl->xfds));
+    }
+    return;
+}
+
+
+/***************************************************************************
+ * ed_line_init(): - Set up a line framer to use the given buffer.
+ ***************************************************************************/
+void ed_line_init(
+    ED_LINEBUF *plb,     // line framer to initialize
+    char    *buf,        // buffer for the framer to use
+    int      size,       // number of bytes in buf
+    int      flags)      // ED_LINE_CR to also end lines at '\r'
+{
+    plb->buf = buf;
+    plb->size = size;
+    plb->start = 0;
+    plb->scan = 0;
+    plb->end = 0;
+    plb->flags = flags;
+    plb->skip = 0;
+    return;
+}
+
+
+/***************************************************************************
+ * ed_line_room(): - Return where to put the next bytes read.  The
+ * partial line at the end of the buffer is moved to the front only
+ * when the buffer is full.  This keeps the copying to about one pass
+ * over the data no matter how many lines are in each read.
+ ***************************************************************************/
+char *ed_line_room(
+    ED_LINEBUF *plb,     // line framer
+    int     *proom)      // number of bytes that may be read
+{
+    if ((plb->end == plb->size) && (plb->start > 0)) {
+        (void) memmove(plb->buf, &(plb->buf[plb->start]), (plb->end - plb->start));
+        plb->scan -= plb->start;
+        plb->end -= plb->start;
+        plb->start = 0;
+    }
+    *proom = plb->size - plb->end;
+    return(&(plb->buf[plb->end]));
+}
+
+
+/***************************************************************************
+ * ed_line_added(): - Account for bytes read into the buffer.
+ ***************************************************************************/
+void ed_line_added(
+    ED_LINEBUF *plb,     // line framer
+    int      n)          // number of bytes read
+{
+    if (n > 0) {
+        plb->end += n;
+    }
+    return;
+}
+
+
+/***************************************************************************
+ * ed_line_next(): - Get the next complete line from the buffer.  Only
+ * the bytes not yet searched are scanned, and memchr() does the
+ * scanning.
+ ***************************************************************************/
+int ed_line_next(
+    ED_LINEBUF *plb,     // line framer
+    char   **pline)      // set to the start of the line
+{
+    char    *pscan;      // first byte to search
+    char    *peol;       // the end of the line
+    char    *pcr;        // a carriage return before peol
+    int      len;        // length of the line
+
+    while (1) {
+        pscan = &(plb->buf[plb->scan]);
+        peol = memchr(pscan, '\n', (plb->end - plb->scan));
+        if (plb->flags & ED_LINE_CR) {
+            pcr = memchr(pscan, '\r',
+                         ((peol) ? peol : &(plb->buf[plb->end])) - pscan);
+            peol = (pcr) ? pcr : peol;
+        }
+
+        if (peol == (char *) 0) {
+            plb->scan = plb->end;
+            if (plb->skip) {
+                // Still in a line that is too long.  Drop what we have.
+                plb->start = plb->scan = plb->end = 0;
+            }
+            else if ((plb->start == 0) && (plb->end == plb->size)) {
+                // The buffer is full and has no terminator
+                plb->start = plb->scan = plb->end = 0;
+                plb->skip = 1;
+                return(ED_LINE_LONG);
+            }
+            else if (plb->start == plb->end) {
+                // Everything is consumed.  Start over at the front.
+                plb->start = plb->scan = plb->end = 0;
+            }
+            return(ED_LINE_NONE);
+        }
+
+        *peol = (char) 0;
+        *pline = &(plb->buf[plb->start]);
+        len = (int) (peol - *pline);
+        plb->start = plb->scan = (int) (peol - plb->buf) + 1;
+        if (plb->skip) {
+            // This was the tail of a long line
+            plb->skip = 0;
+            continue;
+        }
+        return(len);
     }
+}
+
+
+/***************************************************************************
+ * ed_line_unget(): - Put back the line just returned by ed_line_next().
+ * Any terminator will do so a newline replaces the null.
+ ***************************************************************************/
+void ed_line_unget(
+    ED_LINEBUF *plb,     // line framer
+    char    *line,       // the line from ed_line_next()
+    int      len)        // its length
+{
+    line[len] = '\n';
+    plb->start = plb->scan = (int) (line - plb->buf);
     return;
 }
 
@@ -311,23 +533,22 @@ void edlog(
  *   Output a NULL timeval pointer if there are no timer or a
  * pointer to a valid timeval struct if there are timers.
  *
- * Input:        none
- * Output:       pointer to a timeval struct
+ * Input:        pointer to the loop with the timers
+ * Output:       pointer to a timeval struct in the loop
  * Effects:      none
  ***************************************************************************/
-struct timeval *doTimer()
+struct timeval *doTimer(
+    ED_LOOP *pl)        // loop with the timers
 {
+    ED_TIMER *pt;       // a timer of the loop
     struct timeval tv;  // timeval struct to hold "now"
     long long now;      // "now" in milliseconds since Epoch
     long long nextto;   // Next timeout
     int    i;           // loop counter
     int    count;       // how many timers we've checked
 
-    /* the following is the allocation for the tv used in select() */
-    static struct timeval select_tv;
-
     /* Just return if there are no timers in use */
-    if (ntimers == 0) {
+    if (pl->ntimers == 0) {
         return ((struct timeval *) 0);
     }
 
@@ -341,40 +562,44 @@ struct timeval *doTimer()
     /* Walk the array looking for timers with a timeout less than now */
     /* We can stop looking at timers when we've looked at ntimers of them */
     count = 0;
-    for (i = 0; i < MX_TIMER; i++) {
+    for (i = 0, pt = pl->timers; i < pl->ntimer; i++, pt++) {
         // Done if we've looked at all the timers
-        if (count == ntimers)
+        if (count == pl->ntimers)
             break;
 
         // Ignore unused timers
-        if (Timers[i].type == ED_UNUSED)
+        if (pt->type == ED_UNUSED)
             continue;
 
         // Found a timer in use
         count++;
 
         // Ignore if not expired
-        if (Timers[i].to > now)
+        if (pt->to > now)
             continue;
 
+        // How late the daemon's timers are is a measure of how busy
+        // its loop is
+        if (pl == &MainLoop)
+            LoopLag = ((now - pt->to) > LoopLag) ? (now - pt->to) : LoopLag;
 
         // Is it a PERIODIC timer ?
-        if (Timers[i].type == ED_PERIODIC) { /* Periodic, so reschedule */
-            (Timers[i].cb) ((void *) &Timers[i], Timers[i].pcb_data); /* Do the callback */
-            Timers[i].to += Timers[i].us;
-            if (Timers[i].to < now) { /* CPU hog made us miss a period? */
+        if (pt->type == ED_PERIODIC) { /* Periodic, so reschedule */
+            (pt->cb) ((void *) pt, pt->pcb_data); /* Do the callback */
+            pt->to += pt->us;
+            if (pt->to < now) { /* CPU hog made us miss a period? */
                 edlog(M_MISSTO, i);
-                Timers[i].to = now;
+                pt->to = now;
             }
         }
         else {             // must be a ONESHOT
-            if (Timers[i].cb == 0) {
+            if (pt->cb == 0) {
                 break;
             }
             else {
-                Timers[i].type = ED_UNUSED;
-                ntimers--;
-                (Timers[i].cb) ((void *) &Timers[i], Timers[i].pcb_data); // Do callback 
+                pt->type = ED_UNUSED;
+                pl->ntimers--;
+                (pt->cb) ((void *) pt, pt->pcb_data); // Do callback 
             }
         }
     }
@@ -385,24 +610,24 @@ struct timeval *doTimer()
        select timeval is based on the next timer timeout value. */
 
     // No timeout if no timers
-    if (ntimers == 0) {
+    if (pl->ntimers == 0) {
         return ((struct timeval *) 0);
     }
 
     // Walk the timer array again to find the nearest timeout
     nextto = -1;
     count = 0;
-    for (i = 0; i < MX_TIMER; i++) {
-        if (count == ntimers)
+    for (i = 0, pt = pl->timers; i < pl->ntimer; i++, pt++) {
+        if (count == pl->ntimers)
             break;
 
-        if (Timers[i].type == ED_UNUSED)
+        if (pt->type == ED_UNUSED)
             continue;
 
         count++;
 
-        if ((nextto == -1) || (Timers[i].to < nextto)) {
-            nextto = Timers[i].to;
+        if ((nextto == -1) || (pt->to < nextto)) {
+            nextto = pt->to;
         }
     }
     // Return null if no timers are set
@@ -415,9 +640,9 @@ struct timeval *doTimer()
     if ((nextto - now) < 0L) {     // next timeout is in the past (CPU hog?)
         nextto = now;
     }
-    select_tv.tv_sec = (nextto - now) / 1000000;
-    select_tv.tv_usec = (suseconds_t) ((nextto - now) % 1000000);
-    return (&select_tv);
+    pl->tv.tv_sec = (nextto - now) / 1000000;
+    pl->tv.tv_usec = (suseconds_t) ((nextto - now) % 1000000);
+    return (&(pl->tv));
 }
 
 
@@ -440,6 +665,8 @@ void *add_timer(        // address of timer struct allocated
     void    *pcb_data)  // callback data
 {
     struct timeval tv;  // timeval struct to hold "now"
+    ED_LOOP *pl;        // loop to add the timer to
+    ED_TIMER *pt;       // the new timer
     int      i;         // loop counter
 
     /* Sanity checks */
@@ -452,31 +679,37 @@ void *add_timer(        // address of timer struct allocated
         return ((ED_TIMER *) 0);
     }
 
+    /* Get "now" */
+    if (gettimeofday(&tv, 0)) {
+        // LOG(LOG_WARNING, TM, E_No_Date);
+        return ((ED_TIMER *) 0);
+    }
+
     // Walk the array of timers and find a free one
-    for (i = 0; i < MX_TIMER; i++) {
-        if (Timers[i].type == ED_UNUSED)
+    start_lock();
+    pl = cur_loop();
+    for (i = 0; i < pl->ntimer; i++) {
+        if (pl->timers[i].type == ED_UNUSED)
             break;
     }
-    if (i == MX_TIMER) {
+    if (i == pl->ntimer) {
+        start_unlock();
         edlog("No free timers");
         return ((void *) 0);
     }
 
-    /* Get "now" */
-    if (gettimeofday(&tv, 0)) {
-        // LOG(LOG_WARNING, TM, E_No_Date);
-        return ((ED_TIMER *) 0);
-    }
-
     /* OK, we've got the ED_TIMER struct, now fill it in */
-    ntimers++;       /* increment number of ED_TIMER structs alloc'ed */
-    Timers[i].type = type;          /* one-shot or periodic */
-    Timers[i].to = tv2us(&tv) + (ms * 1000); /* us from Epoch to timeout */
-    Timers[i].us = ms * 1000;       /* period or interval in uS */
-    Timers[i].cb = cb;              /* callback routine */
-    Timers[i].pcb_data = pcb_data;  /* callback data */
-
-    return ((void *) &Timers[i]);
+    pt = &(pl->timers[i]);
+    pl->ntimers++;   /* increment number of ED_TIMER structs alloc'ed */
+    pt->type = type;                /* one-shot or periodic */
+    pt->to = tv2us(&tv) + (ms * 1000); /* us from Epoch to timeout */
+    pt->us = ms * 1000;             /* period or interval in uS */
+    pt->cb = cb;                    /* callback routine */
+    pt->pcb_data = pcb_data;        /* callback data */
+    pt->owner = so_owner(cb);       /* plug-in that added the timer */
+    start_unlock();
+
+    return ((void *) pt);
 }
 
 
@@ -490,20 +723,49 @@ void *add_timer(        // address of timer struct allocated
 void del_timer(
     void    *ptimer)
 {
+    ED_LOOP *pl;        // loop with the timer
+
     // Verify pointer is in range and on struct boundary
-    if ((ptimer < (void *) &Timers[0]) || (ptimer > (void *) &Timers[MX_TIMER -1])) {
-        return;
-    }
-    if (((ptimer - (void *) &Timers[0]) % sizeof(ED_TIMER)) != 0) {
-        return;
-    }
-    if (((ED_TIMER *) ptimer)->type == ED_UNUSED) {
+    start_lock();
+    pl = cur_loop();
+    if ((ptimer < (void *) &(pl->timers[0])) ||
+        (ptimer > (void *) &(pl->timers[pl->ntimer - 1])) ||
+        (((ptimer - (void *) &(pl->timers[0])) % sizeof(ED_TIMER)) != 0) ||
+        (((ED_TIMER *) ptimer)->type == ED_UNUSED)) {
+        start_unlock();
         return;
     }
 
     ((ED_TIMER *) ptimer)->type = ED_UNUSED;
 
-    ntimers--;
+    pl->ntimers--;
+    start_unlock();
+}
+
+
+/***************************************************************************
+ * del_owned(): - Close the FDs and delete the timers that a plug-in
+ * added and did not remove.  This is done when the plug-in is unloaded
+ * since its callbacks go away with it.
+ ***************************************************************************/
+void del_owned(
+    int      slot)      // slot of the plug-in
+{
+    int      i;         // loop counter
+
+    for (i = 0; i < MX_FD; i++) {
+        if ((Ed_Fd[i].fd != -1) && (Ed_Fd[i].owner == slot)) {
+            (void) close(Ed_Fd[i].fd);
+            Ed_Fd[i].fd = -1;
+        }
+    }
+    update_fdsets(&MainLoop);
+
+    for (i = 0; i < MX_TIMER; i++) {
+        if ((Timers[i].type != ED_UNUSED) && (Timers[i].owner == slot))
+            del_timer((void *) &Timers[i]);
+    }
+    return;
 }
 
 
@@ -521,6 +783,21 @@ static long long tv2us(
 }
 
 
+/***************************************************************************
+ * now_us(): - return the current time in microseconds since the Epoch.
+ * Returns zero if the time is not available.
+ ***************************************************************************/
+long long now_us()
+{
+    struct timeval tv;  // timeval struct to hold "now"
+
+    if (gettimeofday(&tv, 0)) {
+        return ((long long) 0);
+    }
+    return (tv2us(&tv));
+}
+
+
 /***************************************************************************
  * getslotbyid(): - return a slot pointer given its index.
  *   This routine is used by plug-ins to help find what other
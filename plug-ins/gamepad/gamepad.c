@@ -83,6 +83,7 @@ typedef struct
     int      buttons;  // current state of the buttons
     int      filter;   // filter out event if bit is set
     int      ts;       // timerstame of most recent event
+    int      watch;    // bit (1 << RSC_xxx) set if a broadcast has listeners
 } GAMEPAD;
 
 
@@ -92,6 +93,9 @@ typedef struct
 static void getevents(int, void *);
 static void usercmd(int, int, char*, SLOT*, int, int*, char*);
 static void sendstate(void *, GAMEPAD *);
+static int  gpopen(GAMEPAD *);
+static void gpclose(GAMEPAD *);
+static void gptimer(GAMEPAD *);
 
 
 /**************************************************************
@@ -118,11 +122,10 @@ int Initialize(
     pctx->filter = 0;          // default is to report all controls
     pctx->indx = 0;            // no bytes in gamepad event structure yet
     (void) strncpy(pctx->device, DEFDEV, PATH_MAX);
-    // now open and register the gamepad device
-    pctx->gpfd = open(pctx->device, (O_RDONLY | O_NONBLOCK));
-    if (pctx->gpfd != -1) {
-        add_fd(pctx->gpfd, ED_READ, getevents, (void *) pctx);
-    }
+    // The device is opened when someone listens to events or state
+    pctx->gpfd = -1;
+    pctx->ptimer = (void *) 0;
+    pctx->watch = 0;
     pctx->ts = 0;
     pctx->buttons = 0;
     for (i = 0; i < NAXIS; i++) {
@@ -149,9 +152,9 @@ int Initialize(
     pslot->rsc[RSC_DEVICE].pgscb = usercmd;
     pslot->rsc[RSC_DEVICE].uilock = -1;
     pslot->rsc[RSC_EVENTS].name = FN_EVENTS;
-    pslot->rsc[RSC_EVENTS].flags = CAN_BROADCAST;
+    pslot->rsc[RSC_EVENTS].flags = CAN_BROADCAST | WANT_SUBS;
     pslot->rsc[RSC_EVENTS].bkey = 0;
-    pslot->rsc[RSC_EVENTS].pgscb = 0;
+    pslot->rsc[RSC_EVENTS].pgscb = usercmd;
     pslot->rsc[RSC_EVENTS].uilock = -1;
     pslot->rsc[RSC_EVENTS].slot = pslot;
     pslot->rsc[RSC_FILTER].name = FN_FILTER;
@@ -161,17 +164,16 @@ int Initialize(
     pslot->rsc[RSC_FILTER].uilock = -1;
     pslot->rsc[RSC_FILTER].slot = pslot;
     pslot->rsc[RSC_STATE].name = FN_STATE;
-    pslot->rsc[RSC_STATE].flags = CAN_BROADCAST;
+    pslot->rsc[RSC_STATE].flags = CAN_BROADCAST | WANT_SUBS;
     pslot->rsc[RSC_STATE].bkey = 0;
-    pslot->rsc[RSC_STATE].pgscb = 0;
+    pslot->rsc[RSC_STATE].pgscb = usercmd;
     pslot->rsc[RSC_STATE].uilock = -1;
     pslot->rsc[RSC_STATE].slot = pslot;
-
-    // Start the timer to broadcast state info
-    if (pctx->period != 0)
-        pctx->ptimer = add_timer(ED_PERIODIC, pctx->period, sendstate, (void *) pctx);
-    else
-        pctx->ptimer = (void *) 0;
+    // The configuration changes only with an edset so the daemon
+    // can answer reads of it
+    (void) ed_cacheable(&(pslot->rsc[RSC_PERIOD]), ED_CACHE_FOREVER);
+    (void) ed_cacheable(&(pslot->rsc[RSC_DEVICE]), ED_CACHE_FOREVER);
+    (void) ed_cacheable(&(pslot->rsc[RSC_FILTER]), ED_CACHE_FOREVER);
 
     return (0);
 }
@@ -219,13 +221,8 @@ void usercmd(
         // record the new period
         pctx->period = nperiod;
 
-        // Delete old timer and create a new one with the new period
-        if (pctx->ptimer) {
-            del_timer(pctx->ptimer);
-        }
-        if (pctx->period != 0) {
-            pctx->ptimer = add_timer(ED_PERIODIC, pctx->period, sendstate, (void *) pctx);
-        }
+        // Replace the old timer with one with the new period
+        gptimer(pctx);
     }
     else if ((cmd == EDSET) && (rscid == RSC_FILTER)) {
         ret = sscanf(val, "%x", &nfilter);
@@ -241,22 +238,77 @@ void usercmd(
         (void) strncpy(pctx->device, val, PATH_MAX);
         // strncpy() does not force a null.  We add one now as a precaution
         pctx->device[PATH_MAX -1] = (char) 0;
-        // close and unregister the old device
-        if (pctx->gpfd >= 0) {
-            del_fd(pctx->gpfd);
-            close(pctx->gpfd);
-            pctx->gpfd = -1;
-        }
-        // now open and register the new device
-        pctx->gpfd = open(pctx->device, (O_RDONLY | O_NONBLOCK));
-        if (pctx->gpfd != -1) {
-            add_fd(pctx->gpfd, ED_READ, getevents, (void *) pctx);
-        }
-        else {
+        // close the old device and open the new one if anyone is
+        // listening.  Otherwise just check that it can be opened.
+        gpclose(pctx);
+        if (((pctx->watch != 0) && (gpopen(pctx) < 0)) ||
+            ((pctx->watch == 0) && (access(pctx->device, R_OK) != 0))) {
             *plen = snprintf(buf, *plen, M_NOPORT, pslot->rsc[rscid].name);
             return;
         }
     }
+    else if ((cmd == EDSUB) || (cmd == EDUNSUB)) {
+        // Open the device when events or state gets its first listener
+        // and close it when neither has any.  The state timer runs
+        // only while state has listeners.
+        if (cmd == EDSUB)
+            pctx->watch |= (1 << rscid);
+        else
+            pctx->watch &= ~(1 << rscid);
+        if ((pctx->watch != 0) && (pctx->gpfd < 0))
+            (void) gpopen(pctx);
+        else if (pctx->watch == 0)
+            gpclose(pctx);
+        gptimer(pctx);
+    }
+    return;
+}
+
+
+/***************************************************************************
+ * gpopen(): - Open and register the gamepad device.  Returns 0 on
+ * success or -1 if the device can not be opened.
+ ***************************************************************************/
+static int gpopen(
+    GAMEPAD  *pctx)          // our context
+{
+    pctx->indx = 0;
+    pctx->gpfd = open(pctx->device, (O_RDONLY | O_NONBLOCK));
+    if (pctx->gpfd < 0)
+        return(-1);
+    add_fd(pctx->gpfd, ED_READ, getevents, (void *) pctx);
+    return(0);
+}
+
+
+/***************************************************************************
+ * gpclose(): - Close and unregister the gamepad device if it is open.
+ ***************************************************************************/
+static void gpclose(
+    GAMEPAD  *pctx)          // our context
+{
+    if (pctx->gpfd >= 0) {
+        del_fd(pctx->gpfd);
+        close(pctx->gpfd);
+        pctx->gpfd = -1;
+    }
+    return;
+}
+
+
+/***************************************************************************
+ * gptimer(): - Start, restart, or stop the timer that broadcasts the
+ * state.  It runs if the period is not zero and state has listeners.
+ ***************************************************************************/
+static void gptimer(
+    GAMEPAD  *pctx)          // our context
+{
+    if (pctx->ptimer) {
+        del_timer(pctx->ptimer);
+        pctx->ptimer = (void *) 0;
+    }
+    if ((pctx->period != 0) && ((pctx->watch & (1 << RSC_STATE)) != 0))
+        pctx->ptimer = add_timer(ED_PERIODIC, pctx->period, sendstate, (void *) pctx);
     return;
 }
 
@@ -273,8 +325,7 @@ static void getevents(
     RSC      *prsc;          // pointer to this slot's counts resource
     int       nrd;           // number of bytes read
     int       cindx;         // current indx of byte read so far (usually 0)
-    char      msg[MX_MSGLEN+1]; // text to send.  +1 for newline
-    int       slen;          // length of text to output
+    ED_VALUE  vals[4];       // time, type, number, and value of an event
     struct js_event *jsevt;  // to cast gpevt to type struct js_event
     int       mask;          // bit shift variable
     int       bcststate = 0; // broadcast state when set
@@ -288,10 +339,8 @@ static void getevents(
     nrd = read(pctx->gpfd, &(pctx->gpevt[cindx]), (EVENTSZ - cindx));
 
     // shutdown manager conn on error or on zero bytes read */
-    if ((nrd <= 0) && (errno != EAGAIN)) {
-        close(pctx->gpfd);
-        del_fd(pctx->gpfd);
-        pctx->gpfd = -1;
+    if ((nrd == 0) || ((nrd < 0) && (errno != EAGAIN))) {
+        gpclose(pctx);
         return;
     }
 
@@ -308,18 +357,22 @@ static void getevents(
     // Broadcast event if any UI are monitoring it.
     pslot = pctx->pslot;
     prsc = &(pslot->rsc[RSC_EVENTS]);  // events resource
-    if (prsc->bkey != 0) {
-        // write message into a string
-        if (jsevt->type == JS_EVENT_BUTTON) {
-            slen = snprintf(msg, (MX_MSGLEN +1), "%11d B %d %d\n",
-                   jsevt->time, jsevt->number, jsevt->value);
-        }
-        else if (jsevt->type == JS_EVENT_AXIS) {
-            slen = snprintf(msg, (MX_MSGLEN +1), "%11d A %d %d\n",
-                   jsevt->time, jsevt->number, jsevt->value);
-        }
+    if ((prsc->bkey != 0) &&
+        ((jsevt->type == JS_EVENT_BUTTON) || (jsevt->type == JS_EVENT_AXIS))) {
+        // ASCII UIs get the event as "%11d B %d %d\n" or "%11d A %d %d\n"
+        vals[0].type = ED_VT_INT;
+        vals[0].width = 11;
+        vals[0].v.i = (int) jsevt->time;
+        vals[1].type = ED_VT_TEXT;
+        vals[1].width = 0;
+        vals[1].v.s = (jsevt->type == JS_EVENT_BUTTON) ? "B" : "A";
+        vals[2].type = ED_VT_INT;
+        vals[2].width = 0;
+        vals[2].v.i = jsevt->number;
+        vals[3] = vals[2];
+        vals[3].v.i = jsevt->value;
         // bkey will return cleared if UIs are no longer monitoring us
-        bcst_ui(msg, slen, &(prsc->bkey));
+        ed_publish(prsc, vals, 4);
     }
 
     // Update the state info if not filtered
@@ -360,8 +413,8 @@ void sendstate(
 {
     SLOT     *pslot;   // This instance of the gamepad plug-in
     RSC      *prsc;    // pointer to this slot's counts resource
-    char      msg[MX_MSGLEN+1]; // message to send.  +1 for newline
-    int       slen;    // length of string to output
+    ED_VALUE  vals[2 + NAXIS]; // time, buttons, and axes to send
+    int       nval = 0; // number of values in vals
     int       i;       // loop counter for axis
 
     pslot = pctx->pslot;
@@ -371,25 +424,29 @@ void sendstate(
         return;
     }
 
-    // Write message into a string starting with a timestamp
-    slen = snprintf(msg, (MX_MSGLEN +1), "%10d", pctx->ts);
+    // The state starts with a timestamp, "%10d" for ASCII UIs
+    vals[nval].type = ED_VT_INT;
+    vals[nval].width = 10;
+    vals[nval++].v.i = pctx->ts;
 
-    // Print button values if any button is being monitored.  
+    // Send button values if any button is being monitored, " %04x".
     // Buttons are the low 16 bits of the filter (0x00FFFF)
     if ((pctx->filter & 0x00ffff) != 0x00ffff) {   // all filtered?
-        slen += snprintf(&(msg[slen]), (MX_MSGLEN +1 -slen), " %04x", pctx->buttons);
+        vals[nval].type = ED_VT_HEX;
+        vals[nval].width = 4;
+        vals[nval++].v.i = pctx->buttons;
     }
 
     for (i = 0; i < NAXIS; i++) {
         if (((1 << (i + NBNTN)) & pctx->filter) == 0) {
-            slen += snprintf(&(msg[slen]), (MX_MSGLEN +1 -slen), " %d", pctx->axs[i]);
+            vals[nval].type = ED_VT_INT;
+            vals[nval].width = 0;
+            vals[nval++].v.i = pctx->axs[i];
         }
     }
 
-    slen += snprintf(&(msg[slen]), (MX_MSGLEN +1 -slen), "\n");
-
     // bkey will return cleared if UIs are no longer monitoring us
-    bcst_ui(msg, slen, &(prsc->bkey));
+    ed_publish(prsc, vals, nval);
 
     return;
 }
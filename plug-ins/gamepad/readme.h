@@ -0,0 +1,89 @@
+static char README[] = "\
+============================================================\n\
+\n\
+gamepad Plug-in\n\
+The gamepad plug-in provides a simple ASCII interface\n\
+to Linux joystick or gamepad devices.  The plug-in has\n\
+user configurable resources for the Linux device name\n\
+and the period for status writes to the 'state' resource.\n\
+Incoming gamepad events are broadcast in ASCII on the\n\
+'events' resource.\n\
+\n\
+\n\
+RESOURCES\n\
+device : The full path to the Linux joystick device to\n\
+use.  Changing this causes the old device to be closed\n\
+and the new one opened.  The device is open only while\n\
+someone is listening to 'events' or 'state'.  The default\n\
+value of 'device' is /dev/input/js1.\n\
+\n\
+events : A broadcast resource that outputs gamepad events\n\
+as they arrive.  This can be useful for debugging or if\n\
+you want to watch for one specific event.  The output of\n\
+events is ASCII text terminated by a newline with one\n\
+line per event.  The timestamp is in milliseconds and\n\
+events are either an axis change (A) or a button change\n\
+(B).  The form of the output is:\n\
+    timestamp <A|B> ID value\n\
+For example, pressing the 'Start' button on the gamepad\n\
+would generate an event similar to this:\n\
+    80114284 B 7 1\n\
+\n\
+filter : A hex value that specifies which values to\n\
+display as part of 'state'.  A set bit filters out\n\
+that gamepad control.  The bits in the hex value have\n\
+the following meaning:\n\
+   000001 : 'A' button\n\
+   000002 : 'B' button\n\
+   000004 : 'X' button\n\
+   000008 : 'Y' button\n\
+   000010 : Left top button\n\
+   000020 : Right top button\n\
+   000040 : Left center button\n\
+   000080 : Right center button\n\
+   000100 : Top center button\n\
+   000200 :    (unused)\n\
+   000400 :    (unused)\n\
+   000800 :    (unused)\n\
+   001000 :    (unused)\n\
+   002000 :    (unused)\n\
+   004000 :    (unused)\n\
+   008000 :    (unused)\n\
+   010000 : Left horizontal joystick\n\
+   020000 : Left vertical joystick\n\
+   040000 : Left trigger\n\
+   080000 : Right horizontal joystick\n\
+   100000 : Right vertical joystick\n\
+   200000 : Right trigger\n\
+   400000 : Horizontal hat switch\n\
+   800000 : Vertical hat switch\n\
+\n\
+state : A broadcast resource that outputs the filtered\n\
+state of the gamepad every 'period' millisecond (or on\n\
+state change if period is zero).  The state has up to\n\
+eight axis values and sixteen button events.  The form\n\
+of the output with all controls unfiltered is:\n\
+    timestamp buttons ax1 ax2 ax3 ax4 ax5 ax6 ax7 ax8\n\
+where 'buttons' is the hex value of the state of all\n\
+buttons, and the axis value are signed decimal value\n\
+show the state of the axis.  The timestamp is for the\n\
+last event reported.  If the timestamp is not changing\n\
+it is because there are no new events.\n\
+\n\
+period : A read-write resource that sets the period in\n\
+milliseconds between updates to 'state'.  Any integer\n\
+value greater than or equal to zero is accepted but is\n\
+rounded off to the next highest 10 milliseconds. If the\n\
+period is zero a new state is broadcast when a new event\n\
+arrives.  If non-zero the state is broadcast every \n\
+'period' milliseconds whether or not new events have\n\
+arrived.\n\
+\n\
+EXAMPLE\n\
+  Display the right vertical joystick value and the top\n\
+left button.  Display on value change only (no periodic\n\
+updates).\n\
+   hbaset gamepad filter efffef\n\
+   hbaset gamepad period 0 \n\
+   hbacat gamepad state\n\
+";
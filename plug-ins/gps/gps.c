@@ -86,7 +86,7 @@ typedef struct
     int      status;   // most recent status
     int      nsat;     // most recent satellite count
     char     linein[GPS_STR_LEN];  // string from GPS receiver
-    int      ininx;    // index into linein
+    ED_LINEBUF lines;  // splits linein into NEMA sentences
 } GPSDEV;
 
 
@@ -95,7 +95,7 @@ typedef struct
  **************************************************************/
 static void gpscb(int, void *, int);
 static void gpsuser(int, int, char*, SLOT*, int, int*, char*);
-static void do_nema(GPSDEV  *);
+static void do_nema(GPSDEV  *, char *, int);
 
 
 /**************************************************************
@@ -120,7 +120,7 @@ int Initialize(
     pctx->gpsfd = -1;          // an FD of -1 is not valid
     pctx->status = -1;         // serial port not open or in error
     pctx->nsat = 0;            // no satellites in use
-    pctx->ininx = 0;           // no chars from receiver yet
+    ed_line_init(&(pctx->lines), pctx->linein, GPS_STR_LEN, 0); // no chars yet
     strncpy(pctx->port, "(null)", 7);  // 7==strlen("null") + 1 for null
 
     // Register this slot's private data
@@ -141,6 +141,8 @@ int Initialize(
     pslot->rsc[RSC_STATUS].pgscb = gpsuser;
     pslot->rsc[RSC_STATUS].uilock = -1;
     pslot->rsc[RSC_STATUS].slot = pslot;
+    // The daemon answers status reads until the status changes
+    (void) ed_cacheable(&(pslot->rsc[RSC_STATUS]), ED_CACHE_FOREVER);
     pslot->rsc[RSC_TLL].name = "tll";
     pslot->rsc[RSC_TLL].flags = CAN_BROADCAST;
     pslot->rsc[RSC_TLL].bkey = 0;
@@ -187,6 +189,8 @@ void gpsuser(
         return;
     }
     else if ((cmd == EDSET) && (rscid == RSC_CONFIG)) {
+        // The status changes with the port
+        ed_cache(&(pslot->rsc[RSC_STATUS]), (char *) 0, 0);
         ret = sscanf(val, "%d %99s", &newbaud, newport);  // !!!! 99 is GPS_STR_LEN - 1
         // baudrate must be one of the common values
         if ((ret != 2) || 
@@ -246,7 +250,7 @@ void gpsuser(
         // Open and configure of serial port worked.  Set the
         // read callback to get the GPS sentences.
         pctx->status = 0;
-        pctx->ininx = 0;
+        ed_line_init(&(pctx->lines), pctx->linein, GPS_STR_LEN, 0);
         add_fd(pctx->gpsfd, ED_READ, gpscb, pctx);
     }
 
@@ -266,13 +270,15 @@ void gpscb(
 {
     GPSDEV  *pctx;     // our local info
     int      ret;      // return status
-    int      i;        // loop index
+    char    *line;     // a sentence in linein
+    int      room;     // number of bytes that fit in linein
 
 
     pctx = (GPSDEV *) priv;  // get our context
 
 
-    ret = read(fd, &(pctx->linein[pctx->ininx]), (GPS_STR_LEN - pctx->ininx));
+    line = ed_line_room(&(pctx->lines), &room);
+    ret = read(fd, line, room);
     // error out with a log message if read error
     if (ret == -1) {
         if (errno == EAGAIN)
@@ -280,30 +286,22 @@ void gpscb(
         del_fd(fd);
         pctx->gpsfd = -1;
         pctx->status = -1;
+        ed_cache(&(((SLOT *) pctx->pslot)->rsc[RSC_STATUS]), (char *) 0, 0);
         edlog(M_NOREAD, pctx->port);
         return;
     }
     else if (ret == 0) {             // done with read
         return;
     }
-    else if (pctx->ininx + ret == GPS_STR_LEN) {
-        // buffer overflow,  Reset pointer to discard bogus line
-        pctx->ininx = 0;
-        return;
-    }
-    pctx->ininx = pctx->ininx + ret;
-
-
-    // NEMA sentences are in the buffer. Call the parser to process them
-    // Scan for a newline.    If found, replace it with a null and process line
-    // Lines are terminated with \r\n but the \r does not cause a problem
-    for (i = 0; i < pctx->ininx; i++) {
-        if (pctx->linein[i] == '\n') {
-            pctx->linein[i] = (char) 0;
-            do_nema(pctx);
-            (void) memmove(pctx->linein, &(pctx->linein[i+1]), (pctx->ininx - (i+1)));
-            pctx->ininx -= i+1;
-            i = 0;
+    ed_line_added(&(pctx->lines), ret);
+
+
+    // NEMA sentences are in the buffer. Call the parser to process them.
+    // Lines are terminated with \r\n but the \r does not cause a problem.
+    // An overlong line is bogus and the framer discards it.
+    while ((ret = ed_line_next(&(pctx->lines), &line)) != ED_LINE_NONE) {
+        if (ret != ED_LINE_LONG) {
+            do_nema(pctx, line, ret);
         }
     }
 
@@ -316,7 +314,9 @@ void gpscb(
  *
  ***************************************************************************/
 void do_nema(
-    GPSDEV   *pctx)    // our local info
+    GPSDEV   *pctx,    // our local info
+    char     *line,    // null terminated sentence from the receiver
+    int       len)     // length of the sentence
 {
     SLOT     *pslot;
     RSC      *prsc;    // pointer to this slot's counts resource
@@ -325,14 +325,15 @@ void do_nema(
     int       i;
     char     *fld[GGA_NUM_FIELD];  // GGA should have _exactly_ 15 fields
     int       j = 0; // index into fld[];
-    char      lineout[GPS_STR_LEN];  // output to send to users
-    int       nout;    // length of output line
+    ED_VALUE  vals[3]; // time, latitude, and longitude to send to users
     int       tmpi;    // temp int
     double    tmpd;    // temp double
     double    lng;     // longitude
     double    lat;     // latitude
     int       midnightsecs; // number of seconds since midnight UTC
     int       nconv = 0; // number of valid conversions
+    int       ostatus; // status before this sentence
+    int       onsat;   // satellites in use before this sentence
 
 
     // Get slot and pointer to TLL resource structure
@@ -341,7 +342,7 @@ void do_nema(
 
 
     // We only process the GGA sentences.  Return if anything else
-    notgga = strncmp("$GPGGA,", pctx->linein, 7);  // 7=strlen($GPGGA,)
+    notgga = strncmp("$GPGGA,", line, 7);  // 7=strlen($GPGGA,)
     if (notgga) {
         return;
     }
@@ -349,10 +350,10 @@ void do_nema(
     // Prepare line for processing and verify checksum. 
     // We replace the commas with a null and note the location of the next char
     sum = 0;
-    for (i = 1; i < pctx->ininx; i++) {
-        if (pctx->linein[i] == '*') {
-            pctx->linein[i] = (char) 0;
-            fld[j] = &(pctx->linein[i+1]);
+    for (i = 1; i < len; i++) {
+        if (line[i] == '*') {
+            line[i] = (char) 0;
+            fld[j] = &(line[i+1]);
             j++;
             // Sanity check number of fields
             if (j != GGA_NUM_FIELD) {       // must be exactly 15
@@ -360,10 +361,10 @@ void do_nema(
             }
             break;                          // checksum is last field
         }
-        sum = sum ^ pctx->linein[i];
-        if (pctx->linein[i] == ',') {
-            pctx->linein[i] = (char) 0;
-            fld[j] = &(pctx->linein[i+1]);
+        sum = sum ^ line[i];
+        if (line[i] == ',') {
+            line[i] = (char) 0;
+            fld[j] = &(line[i+1]);
             j++;
             // Sanity check number of fields
             if (j == GGA_NUM_FIELD) {       // Too many fields?
@@ -381,9 +382,14 @@ void do_nema(
 
     // An NEMA GGA sentence with a valid checksum and the right number of
     // fields in the line.  Extract and save status info.
+    ostatus = pctx->status;
+    onsat = pctx->nsat;
     nconv += sscanf(fld[GGA_NSAT], "%d", &(pctx->nsat));   // get sat count
     nconv += sscanf(fld[GGA_QUALITY], "%d", &tmpi); // tmpi is 0 if no lock
     pctx->status = (tmpi == 0) ? 0 : 1;
+    if ((pctx->status != ostatus) || (pctx->nsat != onsat)) {
+        ed_cache(&(pslot->rsc[RSC_STATUS]), (char *) 0, 0);
+    }
 
     // rest of the data is bogus if no satellite lock
     if (tmpi == 0) {
@@ -418,10 +424,18 @@ void do_nema(
         return;
     }
 
-    snprintf(lineout, GPS_STR_LEN, "%d %9.4lf %9.4lf\n", midnightsecs, lat, lng);
-    nout = strnlen(lineout, GPS_STR_LEN-1);
+    // The daemon formats the values as "%d %9.4lf %9.4lf\n" for ASCII UIs
+    vals[0].type = ED_VT_INT;
+    vals[0].width = 0;
+    vals[0].v.i = midnightsecs;
+    vals[1].type = ED_VT_FLOAT;
+    vals[1].width = 9;
+    vals[1].prec = 4;
+    vals[1].v.d = lat;
+    vals[2] = vals[1];
+    vals[2].v.d = lng;
     // bkey will return cleared if UIs are no longer monitoring us
-    bcst_ui(lineout, nout, &(prsc->bkey));
+    ed_publish(prsc, vals, 3);
 
     return;
 }
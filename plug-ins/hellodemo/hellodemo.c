@@ -69,6 +69,7 @@ typedef struct
  **************************************************************/
 static void usercmd(int, int, char*, SLOT*, int, int*, char*);
 static void sendnow(void *, HELLODEMO *);
+void Finalize(SLOT *);
 
 
 /**************************************************************
@@ -125,6 +126,24 @@ int Initialize(
 }
 
 
+/**************************************************************
+ * Finalize():  - Release our storage before the plug-in is
+ * unloaded by edunloadso or edreloadso.  The daemon removes any
+ * timers and FDs we leave, but a plug-in should stop its own.
+ **************************************************************/
+void Finalize(
+    SLOT *pslot)       // points to the SLOT for this plug-in
+{
+    HELLODEMO *pctx;   // our local device context
+
+    pctx = (HELLODEMO *) pslot->priv;
+    del_timer(pctx->ptimer);
+    free(pctx);
+    pslot->priv = (void *) 0;
+    return;
+}
+
+
 /**************************************************************
  * usercmd():  - The user is reading or setting one of the configurable
  * resources.  (I like doing this all in one routine with if() to
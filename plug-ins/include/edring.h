@@ -0,0 +1,186 @@
+/*
+ * Name: edring.h
+ *
+ * Description: Layout of the shared memory broadcast rings and the
+ *              routines a local program uses to read them.  The daemon
+ *              copies each broadcast of a resource into its ring.  A
+ *              reader maps the ring and reads samples without any
+ *              system calls and without slowing down the daemon.
+ *
+ *              Start a ring with 'edset 0 shmring gps.tll 64' and read
+ *              it with something like:
+ *                  ED_RING *pr = edring_open("/ed-gps.tll");
+ *                  uint64_t next = edring_head(pr);
+ *                  while (1) {
+ *                      len = edring_read(pr, &next, buf, sizeof(buf), &ts);
+ *                      if (len == ED_RING_EMPTY)      ... nothing new
+ *                      else if (len == ED_RING_LOST)  ... reader fell behind
+ *                      else                           ... use buf[0..len-1]
+ *                  }
+ *
+ * Copyright:   Copyright (C) 2019 by Demand Peripherals, Inc.
+ *              All rights reserved.
+ *
+ * License:     This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the Version 2 of the GNU General
+ *              Public License as published by the Free Software Foundation.
+ *              GPL2.txt in the top level directory is a copy of this license.
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *              GNU General Public License for more details.
+ *
+ */
+
+#ifndef EDRING_H_
+#define EDRING_H_
+
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+/***************************************************************************
+ *  - Defines
+ ***************************************************************************/
+#define ED_RING_MAGIC   0x45445231  /* "EDR1", set once the ring is ready */
+#define ED_RING_HDRSZ   64          /* bytes before the first entry */
+#define ED_RENT_HDRSZ   24          /* bytes before the data in an entry */
+#define ED_RING_EMPTY    0          /* edring_read(): no new sample */
+#define ED_RING_LOST   (-1)         /* edring_read(): samples were overwritten */
+
+        // Address of the entry that holds sample n
+#define ED_RENT(pr, n)  ((ED_RENT *) ((char *) (pr) + ED_RING_HDRSZ + \
+                         ((n) & ((pr)->nent - 1)) * (uint64_t) (pr)->entsz))
+
+
+/***************************************************************************
+ *  - Data structures
+ *    The ring is a header followed by nent entries of entsz bytes.  Sample
+ * n goes in entry n % nent.  The daemon sets the entry's seq to zero while
+ * it writes the sample and to n+1 when it is done, then sets head to n+1.
+ * A reader that finds seq is not n+1 after copying a sample knows the
+ * sample was overwritten while it was being read.
+ ***************************************************************************/
+typedef struct {
+    uint32_t  magic;           // ED_RING_MAGIC
+    uint32_t  nent;            // number of entries, a power of two
+    uint32_t  entsz;           // bytes per entry including its header
+    uint32_t  slot;            // slot ID of the resource
+    uint32_t  rsc;             // resource ID in the slot
+    uint32_t  pad;
+    uint64_t  head;            // number of samples written so far
+} ED_RING;
+
+typedef struct {
+    uint64_t  seq;             // sample number + 1, zero while being written
+    uint64_t  ts;              // time of the broadcast in microseconds
+    uint32_t  len;             // bytes of data in this sample
+    uint32_t  pad;
+    char      data[];          // the broadcast data
+} ED_RENT;
+
+
+/***************************************************************************
+ * edring_open(): - Map the ring with the given shared memory name, for
+ * example "/ed-gps.tll".  Returns a null pointer on error.
+ ***************************************************************************/
+static inline ED_RING *edring_open(
+    const char *name)          // shared memory name of the ring
+{
+    struct stat st;
+    void     *pmap;
+    int       fd;
+
+    fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0)
+        return((ED_RING *) 0);
+    if ((fstat(fd, &st) < 0) || (st.st_size < ED_RING_HDRSZ)) {
+        close(fd);
+        return((ED_RING *) 0);
+    }
+    pmap = mmap((void *) 0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (pmap == MAP_FAILED)
+        return((ED_RING *) 0);
+    if (__atomic_load_n(&((ED_RING *) pmap)->magic, __ATOMIC_ACQUIRE) != ED_RING_MAGIC) {
+        munmap(pmap, st.st_size);
+        return((ED_RING *) 0);
+    }
+    return((ED_RING *) pmap);
+}
+
+
+/***************************************************************************
+ * edring_close(): - Unmap a ring
+ ***************************************************************************/
+static inline void edring_close(
+    ED_RING  *pr)              // ring from edring_open()
+{
+    munmap((void *) pr, ED_RING_HDRSZ + (size_t) pr->nent * pr->entsz);
+}
+
+
+/***************************************************************************
+ * edring_head(): - Return the number of the next sample to be written.
+ * A new reader starts here to get only new samples.
+ ***************************************************************************/
+static inline uint64_t edring_head(
+    ED_RING  *pr)              // ring from edring_open()
+{
+    return(__atomic_load_n(&pr->head, __ATOMIC_ACQUIRE));
+}
+
+
+/***************************************************************************
+ * edring_read(): - Copy sample *pnext into buf and advance *pnext.
+ * Returns the length of the sample, ED_RING_EMPTY if the sample has not
+ * been written yet, or ED_RING_LOST if the reader fell so far behind
+ * that the sample was overwritten.  On ED_RING_LOST *pnext is moved up
+ * to the oldest sample still in the ring.  The number of samples lost
+ * is the change in *pnext.
+ ***************************************************************************/
+static inline int edring_read(
+    ED_RING  *pr,              // ring from edring_open()
+    uint64_t *pnext,           // number of the sample to read
+    char     *buf,             // where to put the sample
+    int       bufsz,           // size of buf
+    uint64_t *pts)             // where to put the time of the sample, or 0
+{
+    ED_RENT  *pe;              // entry with the sample
+    uint64_t  head;            // number of samples written
+    uint64_t  seq;             // entry seq before the copy
+    uint32_t  len;             // length of the sample
+
+    head = __atomic_load_n(&pr->head, __ATOMIC_ACQUIRE);
+    if (*pnext >= head)
+        return(ED_RING_EMPTY);
+    if (head - *pnext >= pr->nent) {
+        // The entry may already be in use for a newer sample
+        *pnext = head - pr->nent + 1;
+        return(ED_RING_LOST);
+    }
+
+    pe = ED_RENT(pr, *pnext);
+    seq = __atomic_load_n(&pe->seq, __ATOMIC_ACQUIRE);
+    len = pe->len;
+    len = (len > pr->entsz - ED_RENT_HDRSZ) ? pr->entsz - ED_RENT_HDRSZ : len;
+    len = (len > (uint32_t) bufsz) ? (uint32_t) bufsz : len;
+    memcpy(buf, pe->data, len);
+    if (pts)
+        *pts = pe->ts;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if ((seq != *pnext + 1) || (__atomic_load_n(&pe->seq, __ATOMIC_RELAXED) != seq)) {
+        // Overwritten before or during the copy
+        head = __atomic_load_n(&pr->head, __ATOMIC_ACQUIRE);
+        *pnext = head - pr->nent + 1;
+        return(ED_RING_LOST);
+    }
+    (*pnext)++;
+    return((int) len);
+}
+
+#endif /*EDRING_H_*/
@@ -29,6 +29,7 @@
 #define CAN_BROADCAST    1
 #define IS_READABLE      2      /* can we issue a edget to it? */
 #define IS_WRITABLE      4      /* can we issue a edset to it? */
+#define WANT_SUBS        8      /* give pgscb EDSUB and EDUNSUB */
 
         // Types of UI access */
 #define EDGET            1
@@ -36,6 +37,18 @@
 #define EDCAT            3
 #define EDLIST           4
 #define EDLOAD           5
+#define EDPROTO          6
+#define EDRESOLVE        7
+#define EDMGET           8
+#define EDDUMP           9
+#define EDHIST          10
+#define EDUNLOAD        11
+#define EDRELOAD        12
+
+        // Given to the pgscb of a broadcast resource with WANT_SUBS when
+        // it gets its first listener and when it loses its last one
+#define EDSUB           13
+#define EDUNSUB         14
 
         // Different ways to register a fd for select
 #define ED_READ          1
@@ -47,6 +60,37 @@
         // Max size of a line to the UI's
 #define MXRPLY    (1000)
 
+        // Encodings a UI connection can select with the edproto command
+#define ED_PROTO_ASCII   0      /* printable ASCII lines and a prompt */
+#define ED_PROTO_BINARY  1      /* length prefixed binary frames */
+
+        // Binary protocol frame header.  All fields are in network byte
+        // order.  The header is followed by 'len' bytes of payload.
+        //   u32 len, u8 type, u8 ptype, u16 slot, u16 rsc, u16 request ID,
+        //   u32 seq, u64 timestamp in microseconds since the Epoch
+#define ED_FRHDRSZ      24      /* bytes in a binary frame header */
+#define ED_FR_REPLY      1      /* reply to a command */
+#define ED_FR_PROMPT     2      /* previous command is complete */
+#define ED_FR_BCST       3      /* broadcast data from an edcat, seq per resource */
+#define ED_FR_GAP        4      /* replayed broadcasts lost, text 'first last' */
+#define ED_PT_NONE       0      /* frame has no payload */
+#define ED_PT_TEXT       1      /* payload is ASCII text */
+#define ED_PT_VALUES     2      /* payload is typed values from ed_publish() */
+#define ED_NOID     0xffff      /* slot or rsc field not applicable */
+
+        // *plen from a get or set that will finish with ed_complete()
+#define ED_PENDING     (-1)
+        // The cn given to pgscb for a get or set has the ID of the request
+        // above ED_REQSHIFT so that ed_complete() finishes that request
+        // and no later one.  send_ui(), prompt(), ed_complete(), and
+        // ed_fail() take the cn as it is given.  ED_CN() is the index of
+        // the UI, as kept in uilock.
+#define ED_REQSHIFT      8
+#define ED_CN(cn)       ((cn) & ((1 << ED_REQSHIFT) - 1))
+
+        // Max-age for ed_cacheable() of a value that changes only on edset
+#define ED_CACHE_FOREVER (-1)
+
         // Timer types for use in add_timer()
 #define ED_UNUSED        0
 #define ED_ONESHOT       1
@@ -54,9 +98,21 @@
 
         // Sizes of the slot array and number of resources per slot
 #define MX_PLUGIN       25     /* maximum # plug-ins per daemon */
-#define MX_RSC          10     /* maximum # resources per plugin */
+#define MX_RSC          10     /* # resources in SLOT.rsc[], more with ed_add_rsc() */
 #define MX_SONAME      200     /* maximum # of chars in plug-in file name */
 
+        // Line framer flags and ed_line_next() return values
+#define ED_LINE_CR       1     /* a carriage return also ends a line */
+#define ED_LINE_NONE   (-1)    /* no complete line in the buffer yet */
+#define ED_LINE_LONG   (-2)    /* line did not fit and is being discarded */
+
+        // Types of the values given to ed_publish()
+#define ED_VT_INT        1     /* v.i printed in decimal */
+#define ED_VT_HEX        2     /* v.i printed in hex, zero filled to width */
+#define ED_VT_FLOAT      3     /* v.d printed with prec digits after the point */
+#define ED_VT_TS         4     /* v.i in microseconds, printed as seconds */
+#define ED_VT_TEXT       5     /* v.s, a short word such as a label */
+
         // Verbosity levels
 #define ED_VERB_OFF      0     /* no verbose output at all */
 #define ED_VERB_WARN     1     /* give errors and warnings */
@@ -74,6 +130,7 @@ typedef struct {
     int       bkey;            // Broadcast key.  Broadcast sensor data if set
     int       uilock;          // UI ID # of session awaiting read/write reply
     int       flags;           // broadcast | readable | writeable flags
+    void     *dpriv;           // Daemon's own per-resource state.  Not for plug-ins
 } RSC;
 
 typedef struct {
@@ -85,8 +142,43 @@ typedef struct {
     void     *priv;            // Pointer to plug-in's private data
     char      soname[MX_SONAME];// shared object file name
     RSC       rsc[MX_RSC];     // Resources visible to this slot
+    RSC      *xrsc;            // Resources past rsc[] from ed_add_rsc()
+    int       nrsc;            // Number of resources, MX_RSC plus those in xrsc
 } SLOT;
 
+    // Resource i of a slot, in rsc[] or in xrsc.  Use this for resources
+    // from ed_add_rsc() since their index may be past the end of rsc[].
+#define RSCPTR(ps, i)    (((i) < MX_RSC) ? &((ps)->rsc[(i)]) : &((ps)->xrsc[(i) - MX_RSC]))
+
+    // A line framer splits the bytes read from a socket or serial port
+    // into lines.  Bytes before start have been consumed, bytes from
+    // start to scan are part of a line with no terminator yet, and
+    // bytes from scan to end have not been searched yet.
+typedef struct {
+    char     *buf;             // where bytes are read and lines assembled
+    int       size;            // number of bytes in buf
+    int       start;           // first byte of the next line
+    int       scan;            // first byte not yet searched for a terminator
+    int       end;             // one past the last byte read
+    int       flags;           // ED_LINE_CR
+    int       skip;            // set while discarding an overlong line
+} ED_LINEBUF;
+
+    // One value of a sample given to ed_publish().  The width and prec
+    // are used only for ASCII where the value is printed like printf()
+    // would with "%*d", "%0*x", or "%*.*f".  Values are separated by a
+    // space and the sample ends with a newline.
+typedef struct {
+    int       type;            // ED_VT_INT, ED_VT_HEX, ED_VT_FLOAT, ...
+    int       width;           // minimum characters in ASCII, 0 for any
+    int       prec;            // digits after the point of an ED_VT_FLOAT
+    union {
+        long long i;           // ED_VT_INT, ED_VT_HEX, ED_VT_TS
+        double    d;           // ED_VT_FLOAT
+        const char *s;         // ED_VT_TEXT
+    } v;
+} ED_VALUE;
+
 
 /***************************************************************************
  *  - Forward references
@@ -100,6 +192,21 @@ typedef struct {
 const SLOT * getslotbyid(
     int      id);
 
+/***************************************************************************
+ * ed_add_rsc(): - Add a resource to a slot.  The first free entry of
+ * rsc[] is used and after that the resource goes in xrsc, which grows
+ * as needed so a plug-in can have hundreds of resources.  Adding a
+ * resource may move the others in xrsc, so keep the index and use
+ * RSCPTR() rather than keeping a pointer until all are added.  Call
+ * it only from Initialize().  Returns the index of the resource or -1
+ * on error.
+ ***************************************************************************/
+int ed_add_rsc(
+    SLOT    *pslot,      // the plug-in's slot
+    char    *name,       // name of the resource
+    int      flags,      // IS_READABLE, IS_WRITABLE, CAN_BROADCAST
+    void   (*pgscb) ()); // get/set/cat callback
+
 /***************************************************************************
  * add_fd(): - add a file descriptor to the select list
  ***************************************************************************/
@@ -157,6 +264,49 @@ void bcst_ui(
     int      len,        // number of chars to send
     int     *bkey);      // slot/rsc as an int
 
+/***************************************************************************
+ * ed_publish(): - Broadcast a sample of typed values.  This is like
+ * bcst_ui() but the daemon does the formatting, and only for the
+ * encodings the subscribers use: ASCII text, binary values, or JSON
+ * for HTTP.  Each encoding is made at most once per sample.  Nothing
+ * is formatted if no one is watching the resource.
+ ***************************************************************************/
+void ed_publish(
+    RSC     *prsc,       // the broadcast resource
+    const ED_VALUE *vals, // the values of the sample
+    int      n);         // number of values
+
+/***************************************************************************
+ * ed_subscribe(): - Receive the broadcasts of another plug-in's
+ * resource as typed values, with no socket and no formatting.  The
+ * callback is called as cb(slot, rsc, vals, nval, pcb_data) where vals
+ * is a const ED_VALUE array valid only during the call.  Text from
+ * bcst_ui() is split into words: integers, numbers, and ED_VT_TEXT.
+ * The publisher must be loaded first.  Returns an ID for
+ * ed_unsubscribe() or -1 on error.
+ ***************************************************************************/
+int ed_subscribe(
+    int      slot,       // slot of the resource
+    int      rsc,        // resource index in the slot
+    void   (*cb) (),     // called with the values of each broadcast
+    void    *pcb_data);  // callback data
+
+/***************************************************************************
+ * ed_unsubscribe(): - Stop a subscription from ed_subscribe().
+ ***************************************************************************/
+void ed_unsubscribe(
+    int      id);        // ID from ed_subscribe()
+
+/***************************************************************************
+ * ed_set(): - Set a resource of another plug-in by calling its set
+ * routine directly, just as 'edset slot rsc val' would.  Returns 0 on
+ * success or -1 if the resource is not writable or refused the value.
+ ***************************************************************************/
+int ed_set(
+    int      slot,       // slot of the resource
+    int      rsc,        // resource index in the slot
+    char    *val);       // the new value
+
 /***************************************************************************
  * send_ui(): - This routine is called to send data to the other
  * end of a UI connection.  Closes connection on error.
@@ -166,6 +316,97 @@ void send_ui(
     int      len,        // number of chars to send
     int      cn);        // index to UI conn table
 
+/***************************************************************************
+ * ed_complete(): - Finish a get or set that the plug-in left pending
+ * by setting *plen to ED_PENDING.  Give the cn and resource from the
+ * pgscb call.  The reply in buf, if any, and a prompt are sent to the
+ * UI.  Nothing is sent if the daemon has already timed out the request,
+ * even if the UI has since made another request of the resource.
+ ***************************************************************************/
+void ed_complete(
+    int      cn,         // cn given to pgscb
+    RSC     *prsc,       // the resource
+    char    *buf,        // the reply, or an E_ error message
+    int      len);       // number of chars in buf, 0 for none
+
+/***************************************************************************
+ * ed_fail(): - Finish a pending get or set with an E_NORSP error, for
+ * example when the device did not answer.
+ ***************************************************************************/
+void ed_fail(
+    int      cn,         // cn given to pgscb
+    RSC     *prsc);      // the resource
+
+/***************************************************************************
+ * ed_cacheable(): - Let the daemon answer edget of a resource from the
+ * last value read for up to maxage milliseconds without calling the
+ * plug-in.  Use ED_CACHE_FOREVER for a value that changes only when
+ * the resource is set.  A set of the resource clears the value.
+ * Returns 0 on success or -1 on error.
+ ***************************************************************************/
+int ed_cacheable(
+    RSC     *prsc,       // the resource
+    int      maxage);    // most age of a value in ms, 0 to stop caching
+
+/***************************************************************************
+ * ed_cache(): - Give the cache of a resource a new value, for example
+ * when the plug-in learns the value has changed.  A len of zero clears
+ * the value so the next edget calls the plug-in.
+ ***************************************************************************/
+void ed_cache(
+    RSC     *prsc,       // the resource
+    char    *buf,        // the value as edget would give it
+    int      len);       // number of chars in buf, 0 to clear
+
+/***************************************************************************
+ * ed_line_init(): - Set up a line framer to use the given buffer.  The
+ * longest line that can be returned is size bytes including the
+ * terminator.  Flags is zero or ED_LINE_CR.
+ ***************************************************************************/
+void ed_line_init(
+    ED_LINEBUF *plb,     // line framer to initialize
+    char    *buf,        // buffer for the framer to use
+    int      size,       // number of bytes in buf
+    int      flags);     // ED_LINE_CR to also end lines at '\r'
+
+/***************************************************************************
+ * ed_line_room(): - Return where to put the next bytes read and set
+ * *proom to how many bytes will fit.  Read into this space then call
+ * ed_line_added() with the number of bytes read.
+ ***************************************************************************/
+char *ed_line_room(
+    ED_LINEBUF *plb,     // line framer
+    int     *proom);     // number of bytes that may be read
+
+/***************************************************************************
+ * ed_line_added(): - Tell the framer how many bytes were read into
+ * the space given by ed_line_room().
+ ***************************************************************************/
+void ed_line_added(
+    ED_LINEBUF *plb,     // line framer
+    int      n);         // number of bytes read
+
+/***************************************************************************
+ * ed_line_next(): - Get the next complete line.  The terminator is
+ * replaced with a null and *pline points at the line in the buffer.
+ * Returns the length of the line, ED_LINE_NONE if there is no complete
+ * line, or ED_LINE_LONG once for each line that does not fit in the
+ * buffer.  The rest of a long line is discarded.  The line is valid
+ * until the next call of ed_line_room().
+ ***************************************************************************/
+int ed_line_next(
+    ED_LINEBUF *plb,     // line framer
+    char   **pline);     // set to the start of the line
+
+/***************************************************************************
+ * ed_line_unget(): - Put back the line just returned by ed_line_next()
+ * so that the next call returns it again.
+ ***************************************************************************/
+void ed_line_unget(
+    ED_LINEBUF *plb,     // line framer
+    char    *line,       // the line from ed_line_next()
+    int      len);       // its length
+
 /***************************************************************************
  * prompt(): - Write a prompt out to the user.  A prompt indicates
  * the completion of the previous command.
@@ -188,6 +429,12 @@ void prompt(
 #define E_NWRITE  "ERROR 007 : Resource '%s' is not writable\n"
 #define E_BDVAL   "ERROR 008 : Invalid value given for resource '%s'\n"
 #define E_NORSP   "ERROR 009 : No response from %s'\n"
+#define E_BDPROTO "ERROR 010 : Unknown protocol encoding '%s'\n"
+#define E_BDTAG   "ERROR 011 : Invalid request ID: %s\n"
+#define E_BDHNDL  "ERROR 012 : Invalid resource handle: %s\n"
+#define E_NOBATCH "ERROR 013 : Resource '%s' can not be read in a batch\n"
+#define E_TOOLONG "ERROR 014 : Command longer than %s characters\n"
+#define E_NOHIST  "ERROR 015 : Resource '%s' has no history\n"
 #define LISTFORMAT "  %2d / %10s   %s\n"
 #define LISTRSCFMT "                  - %s : %s%s%s\n"
 
@@ -215,8 +462,18 @@ void prompt(
 #define M_BADSCHED    "Scheduler changes failed with error: %s"
 #define M_BADMLOCK    "Memory page locking failed with error: %s"
 #define M_NOUI        "No free UI sessions"
-#define M_BADCONN     "Error accepting UI connection. errno=%d"
+#define M_BADCONN     "Error on UI connection: %s"
+#define M_BADPEER     "Refused UI connection from uid %s"
+#define M_IDLEUI      "Closed idle UI connection %s"
+#define M_SLOWUI      "Closed UI connection %s that is not reading"
+#define M_NOSUB       "No free subscriptions for %s"
+#define M_NORSP       "No response from %s"
 #define M_MISSTO      "Missed TO on %d.  Rescheduling"
+#define M_NOTHREAD    "unable to start a thread for %s: %s"
+#define M_THRDROP     "thread of %s was behind and dropped %s broadcasts"
+#define M_DEPCYCLE    "%s and %s depend on each other.  Not waiting"
+#define M_STARTED     "%s started in %s ms after waiting %s ms"
+#define M_READY       "plug-ins ready in %s ms"
 
 
 
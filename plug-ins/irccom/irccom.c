@@ -105,7 +105,7 @@ typedef struct
     char     srv[SRVLEN];       // the IRC server to use
     int      ircfd;             // FD to the IRC server
     char     inbuf[MX_LINE];    // Buffer of data from the IRC server
-    int      inidx;             // Put next char into inbuf at this location
+    ED_LINEBUF lines;           // Splits inbuf into lines from the server
     char     avch[MXRPLY];      // available channel list
     int      avidx;             // location of next char to store 
     int      avstatus;          // not connected, retrieving, available
@@ -150,7 +150,7 @@ int Initialize(
     pctx->nam[0] = (char) 0;   // no nickname at start
     pctx->srv[0] = (char) 0;   // no IRC server at start
     pctx->ircfd = -1;          // no FD to server yet
-    pctx->inidx = 0;           // no bytes in irccom receive buffer yet
+    ed_line_init(&(pctx->lines), pctx->inbuf, MX_LINE, ED_LINE_CR); // no bytes yet
     for (i = 0; i < NCHAN; i++) {   // no channels yet
         pctx->chan[i].chname[0] = (char) 0;
     }
@@ -385,8 +385,7 @@ static void irc_connect(
         del_fd(pctx->ircfd);
         close(pctx->ircfd); 
         pctx->ircfd = -1;
-        pctx->inbuf[0] = (char) 0;
-        pctx->inidx = 0;
+        ed_line_init(&(pctx->lines), pctx->inbuf, MX_LINE, ED_LINE_CR);
         pctx->status = ICM_CONNECTING;
         pctx->avstatus = AVC_NOSERVER;
         pctx->avidx = 0;
@@ -564,37 +563,24 @@ static void irc_receive(
     IRCCOM  *pctx)          // our local info
 {
     int      ret=0;    // return count
-    int      i;
+    int      room;     // number of bytes that fit in inbuf
+    char    *line;     // a line in inbuf
 
-    ret = read(pctx->ircfd, &(pctx->inbuf[pctx->inidx]), (MX_LINE - pctx->inidx));
+    line = ed_line_room(&(pctx->lines), &room);
+    ret = read(pctx->ircfd, line, room);
     if (ret > 0) {
         // Did a read and have new characters in the buffer.  Look
         // for new lines and do any needed processing on them.
-        pctx->inidx += ret;
-        while (1) {
-            for (i = 0; i < pctx->inidx; i++) {
-                // accept either CR of LF as line terminator
-                if ((pctx->inbuf[i] == '\r') || (pctx->inbuf[i] == '\n'))
-                    break;
-            }
-            if (i == pctx->inidx) {  // scan found no terminators?
-                return;              // no more complete lines in the buffer.
-            }
-            // terminator at location i
-            pctx->inbuf[i] = (char) 0;   // replace terminator with null
-
+        // Either CR or LF ends a line.  Overlong lines are dropped.
+        ed_line_added(&(pctx->lines), ret);
+        while ((ret = ed_line_next(&(pctx->lines), &line)) != ED_LINE_NONE) {
             // We have a line from the IRC server.  Send to IRC processor
             // that will consume the line.
-            irc_line(pctx->inbuf, i, pctx);
-
-            // Got a line and processed it.
-            // Move any remaining characters in the buffer down and
-            // continue looking for complete lines.
-            if (pctx->inidx - (i+1) != 0) {
-                memmove(pctx->inbuf, &(pctx->inbuf[i+1]), (pctx->inidx - (i+1)));
+            if (ret != ED_LINE_LONG) {
+                irc_line(line, ret, pctx);
             }
-            pctx->inidx -= i+1;    // adjust buffer index for removed chars
         }
+        return;
     }
     if ((ret < 0) && (errno == EAGAIN)) {
         return;    // return and select will bring us back
@@ -0,0 +1,117 @@
+static char README[] = "\
+OVERVIEW\n\
+   The IRC peripheral provides a lightweight, easy to use, way\n\
+for robots to communicate with each other.  Each robot is assigned\n\
+a unique name, an IRC server name (or address), and two 'channels'\n\
+over which it can communicate.  Channels are usually set up for\n\
+different groups or topics.  For example, a RoboSoccer game might\n\
+have a channel for the red team, a channel for the blue team, and\n\
+a channel for the referees.\n\
+   This system does not use SSL or passwords.  DO NOT use this\n\
+system where security matters.\n\
+\n\
+\n\
+IRC SERVER\n\
+   Each robot must have access to an IRC server.  The server can\n\
+be on the Internet but is most often on a Raspberry Pi (or SBC)\n\
+connected to a WiFi router via Ethernet.  If this description\n\
+matches your system you can install an IRC server on the Pi\n\
+with:\n\
+  sudo apt-get install ngircd\n\
+You can add permanent channels to your IRC server by appending\n\
+the following to the /etc/ngircd/ngircd.conf:\n\
+  [Channel]\n\
+          Name = &referee\n\
+          Topic = Referee's channel\n\
+  [Channel]\n\
+          Name = &blueteam\n\
+          Topic = Blue team channel\n\
+  [Channel]\n\
+          Name = &redteam\n\
+          Topic = Red team channel\n\
+While editing the configuration file you should also change the\n\
+message-of-the-day and the server name.  If you change ngircd's\n\
+configuration file be sure to restart it with:\n\
+  sudo pkill -1 ngircd\n\
+\n\
+\n\
+\n\
+RESOURCES\n\
+   The user interfaces to the IRC peripheral let you specify\n\
+which IRC server to use, your robot's name, and which two channels\n\
+to use.  There are also resources that let you get a list of the\n\
+channels available at the server and to give the status of the\n\
+connection to the IRC server.\n\
+\n\
+config\n\
+   The the name for this robot followed by the domain name or IP\n\
+address of the IRC server to use.  The robot name must be unique\n\
+on the server, must be nine characters or less, and should not\n\
+contain embedded white space or commas.  R2D2, Robbie, Bender,\n\
+and Gort are all good robot names.  Writing to this node initiates\n\
+a connection to the IRC server with the specified name.  This\n\
+resource works with the get and set commands.  There are no\n\
+background timers so you MUST write to this resource to establish\n\
+initial communication to the server.  There is a retry timer\n\
+in case the connection is lost.\n\
+\n\
+status\n\
+   The status of the connection to an IRC server.  Values for\n\
+status can be 'NoServer', 'Connecting', 'Error', and 'Connected'.\n\
+NoServer indicates that no IRC server has been specified in config.\n\
+Connecting indicates that the IRC peripheral is currently trying\n\
+to establish a connection to the IRC server.  An Error status is\n\
+given if there was a timeout while trying to set up a connection,\n\
+if an existing connection is interrupted, or if the requested name\n\
+is already in use on the IRC server.  A Connected state indicates\n\
+that the IRC connection is established.  This resource works with\n\
+the get command.\n\
+\n\
+available_channels\n\
+   Once a connection to the IRC server is established, you can\n\
+use this resource to get a list of the channels available on the\n\
+server.  There is one channel per line, and each line contains the\n\
+channel name, a tab, and a brief description of the channel.\n\
+This resources works with the get command.  Note that the '&'\n\
+that is prepended to the actual IRC channel names is removed from\n\
+the list of channels.   This resource works with the get command.\n\
+\n\
+my_channels\n\
+   A space separate list of two channels to use.  Channels do not\n\
+have the usual '&' prepended to them.  This makes this resource\n\
+easier to use in shell scripts.  This resource works with the\n\
+get and set commands.\n\
+\n\
+comm\n\
+   Data to and from the robot.  Use the set command to write\n\
+messages and the cat command to receive the stream of messages.\n\
+The form of the set command to send a message is:\n\
+   edset irccom comm <channel_name> [text to send]\n\
+For example, send the word READY to red team channel:\n\
+   edset irccom comm g1_red READY\n\
+The only way to receive messages is with the cat command.  The\n\
+messages in the data steam are of the form:\n\
+   <channel_name> <sender's_name> [text of the message]\n\
+\n\
+\n\
+\n\
+EXAMPLE\n\
+   Let's continue with the example of a RoboSoccer game.  Team members\n\
+can communicate with each other and all participants hear the referees.\n\
+Bash configuration for a member of the red team might appear as:\n\
+\n\
+     # connect to the local IRC server as Red6\n\
+     edset irccom config Red6 192.168.1.20\n\
+     # verify we are connected\n\
+     edget irccom status\n\
+     # get a list of the available channels\n\
+     edget irccom available_channels\n\
+     # set our two channels to referee and redteam\n\
+     edset irccom my_channels referee redteam\n\
+     # start listening for referee commands\n\
+     edcat irccom comm &\n\
+     # tell the red captain we're ready to go\n\
+     edset irccom comm redteam ready\n\
+\n\
+\n\
+";
@@ -0,0 +1,51 @@
+static char README[] = "\
+============================================================\n\
+\n\
+tts : Text-To-Speech\n\
+The tts peripheral provices a simple interface to the CMU\n\
+Flite text-to-speech program.  While the audio quality is\n\
+not as good as commercial TTS systems, Flite is entirely\n\
+open source and can usually be installed with an apt-get\n\
+command.\n\
+\n\
+\n\
+INSTALLATION\n\
+Install Flite with the apt-get command:\n\
+   sudo apt-get install flite\n\
+See what voices are available with the command:\n\
+   flite -lv\n\
+Test that flite works with your audio system:\n\
+   flite -voice awb -t 'hello world'\n\
+\n\
+\n\
+RESOURCES\n\
+The tts peripheral has resources that let you set the\n\
+voice, output speech, and to monitor whether or not the\n\
+system is in use.\n\
+\n\
+speak : A write-only resource that invokes the flite\n\
+command to speak the specified text on you audio system.\n\
+\n\
+voice : A read-write resource that lets you specify which\n\
+voice to use for output.  Most flite installations include\n\
+the following:\n\
+   kal : The voice of a 1950's robot\n\
+   awb : Easy to understand, almost British\n\
+   slt : Easy to understand, female\n\
+\n\
+status : A broadcast resource that gives the state of flite\n\
+as 'busy' or 'idle'.  You can use the get command to read\n\
+the state or the cat command to get updates as they occur.\n\
+The status resource is useful if you want to output longer\n\
+strings or if you want a longer pause between parts of your\n\
+output.\n\
+\n\
+\n\
+EXAMPLES\n\
+Watch the state transitions as you speak a phrase using the\n\
+slt voice.\n\
+   edcat tts status &\n\
+   edset tts voice awb\n\
+   edset tts speak To be, or not to be.  That is the question.\n\
+\n\
+";
@@ -0,0 +1,59 @@
+static char README[] = "\
+============================================================\n\
+\n\
+VL53L0X Plug-in\n\
+The VL53L0X plug-in provides a simple ASCII interface\n\
+to the ST VL53L0X time of flight range sensor.\n\
+The plug-in has user configurable resources for the Linux \n\
+device name, long range measurements, and period at which \n\
+measurements are made.  Incoming range measurements are \n\
+broadcast in ASCII on the 'range' resource.\n\
+\n\
+NOTE: Only one VL53L0X plug-in can be loaded.  Loading\n\
+more than one instance of this peripheral will result \n\
+in unexpected results.\n\
+\n\
+\n\
+RESOURCES\n\
+\n\
+device : The full path to the range sensor device to\n\
+use.  The default value of 'device' is /dev/i2c-1.\n\
+\n\
+hw_rev : The model and revision of the range sensor.\n\
+The form of the output is:\n\
+  <model ID> <revision ID>\n\
+\n\
+longrange : Enable longer range measurements.  By default\n\
+long range is enabled, 30-2000mm.  Set to 0 to specify a shorter \n\
+range of measurements, 30-800mm.  Note results beyond the range \n\
+40-600mm are less accurate and more prone to being interfered \n\
+with by ambient light.\n\
+\n\
+period : The period in mSec in steps of 10 mSec at which \n\
+measurements are made.  The default is 100 mSec which is \n\
+the minimum.  The maximum is 5000, i.e. 5 seconds.\n\
+\n\
+range : A broadcast resource that outputs range \n\
+measurements at the specified period.  Each distances are \n\
+measurement is returned as an ASCII integers terminated by a \n\
+newline with one line per event.  The range measurements \n\
+are in millimeters.  The sensor is read only while someone\n\
+is listening to 'range'.\n\
+\n\
+EXAMPLE\n\
+  Set the device to I2C channel 0:\n\
+   edset vl53 device /dev/i2c-1\n\
+\n\
+  Get the HW revision of the range sensor:\n\
+   edget vl53 hw_rev\n\
+\n\
+  Disable long range measurements:\n\
+   edset vl53 longrange 0\n\
+\n\
+  Set the range measurement period:\n\
+   edset vl53 period 200\n\
+\n\
+  Get a series of range measurements:\n\
+   edcat vl53 range\n\
+\n\
+";
@@ -86,6 +86,8 @@ typedef struct
     int      longrange;         // long range measurement enable flag, 0 or 1
     int      period;            // update period for sending distance measurement
     int      vl53fd;            // File Descriptor (=-1 if closed)
+    int      watched;           // set while range has listeners
+    int      active;            // set while the device and timer are registered
 } VL53;
 
 
@@ -94,6 +96,8 @@ typedef struct
  **************************************************************/
 static void usercmd(int, int, char*, SLOT*, int, int*, char*);
 static void rangecb(int, void*);
+static void vlstart(VL53*);
+static void vlstop(VL53*);
 void do_range(VL53*);
 
 
@@ -119,6 +123,9 @@ int Initialize(
     pctx->period = 100;         // default period of measurements
     (void) strncpy(pctx->device, DEFDEV, PATH_MAX);
     pctx->longrange = 1;        // set long range mode (up to 2m)
+    pctx->ptimer = (void *) 0;  // no ranging until someone listens
+    pctx->watched = 0;
+    pctx->active = 0;
 
     // TODO: currently only a single instance of the TOF sensor can be used
     // now open and register the vl53 I2C device
@@ -126,7 +133,6 @@ int Initialize(
     pctx->vl53fd = tofInit(pctx->i2c_channel, I2C_DEV_ID, pctx->longrange);
     if (pctx->vl53fd != -1) {
 	    tofGetModel(&pctx->model, &pctx->revision);
-        add_fd(pctx->vl53fd, ED_READ, rangecb, (void *) pctx);
     }
     else
     {
@@ -167,17 +173,14 @@ int Initialize(
     pslot->rsc[RSC_PERIOD].uilock = -1;
     pslot->rsc[RSC_PERIOD].slot = pslot;
     pslot->rsc[RSC_RANGE].name = FN_RANGE;
-    pslot->rsc[RSC_RANGE].flags = CAN_BROADCAST;
+    pslot->rsc[RSC_RANGE].flags = CAN_BROADCAST | WANT_SUBS;
     pslot->rsc[RSC_RANGE].bkey = 0;
-    pslot->rsc[RSC_RANGE].pgscb = 0;
+    pslot->rsc[RSC_RANGE].pgscb = usercmd;
     pslot->rsc[RSC_RANGE].uilock = -1;
     pslot->rsc[RSC_RANGE].slot = pslot;
 
-    // Start the timer to broadcast state info
-    if (pctx->period != 0)
-        pctx->ptimer = add_timer(ED_PERIODIC, pctx->period, rangecb, (void *) pctx);
-    else
-        pctx->ptimer = (void *) 0;
+    // The sensor is read only while range has listeners.  The daemon
+    // tells us with EDSUB and EDUNSUB when that starts and stops.
 
     return (0);
 }
@@ -204,6 +207,25 @@ void usercmd(
     // point to the current context
     pctx = (VL53 *) pslot->priv;
 
+    // start or stop ranging as range gets its first or loses its last
+    // listener
+    if (cmd == EDSUB)
+    {
+        pctx->watched = 1;
+        vlstart(pctx);
+        return;
+    }
+    else if (cmd == EDUNSUB)
+    {
+        pctx->watched = 0;
+        vlstop(pctx);
+        return;
+    }
+    else if (cmd == EDCAT)
+    {
+        return;
+    }
+
     // get resource values
     if (cmd == EDGET)
     {
@@ -252,17 +274,18 @@ void usercmd(
                 }
                 
                 // close and unregister the old device
+                vlstop(pctx);
                 if (pctx->vl53fd >= 0) {
-                    del_fd(pctx->vl53fd);
                     close(pctx->vl53fd);
                     pctx->vl53fd = -1;
                 }
                 
-                // now open and register the new device
+                // now open the new device and register it if ranging
                 pctx->vl53fd = tofInit(pctx->i2c_channel, I2C_DEV_ID, pctx->longrange);
                 if (pctx->vl53fd != -1) {
 	                tofGetModel(&pctx->model, &pctx->revision);
-                    add_fd(pctx->vl53fd, ED_READ, rangecb, (void *) pctx);
+                    if (pctx->watched)
+                        vlstart(pctx);
                 }
                 else
                 {
@@ -285,17 +308,18 @@ void usercmd(
                 pctx->longrange = nlongrange;
 
                 // close and unregister the old device
+                vlstop(pctx);
                 if (pctx->vl53fd >= 0) {
-                    del_fd(pctx->vl53fd);
                     close(pctx->vl53fd);
                     pctx->vl53fd = -1;
                 }
                 
-                // now open and register the new device
+                // now open the new device and register it if ranging
                 pctx->vl53fd = tofInit(pctx->i2c_channel, I2C_DEV_ID, pctx->longrange);
                 if (pctx->vl53fd != -1) {
 	                tofGetModel(&pctx->model, &pctx->revision);
-                    add_fd(pctx->vl53fd, ED_READ, rangecb, (void *) pctx);
+                    if (pctx->watched)
+                        vlstart(pctx);
                 }
                 else
                 {
@@ -319,12 +343,10 @@ void usercmd(
                 // record the new value
                 pctx->period = nperiod;
 
-                // delete old timer and create a new one with the new period
-                if (pctx->ptimer) {
-                    del_timer(pctx->ptimer);
-                }
-                if (pctx->period != 0) {
-                    pctx->ptimer = add_timer(ED_PERIODIC, pctx->period, rangecb, (void *) pctx);
+                // restart ranging with the new period
+                if (pctx->active) {
+                    vlstop(pctx);
+                    vlstart(pctx);
                 }
                 
                 break;
@@ -352,6 +374,41 @@ void rangecb(
 }
 
 
+/***************************************************************************
+ *  vlstart()  - Start ranging: register the device and start the timer
+ *  that reads and broadcasts the range.
+ *
+ ***************************************************************************/
+static void vlstart(VL53 *pctx)
+{
+    if (pctx->active || (pctx->vl53fd < 0))
+        return;
+    add_fd(pctx->vl53fd, ED_READ, rangecb, (void *) pctx);
+    if (pctx->period != 0)
+        pctx->ptimer = add_timer(ED_PERIODIC, pctx->period, rangecb, (void *) pctx);
+    pctx->active = 1;
+    return;
+}
+
+
+/***************************************************************************
+ *  vlstop()  - Stop ranging: unregister the device and stop the timer.
+ *
+ ***************************************************************************/
+static void vlstop(VL53 *pctx)
+{
+    if (!pctx->active)
+        return;
+    del_fd(pctx->vl53fd);
+    if (pctx->ptimer) {
+        del_timer(pctx->ptimer);
+        pctx->ptimer = (void *) 0;
+    }
+    pctx->active = 0;
+    return;
+}
+
+
 /***************************************************************************
  *  do_range()  - process a value from the vl53
  *
@@ -361,8 +418,7 @@ void do_range(VL53 *pctx)
     SLOT     *pslot;
     RSC      *prsc;    // pointer to this slot's counts resource
     int       range;   // the current range value
-    char      lineout[MX_MSGLEN];  // output to send to users
-    int       nout;    // length of output line
+    ED_VALUE  val;     // range to send to users
 
     // Get slot and pointer to range resource structure
     pslot = pctx->pslot;
@@ -374,12 +430,13 @@ void do_range(VL53 *pctx)
         range = tofReadDistance();
         if (range < 4096)
         {
-            // format the range value
-	        snprintf(lineout, MX_MSGLEN, "%d\n", range);
-            nout = strnlen(lineout, MX_MSGLEN-1);
+            // the daemon formats the range as "%d\n" for ASCII UIs
+            val.type = ED_VT_INT;
+            val.width = 0;
+            val.v.i = range;
             
             // bkey will return cleared if UIs are no longer monitoring us
-            bcst_ui(lineout, nout, &(prsc->bkey));
+            ed_publish(prsc, &val, 1);
         }
     }        
 
@@ -0,0 +1,267 @@
+/*
+ * Name: bench.c
+ *
+ * Description: A utility that measures the round trip time of reads
+ *              from the empty daemon.  It sends one edget at a time over
+ *              TCP or a Unix socket, waits for the prompt, and reports
+ *              the median and 99th percentile times and the rate.
+ *
+ * Copyright:   Copyright (C) 2019 by Demand Peripherals, Inc.
+ *              All rights reserved.
+ *
+ * License:     This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the Version 2 of the GNU General
+ *              Public License as published by the Free Software Foundation.
+ *              GPL2.txt in the top level directory is a copy of this license.
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *              GNU General Public License for more details.
+ *
+ *
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stddef.h>
+#include <getopt.h>
+#include <time.h>
+#include <arpa/inet.h> /* for inet_aton() */
+#include <sys/un.h>    /* for Unix socket addresses */
+#include "main.h"
+
+
+
+/**************************************************************
+ *  - Limits and defines
+ **************************************************************/
+        // Maximum length of an IP address string
+#define MAX_IP       50
+        // Max length of cmd down to the empty daemon
+#define MAX_EDCMD   250
+        // Default number of reads to time
+#define DEF_NREQ   1000
+        // Reads done before timing starts
+#define NWARM        10
+
+
+/**************************************************************
+ *  - Function prototypes and forward references
+ **************************************************************/
+void usage();
+static long long now_ns();
+static int  one_get(int, char *, int);
+static int  cmp_ll(const void *, const void *);
+
+
+/**************************************************************
+ * main():  - Connect to the daemon, time the reads, and print
+ * the results.
+ **************************************************************/
+int main(int argc, char **argv)
+{
+    int  srvfd;             // FD for empty daemon
+    struct sockaddr_in skt; // network address for empty daemon
+    struct sockaddr_un uskt;// Unix socket address for empty daemon
+    int  adrlen;
+    char bindaddress[MAX_IP];
+    int  bindport;
+    char *unixpath = 0;     // Unix socket path if not using TCP
+    int  nreq = DEF_NREQ;   // number of reads to time
+    long long *lat;         // time of each read in ns
+    long long t0;           // when the timed reads started
+    long long total;        // ns for all of the timed reads
+    int  tmp_int;           // temp integer
+    int  cmdc;              // cmd line option
+    char cmd[MAX_EDCMD];    // the edget command
+    int  slen;              // length of string in cmd
+    int  i;
+
+    // Set default config.  Change default behavior here.
+    strncpy(bindaddress, "127.0.0.1", MAX_IP-1);
+    bindaddress[MAX_IP-1] = (char) 0;
+    bindport = DEF_UIPORT;
+
+    while ((cmdc = getopt(argc, argv, "a:hn:p:u:")) != EOF) {
+        switch ((char) cmdc) {
+        case 'a':       // Bind Address
+            strncpy(bindaddress, optarg, MAX_IP-1);
+            break;
+
+        case 'n':       // Number of reads
+            if ((sscanf(optarg, "%d", &tmp_int) == 1) && (tmp_int > 0)) {
+                nreq = tmp_int;
+            }
+            break;
+
+        case 'p':       // Bind Port
+            if (sscanf(optarg, "%d", &tmp_int) == 1) {
+                bindport = tmp_int;
+            }
+            break;
+
+        case 'u':       // Unix socket path
+            unixpath = optarg;
+            break;
+
+        case 'h':       // Help text
+        default:
+            usage();
+            exit((cmdc == 'h') ? 0 : -1);
+            break;
+        }
+    }
+    if (argc - optind != 2) {
+        usage();
+        exit(-1);
+    }
+    slen = snprintf(cmd, sizeof(cmd), "%sget %s %s\n", CPREFIX, argv[optind],
+                    argv[optind + 1]);
+    if (slen >= (int) sizeof(cmd)) {
+        printf("Error: command is too long.\n");
+        exit(-1);
+    }
+    lat = malloc(nreq * sizeof(long long));
+    if (lat == 0) {
+        printf("Error: no memory for %d reads.\n", nreq);
+        exit(-1);
+    }
+
+    // Open connection to empty daemon.  A path starting with '@' is
+    // in the abstract namespace.
+    if (unixpath != 0) {
+        (void) memset((void *) &uskt, 0, sizeof(struct sockaddr_un));
+        uskt.sun_family = AF_UNIX;
+        slen = strlen(unixpath);
+        if (slen >= (int) sizeof(uskt.sun_path)) {
+            printf("Error: Unix socket path is too long.\n");
+            exit(-1);
+        }
+        memcpy(uskt.sun_path, unixpath, slen);
+        if (unixpath[0] == '@')
+            uskt.sun_path[0] = (char) 0;
+        adrlen = offsetof(struct sockaddr_un, sun_path) + slen;
+        if (((srvfd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0) ||
+            (connect(srvfd, (struct sockaddr *) &uskt, adrlen) < 0)) {
+            printf("Error: unable to connect to the empty daemon.\n");
+            exit(-1);
+        }
+    }
+    else {
+        adrlen = sizeof(struct sockaddr_in);
+        (void) memset((void *) &skt, 0, (size_t) adrlen);
+        skt.sin_family = AF_INET;
+        skt.sin_port = htons(bindport);
+        if ((inet_aton(bindaddress, &(skt.sin_addr)) == 0) ||
+            ((srvfd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0) ||
+            (connect(srvfd, (struct sockaddr *) &skt, adrlen) < 0)) {
+            printf("Error: unable to connect to the empty daemon.\n");
+            exit(-1);
+        }
+    }
+
+    // A few untimed reads so the daemon and plug-in are warmed up
+    slen = strlen(cmd);
+    for (i = 0; i < NWARM; i++) {
+        if (one_get(srvfd, cmd, slen) < 0)
+            exit(-1);
+    }
+
+    t0 = now_ns();
+    for (i = 0; i < nreq; i++) {
+        lat[i] = now_ns();
+        if (one_get(srvfd, cmd, slen) < 0)
+            exit(-1);
+        lat[i] = now_ns() - lat[i];
+    }
+    total = now_ns() - t0;
+    close(srvfd);
+
+    qsort(lat, nreq, sizeof(long long), cmp_ll);
+    printf("%s: %d reads, p50 %.1f us, p99 %.1f us, max %.1f us, %.0f reads/s\n",
+           (unixpath) ? "unix" : "tcp", nreq,
+           lat[nreq / 2] / 1000.0, lat[(nreq * 99) / 100] / 1000.0,
+           lat[nreq - 1] / 1000.0, (nreq * 1e9) / total);
+    free(lat);
+    exit(0);
+}
+
+
+/**************************************************************
+ * one_get():  - Send one edget and read the reply up to and
+ * including the prompt.  Returns 0 on success or -1 if the
+ * connection failed.
+ **************************************************************/
+static int one_get(
+    int   fd,               // connection to the daemon
+    char *cmd,              // the edget command with its newline
+    int   len)              // length of cmd
+{
+    char buf[MXRPLY];       // reply from the daemon
+    int  nrd;               // bytes read
+
+    if (write(fd, cmd, len) != len) {
+        printf("Error: write to the empty daemon failed.\n");
+        return(-1);
+    }
+    while (1) {
+        nrd = read(fd, buf, sizeof(buf));
+        if ((nrd < 0) && (errno == EINTR))
+            continue;
+        if (nrd <= 0) {
+            printf("Error: the empty daemon closed the connection.\n");
+            return(-1);
+        }
+        // The prompt is the last byte of a reply
+        if (buf[nrd - 1] == PROMPT)
+            return(0);
+    }
+}
+
+
+/**************************************************************
+ * now_ns():  - Return a monotonic time in nanoseconds
+ **************************************************************/
+static long long now_ns()
+{
+    struct timespec ts;
+
+    (void) clock_gettime(CLOCK_MONOTONIC, &ts);
+    return((ts.tv_sec * 1000000000LL) + ts.tv_nsec);
+}
+
+
+/**************************************************************
+ * cmp_ll():  - Compare two times for qsort()
+ **************************************************************/
+static int cmp_ll(
+    const void *a,
+    const void *b)
+{
+    long long x = *(const long long *) a;
+    long long y = *(const long long *) b;
+
+    return((x > y) - (x < y));
+}
+
+
+/**************************************************************
+ * usage():  - Print how to use this program
+ **************************************************************/
+void usage()
+{
+    printf("usage: %sbench [-a addr] [-p port] [-u path] [-n count] <plug-in> <resource>\n",
+           CPREFIX);
+    printf("  Time <count> reads of the resource, one at a time, over TCP\n");
+    printf("  or over the Unix socket at path.  A path starting with '@' is\n");
+    printf("  in the abstract namespace.  The default count is %d.\n", DEF_NREQ);
+    return;
+}
+
+// end of bench.c